@@ -105,6 +105,36 @@ void UpdateForest(Forest* forest, std::pair<int, int>* edges,
   timer::report_time("cut-" + batch_str, median(cut_times));
 }
 
+// For `num_iters` iterations, construct a forest from the `m` edges in `edges`
+// starting from no edges, once with `BatchLink` (as `UpdateForest` does) and
+// once with `BuildFromForest`. Report the median time of each.
+//
+// The trailing `int` argument prefers this overload over the no-op below, which
+// is used for forests without `BuildFromForest`.
+template <typename Forest>
+auto CompareConstruction(Forest* forest, std::pair<int, int>* edges,
+    int num_iters, int m, int)
+    -> decltype(forest->BuildFromForest(edges, m), void()) {
+  vector<double> link_times(num_iters);
+  vector<double> build_times(num_iters);
+  for (int j = 0; j < num_iters; j++) {
+    timer link_t; link_t.start();
+    forest->BatchLink(edges, m);
+    link_times[j] = link_t.stop();
+    forest->BatchCut(edges, m);
+
+    timer build_t; build_t.start();
+    forest->BuildFromForest(edges, m);
+    build_times[j] = build_t.stop();
+    forest->BatchCut(edges, m);
+  }
+  timer::report_time_no_newline("construct-link", median(link_times));
+  timer::report_time("construct-build", median(build_times));
+}
+
+template <typename Forest>
+void CompareConstruction(Forest*, std::pair<int, int>*, int, int, long) {}
+
 template <typename Forest>
 void RunBenchmark(int argc, char** argv) {
   commandLine P{argc, argv, "[-iters] graph_filename"};
@@ -120,6 +150,7 @@ void RunBenchmark(int argc, char** argv) {
 
   Forest forest{graph_info.num_vertices};
 
+  CompareConstruction(&forest, edges, num_iters, m, 0);
   for (int batch_size = 100; batch_size < m; batch_size *= 10) {
     UpdateForest(&forest, edges, batch_size, num_iters, m);
   }
@@ -0,0 +1,16 @@
+#include <dynamic_trees/parallel_euler_tour_tree/include/euler_tour_tree.hpp>
+
+#include <dynamic_trees/benchmarks/benchmark.hpp>
+
+// Same as benchmark_dynamic_trees_parallel_ett but with edges looked up in
+// per-vertex edge lists rather than a hash table.
+int main(int argc, char** argv) {
+  parallel_skip_list::AugmentedElement<int>::aggregate_function = [&] (int x, int y) { return x + y; };
+  parallel_skip_list::AugmentedElement<int>::default_value = 1;
+  dynamic_trees_benchmark::RunBenchmark<
+      parallel_euler_tour_tree::EulerTourTree<
+          int, parallel_skip_list::Augmentation<int>,
+          parallel_skip_list::PointerLinks,
+          parallel_euler_tour_tree::AdjacencyEdges>>(argc, argv);
+  return 0;
+}
@@ -0,0 +1,80 @@
+#include <algorithm>
+#include <iostream>
+#include <random>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include <dynamic_trees/parallel_euler_tour_tree/include/euler_tour_tree.hpp>
+
+#include <dynamic_trees/benchmarks/benchmark.hpp>
+
+// Measures vertex value updates per second with `BatchUpdate` at batch sizes
+// from 10^2 up to `-max-batch`, and with `Update` called on each vertex of the
+// smaller batches.
+//
+// The forest is built from the input graph's edges, which must form a forest.
+// Updates pick vertices uniformly at random, so batches larger than the number
+// of vertices contain repeated vertices.
+int main(int argc, char** argv) {
+  commandLine P{argc, argv,
+    "[-iters] [-max-batch] [-max-single-batch] graph_filename"};
+  int num_iters{P.getOptionIntValue("-iters", 4)};
+  long max_batch{P.getOptionLongValue("-max-batch", 10000000)};
+  long max_single_batch{P.getOptionLongValue("-max-single-batch", 100000)};
+  char* graph_filename{P.getArgument(0)};
+
+  std::cout << "Running with " << parlay::num_workers() << " workers" << std::endl;
+  dynamic_trees_benchmark::ReadGraphOutput graph_info{
+    dynamic_trees_benchmark::ReadGraph(graph_filename)};
+  const int n{graph_info.num_vertices};
+  const int m{graph_info.num_edges};
+  std::pair<int, int>* edges{graph_info.edges};
+  std::mt19937 generator{0};
+
+  parallel_euler_tour_tree::EulerTourTree<
+      int, parallel_skip_list::SumAggregate<int>> forest{n};
+  forest.BuildFromForest(edges, m);
+
+  for (long batch_size = 100; batch_size <= max_batch; batch_size *= 10) {
+    std::uniform_int_distribution<int> any_vertex{0, n - 1};
+    std::uniform_int_distribution<int> any_value{0, 100};
+    parlay::sequence<int> vertices(batch_size);
+    parlay::sequence<int> values(batch_size);
+    for (long i = 0; i < batch_size; i++) {
+      vertices[i] = any_vertex(generator);
+      values[i] = any_value(generator);
+    }
+
+    vector<double> batch_times(num_iters);
+    for (int j = 0; j < num_iters; j++) {
+      timer batch_t; batch_t.start();
+      forest.BatchUpdate(vertices, values);
+      batch_times[j] = batch_t.stop();
+    }
+    const string batch_str{to_string(batch_size)};
+    const double batch_time{median(batch_times)};
+    timer::report_time_no_newline("batch-" + batch_str, batch_time);
+    timer::report_time_no_newline(
+        "batch-updates-per-second-" + batch_str, batch_size / batch_time);
+
+    if (batch_size <= max_single_batch) {
+      vector<double> single_times(num_iters);
+      for (int j = 0; j < num_iters; j++) {
+        timer single_t; single_t.start();
+        for (long i = 0; i < batch_size; i++) {
+          forest.Update(vertices[i], values[i]);
+        }
+        single_times[j] = single_t.stop();
+      }
+      const double single_time{median(single_times)};
+      timer::report_time_no_newline("single-" + batch_str, single_time);
+      timer::report_time_no_newline(
+          "single-updates-per-second-" + batch_str, batch_size / single_time);
+    }
+    std::cout << std::endl;
+  }
+
+  pbbs::delete_array(edges, m);
+  return 0;
+}
@@ -0,0 +1,101 @@
+#include <algorithm>
+#include <chrono>
+#include <future>
+#include <iostream>
+#include <random>
+#include <string>
+#include <thread>
+#include <utility>
+#include <vector>
+
+#include <dynamic_trees/parallel_euler_tour_tree/include/concurrent_front_end.hpp>
+#include <dynamic_trees/parallel_euler_tour_tree/include/euler_tour_tree.hpp>
+
+#include <dynamic_trees/benchmarks/benchmark.hpp>
+
+// Measures the throughput and latency of single calls made through
+// `ConcurrentFrontEnd` by `-clients` threads at once, for batch windows from 0
+// microseconds up to `-max-window`, going up by factors of 10.
+//
+// Each client makes `-calls` calls one after another, waiting for each to
+// complete. A fraction `-query-fraction` of the calls are connectivity queries
+// between random vertices, and the rest are links or cuts of random edges of
+// the input graph, which must form a forest. Half of the edges start linked.
+int main(int argc, char** argv) {
+  commandLine P{argc, argv,
+    "[-clients] [-calls] [-query-fraction] [-max-window] graph_filename"};
+  int num_clients{P.getOptionIntValue("-clients", 16)};
+  int num_calls{P.getOptionIntValue("-calls", 2000)};
+  double query_fraction{P.getOptionDoubleValue("-query-fraction", 0.5)};
+  int max_window{P.getOptionIntValue("-max-window", 1000)};
+  char* graph_filename{P.getArgument(0)};
+
+  std::cout << "Running with " << parlay::num_workers() << " workers" << std::endl;
+  dynamic_trees_benchmark::ReadGraphOutput graph_info{
+    dynamic_trees_benchmark::ReadGraph(graph_filename)};
+  const int n{graph_info.num_vertices};
+  const int m{graph_info.num_edges};
+  std::pair<int, int>* edges{graph_info.edges};
+  std::mt19937 generator{0};
+  std::shuffle(edges, edges + m, generator);
+
+  using Forest = parallel_euler_tour_tree::EulerTourTree<int>;
+  Forest forest{n};
+  forest.BatchLink(edges, m / 2);
+
+  for (int window = 0; window <= max_window; window = std::max(10, window * 10)) {
+    vector<double> latencies(static_cast<size_t>(num_clients) * num_calls);
+    size_t num_batches;
+    timer total_t; total_t.start();
+    {
+      parallel_euler_tour_tree::ConcurrentFrontEnd<Forest> front_end{
+        &forest, std::chrono::microseconds{window}};
+      std::vector<std::thread> clients;
+      for (int c = 0; c < num_clients; c++) {
+        clients.emplace_back([&, c] {
+          std::mt19937 client_generator(window * num_clients + c);
+          std::uniform_int_distribution<int> any_vertex{0, n - 1};
+          std::uniform_int_distribution<int> any_edge{0, m - 1};
+          std::uniform_real_distribution<double> any_fraction{0.0, 1.0};
+          for (int i = 0; i < num_calls; i++) {
+            const auto start{std::chrono::steady_clock::now()};
+            std::future<bool> result;
+            if (any_fraction(client_generator) < query_fraction) {
+              result = front_end.IsConnected(
+                  any_vertex(client_generator), any_vertex(client_generator));
+            } else {
+              const std::pair<int, int> edge{edges[any_edge(client_generator)]};
+              result = client_generator() % 2 == 0
+                ? front_end.Link(edge.first, edge.second)
+                : front_end.Cut(edge.first, edge.second);
+            }
+            result.wait();
+            latencies[static_cast<size_t>(c) * num_calls + i] =
+              std::chrono::duration<double>(
+                  std::chrono::steady_clock::now() - start).count();
+          }
+        });
+      }
+      for (std::thread& client : clients) {
+        client.join();
+      }
+      num_batches = front_end.NumBatches();
+    }
+    const double total_time{total_t.stop()};
+
+    std::sort(latencies.begin(), latencies.end());
+    const string window_str{to_string(window)};
+    timer::report_time_no_newline(
+        "calls-per-second-" + window_str, latencies.size() / total_time);
+    timer::report_time_no_newline(
+        "calls-per-batch-" + window_str,
+        static_cast<double>(latencies.size()) / num_batches);
+    timer::report_time_no_newline(
+        "median-latency-" + window_str, latencies[latencies.size() / 2]);
+    timer::report_time(
+        "p99-latency-" + window_str, latencies[latencies.size() * 99 / 100]);
+  }
+
+  pbbs::delete_array(edges, m);
+  return 0;
+}
@@ -0,0 +1,91 @@
+#include <algorithm>
+#include <iostream>
+#include <random>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include <dynamic_trees/parallel_euler_tour_tree/include/euler_tour_tree.hpp>
+
+#include <dynamic_trees/benchmarks/benchmark.hpp>
+
+// Compares answering a batch of connectivity queries with `BatchIsConnected`
+// against calling `IsConnected` on each query in a parallel loop.
+//
+// The forest is built from a random subset of the input graph's edges (which
+// must form a forest), so that queries hit a mix of connected and disconnected
+// pairs. Queries draw their first endpoint from a small set of "hot" vertices
+// and their second from all vertices. The queries are run again after caching
+// component identifiers with `CacheComponentIds`.
+int main(int argc, char** argv) {
+  commandLine P{argc, argv,
+    "[-iters] [-link-fraction] [-hot-vertices] graph_filename"};
+  int num_iters{P.getOptionIntValue("-iters", 4)};
+  double link_fraction{P.getOptionDoubleValue("-link-fraction", 0.9)};
+  int num_hot{P.getOptionIntValue("-hot-vertices", 1000)};
+  char* graph_filename{P.getArgument(0)};
+
+  std::cout << "Running with " << parlay::num_workers() << " workers" << std::endl;
+  dynamic_trees_benchmark::ReadGraphOutput graph_info{
+    dynamic_trees_benchmark::ReadGraph(graph_filename)};
+  const int n{graph_info.num_vertices};
+  const int m{graph_info.num_edges};
+  std::pair<int, int>* edges{graph_info.edges};
+  std::mt19937 generator{0};
+  std::shuffle(edges, edges + m, generator);
+
+  parallel_euler_tour_tree::EulerTourTree<int> forest{n};
+  forest.BatchLink(edges, static_cast<int>(link_fraction * m));
+  num_hot = std::min(num_hot, n);
+
+  // Reports query times under the given label prefix. Returns false if the
+  // answers disagree.
+  const auto run_queries{[&] (const string& prefix) {
+    for (int batch_size = 1000; batch_size <= n; batch_size *= 10) {
+      std::uniform_int_distribution<int> hot_vertex{0, num_hot - 1};
+      std::uniform_int_distribution<int> any_vertex{0, n - 1};
+      parlay::sequence<std::pair<int, int>> queries(batch_size);
+      for (int i = 0; i < batch_size; i++) {
+        queries[i] = {hot_vertex(generator), any_vertex(generator)};
+      }
+
+      vector<double> single_times(num_iters);
+      vector<double> batch_times(num_iters);
+      parlay::sequence<bool> single_answers(batch_size);
+      parlay::sequence<bool> batch_answers;
+      for (int j = 0; j < num_iters; j++) {
+        timer single_t; single_t.start();
+        parallel_for (0, batch_size, [&] (size_t i) {
+          single_answers[i] = forest.IsConnected(queries[i].first, queries[i].second);
+        });
+        single_times[j] = single_t.stop();
+
+        timer batch_t; batch_t.start();
+        batch_answers = forest.BatchIsConnected(queries);
+        batch_times[j] = batch_t.stop();
+      }
+      if (single_answers != batch_answers) {
+        std::cerr << "BatchIsConnected disagrees with IsConnected" << std::endl;
+        return false;
+      }
+      const string batch_str{to_string(batch_size)};
+      timer::report_time_no_newline(
+          prefix + "single-" + batch_str, median(single_times));
+      timer::report_time(prefix + "batch-" + batch_str, median(batch_times));
+    }
+    return true;
+  }};
+
+  if (!run_queries("")) {
+    return 1;
+  }
+  timer cache_t; cache_t.start();
+  forest.CacheComponentIds();
+  timer::report_time("cache-component-ids", cache_t.stop());
+  if (!run_queries("cached-")) {
+    return 1;
+  }
+
+  pbbs::delete_array(edges, m);
+  return 0;
+}
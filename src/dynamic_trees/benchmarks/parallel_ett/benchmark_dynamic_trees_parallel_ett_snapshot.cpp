@@ -0,0 +1,124 @@
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <iostream>
+#include <mutex>
+#include <random>
+#include <shared_mutex>
+#include <string>
+#include <thread>
+#include <utility>
+#include <vector>
+
+#include <dynamic_trees/parallel_euler_tour_tree/include/euler_tour_tree.hpp>
+
+#include <dynamic_trees/benchmarks/benchmark.hpp>
+
+// Measures the latency of connectivity queries made by `-readers` threads while
+// another thread continuously updates the forest, with readers either querying
+// published snapshots or taking a shared lock that updates hold exclusively.
+//
+// The forest starts with half of the input graph's edges, which must form a
+// forest. Each of `-rounds` update rounds cuts `-batch` random linked edges,
+// links `-batch` random unlinked edges, and then publishes a snapshot or
+// releases the lock.
+int main(int argc, char** argv) {
+  commandLine P{argc, argv,
+    "[-readers] [-rounds] [-batch] graph_filename"};
+  int num_readers{P.getOptionIntValue("-readers", 4)};
+  int num_rounds{P.getOptionIntValue("-rounds", 20)};
+  int batch_size{P.getOptionIntValue("-batch", 10000)};
+  char* graph_filename{P.getArgument(0)};
+
+  std::cout << "Running with " << parlay::num_workers() << " workers" << std::endl;
+  dynamic_trees_benchmark::ReadGraphOutput graph_info{
+    dynamic_trees_benchmark::ReadGraph(graph_filename)};
+  const int n{graph_info.num_vertices};
+  const int m{graph_info.num_edges};
+  std::pair<int, int>* edges{graph_info.edges};
+  batch_size = std::min(batch_size, m / 2);
+
+  for (const bool use_snapshots : {true, false}) {
+    std::mt19937 generator{0};
+    std::shuffle(edges, edges + m, generator);
+    parallel_euler_tour_tree::EulerTourTree<int> forest{n};
+    // Edges [0, m / 2) are linked.
+    forest.BatchLink(edges, m / 2);
+    if (use_snapshots) {
+      forest.PublishSnapshot();
+    }
+
+    std::shared_mutex lock;
+    std::atomic<bool> done{false};
+    vector<vector<double>> latencies(num_readers);
+    std::vector<std::thread> readers;
+    for (int r = 0; r < num_readers; r++) {
+      readers.emplace_back([&, r] {
+        std::mt19937 reader_generator(r);
+        std::uniform_int_distribution<int> any_vertex{0, n - 1};
+        while (!done.load()) {
+          const int u{any_vertex(reader_generator)};
+          const int v{any_vertex(reader_generator)};
+          const auto start{std::chrono::steady_clock::now()};
+          if (use_snapshots) {
+            forest.GetSnapshot()->IsConnected(u, v);
+          } else {
+            std::shared_lock<std::shared_mutex> read_lock{lock};
+            forest.IsConnected(u, v);
+          }
+          latencies[r].push_back(std::chrono::duration<double>(
+                std::chrono::steady_clock::now() - start).count());
+        }
+      });
+    }
+
+    timer update_t; update_t.start();
+    for (int i = 0; i < num_rounds; i++) {
+      // Swap random linked and unlinked edges into the ends of the two ranges,
+      // then cut and link those.
+      for (int j = 0; j < batch_size; j++) {
+        std::swap(edges[m / 2 - 1 - j], edges[generator() % (m / 2 - j)]);
+        std::swap(edges[m / 2 + j],
+                  edges[m / 2 + j + generator() % (m - m / 2 - j)]);
+      }
+      std::unique_lock<std::shared_mutex> write_lock{lock, std::defer_lock};
+      if (!use_snapshots) {
+        write_lock.lock();
+      }
+      forest.BatchCut(edges + m / 2 - batch_size, batch_size);
+      forest.BatchLink(edges + m / 2, batch_size);
+      if (use_snapshots) {
+        forest.PublishSnapshot();
+      } else {
+        write_lock.unlock();
+      }
+      std::rotate(edges + m / 2 - batch_size, edges + m / 2,
+                  edges + m / 2 + batch_size);
+    }
+    const double update_time{update_t.stop()};
+    done = true;
+    for (std::thread& reader : readers) {
+      reader.join();
+    }
+
+    vector<double> all_latencies;
+    for (const vector<double>& reader_latencies : latencies) {
+      all_latencies.insert(all_latencies.end(),
+          reader_latencies.begin(), reader_latencies.end());
+    }
+    std::sort(all_latencies.begin(), all_latencies.end());
+    const string prefix{use_snapshots ? "snapshot-" : "locked-"};
+    timer::report_time_no_newline(
+        prefix + "update-rounds-per-second", num_rounds / update_time);
+    timer::report_time_no_newline(
+        prefix + "queries-per-second", all_latencies.size() / update_time);
+    timer::report_time_no_newline(prefix + "median-latency",
+        all_latencies[all_latencies.size() / 2]);
+    timer::report_time_no_newline(prefix + "p99-latency",
+        all_latencies[all_latencies.size() * 99 / 100]);
+    timer::report_time(prefix + "max-latency", all_latencies.back());
+  }
+
+  pbbs::delete_array(edges, m);
+  return 0;
+}
@@ -0,0 +1,12 @@
+#include <dynamic_trees/parallel_euler_tour_tree/include/euler_tour_tree.hpp>
+
+#include <dynamic_trees/benchmarks/benchmark.hpp>
+
+// Same as benchmark_dynamic_trees_parallel_ett but with the aggregate function
+// fixed at compile time rather than held in a `std::function`.
+int main(int argc, char** argv) {
+  dynamic_trees_benchmark::RunBenchmark<
+      parallel_euler_tour_tree::EulerTourTree<
+          int, parallel_skip_list::SumAggregate<int>>>(argc, argv);
+  return 0;
+}
@@ -0,0 +1,140 @@
+#include <cstdint>
+#include <iostream>
+#include <random>
+#include <string>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+#include <dynamic_trees/parallel_euler_tour_tree/include/euler_tour_tree.hpp>
+
+#include <dynamic_trees/benchmarks/benchmark.hpp>
+
+namespace {
+
+// Polynomial hash of a sequence of vertices modulo 2^64. The hash of a
+// concatenation depends on the order of its parts, so the aggregate is not
+// commutative.
+struct Hash {
+  uint64_t hash;
+  uint64_t power;
+
+  bool operator==(const Hash& other) const {
+    return hash == other.hash && power == other.power;
+  }
+};
+
+struct HashAggregate {
+  Hash operator()(const Hash& x, const Hash& y) const {
+    return {x.hash * y.power + y.hash, x.power * y.power};
+  }
+  Hash Identity() const { return {0, 1}; }
+};
+
+constexpr uint64_t kBase{1000003};
+
+}  // namespace
+
+// Checks `TourAggregateFrom` and `BatchTourAggregateFrom` on random vertices
+// against hashing each tour in a linear scan from the vertex, and reports the
+// time taken by each.
+//
+// The forest is built from a random subset of the input graph's edges (which
+// must form a forest), and then the queries are run again after cutting and
+// relinking a batch of edges.
+int main(int argc, char** argv) {
+  commandLine P{argc, argv,
+    "[-iters] [-queries] [-link-fraction] graph_filename"};
+  int num_iters{P.getOptionIntValue("-iters", 4)};
+  int num_queries{P.getOptionIntValue("-queries", 100)};
+  double link_fraction{P.getOptionDoubleValue("-link-fraction", 0.9)};
+  char* graph_filename{P.getArgument(0)};
+
+  std::cout << "Running with " << parlay::num_workers() << " workers" << std::endl;
+  dynamic_trees_benchmark::ReadGraphOutput graph_info{
+    dynamic_trees_benchmark::ReadGraph(graph_filename)};
+  const int n{graph_info.num_vertices};
+  const int m{graph_info.num_edges};
+  std::pair<int, int>* edges{graph_info.edges};
+  std::mt19937 generator{0};
+  std::shuffle(edges, edges + m, generator);
+  const int num_links{static_cast<int>(link_fraction * m)};
+
+  using Forest = parallel_euler_tour_tree::EulerTourTree<Hash, HashAggregate>;
+  Forest forest{n};
+  forest.BatchUpdate(
+      parlay::tabulate(n, [] (size_t i) { return static_cast<int>(i); }),
+      parlay::tabulate(n, [] (size_t i) { return Hash{i + 1, kBase}; }));
+  forest.BatchLink(edges, num_links);
+
+  // Hashes the tour from `v` one element at a time.
+  const auto scan{[&] (int v) {
+    const HashAggregate aggregate;
+    Hash sum{aggregate.Identity()};
+    using Element = std::remove_pointer_t<decltype(forest.vertices_)>;
+    const Element* curr{&forest.vertices_[v]};
+    do {
+      const int vertex{static_cast<int>(curr - forest.vertices_)};
+      if (0 <= vertex && vertex < n) {
+        sum = aggregate(sum, Hash{static_cast<uint64_t>(vertex) + 1, kBase});
+      }
+      curr = static_cast<const Element*>(curr->GetNextElement());
+    } while (curr != &forest.vertices_[v]);
+    return sum;
+  }};
+
+  // Reports query times under the given label prefix. Returns false if the
+  // answers disagree.
+  const auto run_queries{[&] (const string& prefix) {
+    std::uniform_int_distribution<int> any_vertex{0, n - 1};
+    parlay::sequence<int> queries(num_queries);
+    for (int i = 0; i < num_queries; i++) {
+      queries[i] = any_vertex(generator);
+    }
+
+    vector<double> scan_times(num_iters);
+    vector<double> single_times(num_iters);
+    vector<double> batch_times(num_iters);
+    parlay::sequence<Hash> scan_answers(num_queries);
+    parlay::sequence<Hash> single_answers(num_queries);
+    parlay::sequence<Hash> batch_answers;
+    for (int j = 0; j < num_iters; j++) {
+      timer scan_t; scan_t.start();
+      parallel_for (0, num_queries, [&] (size_t i) {
+        scan_answers[i] = scan(queries[i]);
+      });
+      scan_times[j] = scan_t.stop();
+
+      timer single_t; single_t.start();
+      for (int i = 0; i < num_queries; i++) {
+        single_answers[i] = forest.TourAggregateFrom(queries[i]);
+      }
+      single_times[j] = single_t.stop();
+
+      timer batch_t; batch_t.start();
+      batch_answers = forest.BatchTourAggregateFrom(queries);
+      batch_times[j] = batch_t.stop();
+    }
+    if (single_answers != scan_answers || batch_answers != scan_answers) {
+      std::cerr << "TourAggregateFrom disagrees with a linear scan" << std::endl;
+      return false;
+    }
+    timer::report_time_no_newline(prefix + "scan", median(scan_times));
+    timer::report_time_no_newline(prefix + "single", median(single_times));
+    timer::report_time(prefix + "batch", median(batch_times));
+    return true;
+  }};
+
+  if (!run_queries("")) {
+    return 1;
+  }
+  const int num_relinks{std::min(num_links, 1000)};
+  forest.BatchCut(edges, num_relinks);
+  forest.BatchLink(edges, num_relinks);
+  if (!run_queries("relinked-")) {
+    return 1;
+  }
+
+  pbbs::delete_array(edges, m);
+  return 0;
+}
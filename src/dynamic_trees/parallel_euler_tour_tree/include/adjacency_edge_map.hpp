@@ -0,0 +1,457 @@
+#pragma once
+
+#include <algorithm>
+#include <cstdint>
+#include <tuple>
+#include <utility>
+
+#include <parlay/primitives.h>
+#include <parlay/sequence.h>
+
+#include <dynamic_trees/parallel_euler_tour_tree/include/edge_map.hpp>
+#include <utilities/include/utils.h>
+
+namespace parallel_euler_tour_tree {
+
+namespace _internal {
+
+// Used in Euler tour tree for mapping directed edges (pairs of ints) to the
+// sequence element in the Euler tour representing the edge. This edge store
+// (see `AdjacencyEdges`) keeps a list of incident edges for every vertex
+// instead of hashing. Vertex ids are dense, so the lists live in one array
+// indexed by vertex, each list in its own cache line with room for a few
+// entries inline and an overflow array for the rest.
+//
+// Both directions of an edge are stored: u's list holds (v, uv) and v's list
+// holds (u, vu), and each entry records the position of the other. `Find` scans
+// the shorter of the two lists, so most lookups in low-degree forests touch one
+// cache line and no hashing. A high-degree vertex such as the center of a star
+// only costs lookups between two high-degree vertices, which a forest has few
+// of. Deleting an edge finds its entry in the longer list through the entry in
+// the shorter one and fills the hole with the list's last entry, so deletions
+// never scan a long list either.
+//
+// Batch updates group edge endpoints by vertex with an integer sort and let one
+// task update each vertex's list, so updates need no atomics.
+//
+// `Find` may run concurrently with other `Find` calls.
+template<typename Element>
+class AdjacencyEdgeMap {
+ public:
+  AdjacencyEdgeMap() = delete;
+  explicit AdjacencyEdgeMap(int num_vertices);
+  ~AdjacencyEdgeMap();
+  AdjacencyEdgeMap(const AdjacencyEdgeMap&) = delete;
+  AdjacencyEdgeMap(AdjacencyEdgeMap&&) = delete;
+  AdjacencyEdgeMap& operator=(const AdjacencyEdgeMap&) = delete;
+  AdjacencyEdgeMap& operator=(AdjacencyEdgeMap&&) = delete;
+
+  // Adds edge {`u`, `v`}, which must not be present, represented by `edge` in
+  // direction (`u`, `v`). The twin of `edge` must already be set.
+  void Insert(int u, int v, Element* edge);
+  // Removes edge {`u`, `v`}, which must be present.
+  void Delete(int u, int v);
+  // Returns the element representing edge {`u`, `v`} in direction (`u`, `v`),
+  // or null if the edge is absent.
+  Element* Find(int u, int v) const;
+
+  // Adds the `len` edges in `edges`, where `edges[i]` is represented by
+  // `edge_elements[i]`. The edges must be distinct and not present.
+  void BatchInsert(const std::pair<int, int>* edges,
+      Element* const* edge_elements, int len);
+  // Removes the `len` edges in `edges`, which must be distinct and present.
+  void BatchDelete(const std::pair<int, int>* edges, int len);
+
+  // Probe lengths count the entries `Find` scans to reach a stored edge. There
+  // are never tombstones.
+  EdgeMapStats Stats() const;
+
+ private:
+  struct Entry {
+    int neighbor;
+    // Position of the reverse entry in `neighbor`'s list.
+    int twin_index;
+    // Represents the edge from the list's vertex to `neighbor`.
+    Element* edge;
+  };
+  static constexpr int kInlineCapacity{3};
+  struct alignas(64) Adjacency {
+    int degree;
+    int overflow_capacity;
+    // Entries `kInlineCapacity`, ..., `degree - 1`.
+    Entry* overflow;
+    Entry inline_entries[kInlineCapacity];
+  };
+  // In `BatchDelete`, an entry of `vertex`'s list moved from position `from`
+  // to position `to`.
+  struct Move {
+    uint32_t vertex;
+    int from;
+    int to;
+  };
+
+  Entry& EntryAt(int v, int i);
+  const Entry& EntryAt(int v, int i) const;
+  // Returns the position of `neighbor` in `v`'s list, or -1 if it is absent.
+  int IndexOf(int v, int neighbor) const;
+  // Makes room for `degree` entries in `v`'s list.
+  void Reserve(int v, int degree);
+  // Removes the entry at position `i` of `v`'s list by moving the last entry
+  // into its place.
+  void RemoveAt(int v, int i);
+  // Frees the overflow array of `v`'s list once the entries fit inline with
+  // room to spare, so that a vertex whose degree hovers around
+  // `kInlineCapacity` does not allocate on every update.
+  void ShrinkIfSparse(int v);
+
+  // True if `Find(u, v)` scans u's list rather than v's.
+  bool ScansFirst(int u, int v) const;
+  // Returns the positions of the entries for (`u`, `v`) in u's list and for
+  // (`v`, `u`) in v's list.
+  std::pair<int, int> Locate(int u, int v) const;
+
+  int num_vertices_;
+  Adjacency* adjacencies_;
+};
+
+template<typename Element>
+AdjacencyEdgeMap<Element>::AdjacencyEdgeMap(int num_vertices)
+    : num_vertices_{num_vertices}
+    , adjacencies_{pbbs::new_array_no_init<Adjacency>(num_vertices)} {
+  parallel_for (0, num_vertices_, [&] (size_t i) {
+    adjacencies_[i].degree = 0;
+    adjacencies_[i].overflow_capacity = 0;
+    adjacencies_[i].overflow = nullptr;
+  });
+}
+
+template<typename Element>
+AdjacencyEdgeMap<Element>::~AdjacencyEdgeMap() {
+  parallel_for (0, num_vertices_, [&] (size_t i) {
+    if (adjacencies_[i].overflow != nullptr) {
+      pbbs::delete_array(
+          adjacencies_[i].overflow, adjacencies_[i].overflow_capacity);
+    }
+  });
+  pbbs::delete_array(adjacencies_, num_vertices_);
+}
+
+template<typename Element>
+typename AdjacencyEdgeMap<Element>::Entry& AdjacencyEdgeMap<Element>::EntryAt(
+    int v, int i) {
+  Adjacency& adjacency{adjacencies_[v]};
+  return i < kInlineCapacity
+    ? adjacency.inline_entries[i]
+    : adjacency.overflow[i - kInlineCapacity];
+}
+
+template<typename Element>
+const typename AdjacencyEdgeMap<Element>::Entry&
+AdjacencyEdgeMap<Element>::EntryAt(int v, int i) const {
+  const Adjacency& adjacency{adjacencies_[v]};
+  return i < kInlineCapacity
+    ? adjacency.inline_entries[i]
+    : adjacency.overflow[i - kInlineCapacity];
+}
+
+template<typename Element>
+int AdjacencyEdgeMap<Element>::IndexOf(int v, int neighbor) const {
+  const int degree{adjacencies_[v].degree};
+  for (int i = 0; i < degree; i++) {
+    if (EntryAt(v, i).neighbor == neighbor) {
+      return i;
+    }
+  }
+  return -1;
+}
+
+template<typename Element>
+void AdjacencyEdgeMap<Element>::Reserve(int v, int degree) {
+  Adjacency& adjacency{adjacencies_[v]};
+  const int needed{degree - kInlineCapacity};
+  if (needed <= adjacency.overflow_capacity) {
+    return;
+  }
+  int capacity{std::max(adjacency.overflow_capacity, kInlineCapacity + 1)};
+  while (capacity < needed) {
+    capacity *= 2;
+  }
+  Entry* overflow{pbbs::new_array_no_init<Entry>(capacity)};
+  if (adjacency.overflow != nullptr) {
+    std::copy(adjacency.overflow, adjacency.overflow +
+        std::max(adjacency.degree - kInlineCapacity, 0), overflow);
+    pbbs::delete_array(adjacency.overflow, adjacency.overflow_capacity);
+  }
+  adjacency.overflow = overflow;
+  adjacency.overflow_capacity = capacity;
+}
+
+template<typename Element>
+void AdjacencyEdgeMap<Element>::RemoveAt(int v, int i) {
+  const int last{--adjacencies_[v].degree};
+  if (i != last) {
+    const Entry& moved{EntryAt(v, i) = EntryAt(v, last)};
+    EntryAt(moved.neighbor, moved.twin_index).twin_index = i;
+  }
+}
+
+template<typename Element>
+void AdjacencyEdgeMap<Element>::ShrinkIfSparse(int v) {
+  Adjacency& adjacency{adjacencies_[v]};
+  if (adjacency.overflow != nullptr &&
+      adjacency.degree <= kInlineCapacity / 2) {
+    pbbs::delete_array(adjacency.overflow, adjacency.overflow_capacity);
+    adjacency.overflow = nullptr;
+    adjacency.overflow_capacity = 0;
+  }
+}
+
+template<typename Element>
+bool AdjacencyEdgeMap<Element>::ScansFirst(int u, int v) const {
+  const int u_degree{adjacencies_[u].degree};
+  const int v_degree{adjacencies_[v].degree};
+  return u_degree < v_degree || (u_degree == v_degree && u < v);
+}
+
+template<typename Element>
+std::pair<int, int> AdjacencyEdgeMap<Element>::Locate(int u, int v) const {
+  if (ScansFirst(u, v)) {
+    const int i{IndexOf(u, v)};
+    return std::make_pair(i, EntryAt(u, i).twin_index);
+  } else {
+    const int i{IndexOf(v, u)};
+    return std::make_pair(EntryAt(v, i).twin_index, i);
+  }
+}
+
+template<typename Element>
+void AdjacencyEdgeMap<Element>::Insert(int u, int v, Element* edge) {
+  const int u_index{adjacencies_[u].degree};
+  const int v_index{adjacencies_[v].degree};
+  Reserve(u, u_index + 1);
+  Reserve(v, v_index + 1);
+  EntryAt(u, u_index) = Entry{v, v_index, edge};
+  EntryAt(v, v_index) = Entry{u, u_index, edge->GetTwin()};
+  adjacencies_[u].degree++;
+  adjacencies_[v].degree++;
+}
+
+template<typename Element>
+void AdjacencyEdgeMap<Element>::Delete(int u, int v) {
+  int u_index, v_index;
+  std::tie(u_index, v_index) = Locate(u, v);
+  // Removing from u's list only moves entries of u's list and updates entries
+  // of lists other than v's, so `v_index` stays valid.
+  RemoveAt(u, u_index);
+  RemoveAt(v, v_index);
+  ShrinkIfSparse(u);
+  ShrinkIfSparse(v);
+}
+
+template<typename Element>
+Element* AdjacencyEdgeMap<Element>::Find(int u, int v) const {
+  if (ScansFirst(u, v)) {
+    const int i{IndexOf(u, v)};
+    return i == -1 ? nullptr : EntryAt(u, i).edge;
+  } else {
+    const int i{IndexOf(v, u)};
+    return i == -1 ? nullptr : EntryAt(v, i).edge->GetTwin();
+  }
+}
+
+template<typename Element>
+void AdjacencyEdgeMap<Element>::BatchInsert(const std::pair<int, int>* edges,
+    Element* const* edge_elements, int len) {
+  // `arcs` holds (x, j) for the `j`-th directed edge, which starts at vertex
+  // x. Directed edge `2 * i` is `edges[i]`, and `2 * i + 1` is its reverse.
+  parlay::sequence<std::pair<uint32_t, uint32_t>> arcs = parlay::tabulate(
+      2 * len, [&] (size_t j) {
+        return std::make_pair(static_cast<uint32_t>(
+            j % 2 == 0 ? edges[j / 2].first : edges[j / 2].second),
+            static_cast<uint32_t>(j));
+      });
+  parlay::integer_sort_inplace(arcs,
+      [] (const std::pair<uint32_t, uint32_t>& arc) { return arc.first; });
+  const parlay::sequence<int> group_starts{parlay::pack_index<int>(
+      parlay::delayed_seq<bool>(2 * len, [&] (size_t p) {
+        return p == 0 || arcs[p].first != arcs[p - 1].first;
+      }))};
+  const auto group_end{[&] (size_t g) {
+    return g + 1 < group_starts.size() ? group_starts[g + 1] : 2 * len;
+  }};
+
+  // Directed edge j goes at position `positions[j]` of its tail's list.
+  parlay::sequence<int> positions(2 * len);
+  parallel_for (0, group_starts.size(), [&] (size_t g) {
+    const int start{group_starts[g]};
+    const int degree{adjacencies_[arcs[start].first].degree};
+    for (int p = start; p < group_end(g); p++) {
+      positions[arcs[p].second] = degree + (p - start);
+    }
+  });
+  parallel_for (0, group_starts.size(), [&] (size_t g) {
+    const int start{group_starts[g]};
+    const int end{group_end(g)};
+    const uint32_t v{arcs[start].first};
+    Reserve(v, adjacencies_[v].degree + (end - start));
+    for (int p = start; p < end; p++) {
+      const uint32_t j{arcs[p].second};
+      const std::pair<int, int>& edge{edges[j / 2]};
+      Element* uv{edge_elements[j / 2]};
+      EntryAt(v, positions[j]) = j % 2 == 0
+        ? Entry{edge.second, positions[j + 1], uv}
+        : Entry{edge.first, positions[j - 1], uv->GetTwin()};
+    }
+    adjacencies_[v].degree += end - start;
+  });
+}
+
+// Deleting a vertex's entries fills the holes below the new end of its list
+// with the surviving entries past the new end. Moving an entry invalidates the
+// twin index of its reverse entry, whose own position may move in the same
+// batch, so the twin indices are fixed after all lists are compacted.
+template<typename Element>
+void AdjacencyEdgeMap<Element>::BatchDelete(
+    const std::pair<int, int>* edges, int len) {
+  // `holes` holds x * 2^32 + i for each directed edge (x, y), where i is its
+  // position in x's list, sorted by x and then by i.
+  parlay::sequence<uint64_t> holes(2 * len);
+  parallel_for (0, len, [&] (size_t i) {
+    int u, v;
+    std::tie(u, v) = edges[i];
+    int u_index, v_index;
+    std::tie(u_index, v_index) = Locate(u, v);
+    holes[2 * i] = static_cast<uint64_t>(u) << 32 | u_index;
+    holes[2 * i + 1] = static_cast<uint64_t>(v) << 32 | v_index;
+  });
+  parlay::integer_sort_inplace(holes, [] (uint64_t hole) { return hole; });
+  const auto vertex_of{[&] (size_t p) {
+    return static_cast<uint32_t>(holes[p] >> 32);
+  }};
+  const auto index_of{[&] (size_t p) {
+    return static_cast<int>(holes[p] & 0xffffffff);
+  }};
+  const parlay::sequence<int> group_starts{parlay::pack_index<int>(
+      parlay::delayed_seq<bool>(2 * len, [&] (size_t p) {
+        return p == 0 || vertex_of(p) != vertex_of(p - 1);
+      }))};
+  const auto group_end{[&] (size_t g) {
+    return g + 1 < group_starts.size() ? group_starts[g + 1] : 2 * len;
+  }};
+
+  // Each hole below the new end of a list gets one surviving entry.
+  parlay::sequence<int> move_offsets = parlay::tabulate(
+      group_starts.size(), [&] (size_t g) {
+        const int start{group_starts[g]};
+        const int end{group_end(g)};
+        const int new_degree{
+          adjacencies_[vertex_of(start)].degree - (end - start)};
+        int num_moves{0};
+        while (start + num_moves < end &&
+               index_of(start + num_moves) < new_degree) {
+          num_moves++;
+        }
+        return num_moves;
+      });
+  const size_t num_moves{
+    static_cast<size_t>(parlay::scan_inplace(move_offsets))};
+  parlay::sequence<Move> moves(num_moves);
+  parallel_for (0, group_starts.size(), [&] (size_t g) {
+    const int start{group_starts[g]};
+    const int end{group_end(g)};
+    const uint32_t v{vertex_of(start)};
+    const int degree{adjacencies_[v].degree};
+    const int new_degree{degree - (end - start)};
+    // Walk the surviving entries at or past `new_degree`, skipping the holes
+    // there, which are the last ones in the group.
+    int tail_hole{start};
+    while (tail_hole < end && index_of(tail_hole) < new_degree) {
+      tail_hole++;
+    }
+    int from{new_degree};
+    for (int p = start; p < end && index_of(p) < new_degree; p++) {
+      while (tail_hole < end && index_of(tail_hole) == from) {
+        tail_hole++;
+        from++;
+      }
+      const int to{index_of(p)};
+      EntryAt(v, to) = EntryAt(v, from);
+      moves[move_offsets[g] + (p - start)] = Move{v, from, to};
+      from++;
+    }
+    adjacencies_[v].degree = new_degree;
+    ShrinkIfSparse(v);
+  });
+
+  // Moves are sorted by vertex and then by original position. Returns the
+  // current position of the entry that was at position `i` of `v`'s list.
+  const auto current_index{[&] (uint32_t v, int i) {
+    const auto found{std::lower_bound(moves.begin(), moves.end(), Move{v, i, 0},
+        [] (const Move& a, const Move& b) {
+          return a.vertex < b.vertex || (a.vertex == b.vertex && a.from < b.from);
+        })};
+    return found != moves.end() && found->vertex == v && found->from == i
+      ? found->to : i;
+  }};
+  const parlay::sequence<std::pair<int, int>> reverse_entries = parlay::tabulate(
+      num_moves, [&] (size_t m) {
+        const Entry& entry{EntryAt(moves[m].vertex, moves[m].to)};
+        return std::make_pair(entry.neighbor,
+            current_index(entry.neighbor, entry.twin_index));
+      });
+  parallel_for (0, num_moves, [&] (size_t m) {
+    EntryAt(reverse_entries[m].first, reverse_entries[m].second).twin_index =
+      moves[m].to;
+  });
+}
+
+template<typename Element>
+EdgeMapStats AdjacencyEdgeMap<Element>::Stats() const {
+  // Each edge is counted at the endpoint whose list `Find` scans.
+  const auto probe_totals{parlay::delayed_seq<size_t>(num_vertices_,
+      [&] (size_t v) {
+        size_t total{0};
+        for (int i = 0; i < adjacencies_[v].degree; i++) {
+          if (ScansFirst(v, EntryAt(v, i).neighbor)) {
+            total += i + 1;
+          }
+        }
+        return total;
+      })};
+  const auto probe_maxima{parlay::delayed_seq<size_t>(num_vertices_,
+      [&] (size_t v) -> size_t {
+        for (int i = adjacencies_[v].degree - 1; i >= 0; i--) {
+          if (ScansFirst(v, EntryAt(v, i).neighbor)) {
+            return i + 1;
+          }
+        }
+        return 0;
+      })};
+  EdgeMapStats stats;
+  stats.num_edges = parlay::reduce(parlay::delayed_seq<size_t>(num_vertices_,
+      [&] (size_t v) -> size_t { return adjacencies_[v].degree; })) / 2;
+  stats.num_tombstones = 0;
+  stats.capacity = static_cast<size_t>(num_vertices_) * kInlineCapacity +
+    parlay::reduce(parlay::delayed_seq<size_t>(num_vertices_,
+        [&] (size_t v) -> size_t {
+          return adjacencies_[v].overflow_capacity;
+        }));
+  stats.mean_probe_length = stats.num_edges == 0 ? 0.0 :
+      static_cast<double>(parlay::reduce(probe_totals)) / stats.num_edges;
+  stats.max_probe_length =
+      parlay::reduce(probe_maxima, parlay::maximum<size_t>());
+  return stats;
+}
+
+}  // namespace _internal
+
+// Edge store policy for `EulerTourTree` that keeps a list of incident edges per
+// vertex (see `_internal::AdjacencyEdgeMap`). It avoids hashing and usually
+// finds an edge within one cache line, at the cost of memory proportional to
+// the number of vertices.
+struct AdjacencyEdges {
+  template<typename Element>
+  using Store = _internal::AdjacencyEdgeMap<Element>;
+};
+
+}  // namespace parallel_euler_tour_tree
@@ -0,0 +1,152 @@
+#pragma once
+
+#include <cstdint>
+#include <limits>
+#include <utility>
+
+#include <parlay/primitives.h>
+#include <parlay/sequence.h>
+
+#include <utilities/include/utils.h>
+
+namespace parallel_euler_tour_tree {
+
+namespace _internal {
+
+// Used in Euler tour tree to cache the component identifier (the index of the
+// representative element) of each vertex so that connectivity queries between
+// updates are array lookups rather than walks up the skip list.
+//
+// Each cached identifier is stamped with the version of its component at the
+// time it was computed. A component's version lives in `component_versions_`,
+// indexed by the component's identifier. Updating the forest bumps the version
+// of every component with a cached identifier that the update touches, which
+// makes exactly those identifiers stale. Components the update does not touch
+// keep their representatives and thus their cached identifiers.
+//
+// This relies on cached identifiers being computed for whole components at a
+// time, which `Refresh` does, so that a component either has all its vertices
+// cached or none of them.
+//
+// The cache starts disabled and uses no memory until `Enable` is called.
+// `Lookup` and `Find` may run concurrently with each other, but not with
+// `Invalidate` or `Refresh`.
+class ComponentIdCache {
+ public:
+  ComponentIdCache() = default;
+
+  // Allocates the cache for `num_vertices` vertices and component identifiers
+  // in [0, `num_ids`). All cached identifiers start out stale.
+  void Enable(int num_vertices, int num_ids);
+  bool IsEnabled() const { return !ids_.empty(); }
+
+  // Stores the cached identifier of vertex `v` in `*id` and returns true if
+  // it is up to date. Otherwise returns false.
+  bool Lookup(int v, size_t* id) const;
+
+  // Returns the component identifier of each vertex in `vertices`, using
+  // `find_ids` to compute the identifiers that are not cached. `find_ids` takes
+  // a `parlay::sequence<int>` of vertices and returns a
+  // `parlay::sequence<size_t>` of their identifiers.
+  template <typename FindIds>
+  parlay::sequence<size_t> Find(
+      const parlay::sequence<int>& vertices, const FindIds& find_ids) const;
+
+  // Marks stale the cached identifiers of the components containing the
+  // endpoints of the `len` edges in `edges`. Must be called before the edges
+  // are added to or removed from the forest.
+  void Invalidate(const std::pair<int, int>* edges, int len);
+
+  // Recomputes all stale cached identifiers using `find_ids` (see `Find`).
+  template <typename FindIds>
+  void Refresh(const FindIds& find_ids);
+
+ private:
+  // Number of calls to `Invalidate` so far, plus one. Versions never
+  // decrease, so a stale stamp never matches its component's version again.
+  uint64_t epoch_{1};
+  parlay::sequence<size_t> ids_;
+  // `stamps_[v]` is the version of the component `ids_[v]` when `ids_[v]` was
+  // computed.
+  parlay::sequence<uint64_t> stamps_;
+  parlay::sequence<uint64_t> component_versions_;
+};
+
+inline void ComponentIdCache::Enable(int num_vertices, int num_ids) {
+  ids_ = parlay::sequence<size_t>(num_vertices, 0);
+  stamps_ = parlay::sequence<uint64_t>(num_vertices, 0);
+  component_versions_ = parlay::sequence<uint64_t>(num_ids, epoch_);
+}
+
+inline bool ComponentIdCache::Lookup(int v, size_t* id) const {
+  if (!IsEnabled() || stamps_[v] != component_versions_[ids_[v]]) {
+    return false;
+  }
+  *id = ids_[v];
+  return true;
+}
+
+template <typename FindIds>
+parlay::sequence<size_t> ComponentIdCache::Find(
+    const parlay::sequence<int>& vertices, const FindIds& find_ids) const {
+  if (!IsEnabled()) {
+    return find_ids(vertices);
+  }
+  parlay::sequence<size_t> ids(vertices.size());
+  parlay::sequence<bool> is_cached = parlay::tabulate(vertices.size(),
+      [&] (size_t i) { return Lookup(vertices[i], &ids[i]); });
+  const parlay::sequence<int> misses{parlay::pack_index<int>(
+      parlay::delayed_seq<bool>(vertices.size(), [&] (size_t i) {
+        return !is_cached[i];
+      }))};
+  if (!misses.empty()) {
+    const parlay::sequence<size_t> miss_ids{find_ids(parlay::tabulate(
+        misses.size(), [&] (size_t i) { return vertices[misses[i]]; }))};
+    parallel_for (0, misses.size(), [&] (size_t i) {
+      ids[misses[i]] = miss_ids[i];
+    });
+  }
+  return ids;
+}
+
+inline void ComponentIdCache::Invalidate(
+    const std::pair<int, int>* edges, int len) {
+  if (!IsEnabled()) {
+    return;
+  }
+  epoch_++;
+  // Look up all the components before bumping any of their versions, and bump
+  // each component shared by several endpoints once.
+  constexpr size_t kNotCached{std::numeric_limits<size_t>::max()};
+  parlay::sequence<size_t> ids{parlay::filter(
+      parlay::tabulate(2 * len, [&] (size_t i) {
+        size_t id;
+        return Lookup(i % 2 == 0 ? edges[i / 2].first : edges[i / 2].second,
+            &id) ? id : kNotCached;
+      }),
+      [&] (size_t id) { return id != kNotCached; })};
+  parlay::integer_sort_inplace(ids, [] (size_t id) { return id; });
+  parallel_for (0, ids.size(), [&] (size_t i) {
+    if (i == 0 || ids[i] != ids[i - 1]) {
+      component_versions_[ids[i]] = epoch_;
+    }
+  });
+}
+
+template <typename FindIds>
+void ComponentIdCache::Refresh(const FindIds& find_ids) {
+  const parlay::sequence<int> stale{parlay::pack_index<int>(
+      parlay::delayed_seq<bool>(ids_.size(), [&] (size_t v) {
+        size_t id;
+        return !Lookup(v, &id);
+      }))};
+  const parlay::sequence<size_t> stale_ids{find_ids(stale)};
+  parallel_for (0, stale.size(), [&] (size_t i) {
+    ids_[stale[i]] = stale_ids[i];
+    stamps_[stale[i]] = component_versions_[stale_ids[i]];
+  });
+}
+
+}  // namespace _internal
+
+}  // namespace parallel_euler_tour_tree
@@ -0,0 +1,217 @@
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <future>
+#include <mutex>
+#include <thread>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+#include <parlay/sequence.h>
+
+namespace parallel_euler_tour_tree {
+
+// Lets many threads issue single links, cuts, and connectivity queries on an
+// `EulerTourTree` at once. Calls are pushed onto a lock-free queue and return
+// futures right away. A dedicated batcher thread gathers the calls that arrive
+// within `batch_window` of each other and applies them with the forest's batch
+// operations, completing the futures as it goes.
+//
+// The calls take effect in some order consistent with each thread's own order
+// of calls, and each future holds the result of its call in that order:
+// - `Link(u, v)` adds edge {`u`, `v`} and returns true unless `u` and `v` are
+//   already connected.
+// - `Cut(u, v)` removes edge {`u`, `v`} and returns true if it is present.
+// - `IsConnected(u, v)` returns whether `u` and `v` are connected.
+// Vertices must be in range, but links and cuts need not be valid, so callers
+// need not coordinate with each other.
+//
+// A call waits up to `batch_window`, plus the time to apply the batch in
+// progress, before its own batch starts. Longer windows make for larger, more
+// efficient batches at the cost of latency.
+//
+// The forest must not be used directly while the front end exists.
+template<typename Forest>
+class ConcurrentFrontEnd {
+ public:
+  ConcurrentFrontEnd(Forest* forest, std::chrono::microseconds batch_window);
+  // Waits for all calls made so far to complete.
+  ~ConcurrentFrontEnd();
+  ConcurrentFrontEnd(const ConcurrentFrontEnd&) = delete;
+  ConcurrentFrontEnd(ConcurrentFrontEnd&&) = delete;
+  ConcurrentFrontEnd& operator=(const ConcurrentFrontEnd&) = delete;
+  ConcurrentFrontEnd& operator=(ConcurrentFrontEnd&&) = delete;
+
+  std::future<bool> Link(int u, int v);
+  std::future<bool> Cut(int u, int v);
+  std::future<bool> IsConnected(int u, int v);
+
+  // Returns the number of batch operations applied to the forest so far.
+  size_t NumBatches() const { return num_batches_.load(); }
+
+ private:
+  enum class Kind { kCut, kLink, kIsConnected };
+  static constexpr size_t kNumKinds{3};
+
+  struct Call {
+    Kind kind;
+    std::thread::id caller;
+    std::pair<int, int> edge;
+    std::promise<bool> result;
+    Call* next;
+  };
+
+  std::future<bool> Submit(Kind kind, int u, int v);
+  void RunBatcher();
+  // Applies the calls in `calls`, which are in order of submission, with one
+  // batch operation per phase. Phases cycle through cuts, links, and queries.
+  // Each call goes in the first phase of its kind after the phase of the
+  // previous call of the same thread, so every thread has at most one call in
+  // each batch operation and these can be applied in any order.
+  void Apply(const std::vector<Call*>& calls);
+
+  Forest* const forest_;
+  const std::chrono::microseconds batch_window_;
+  // Stack of submitted calls that the batcher has not taken yet, newest first.
+  std::atomic<Call*> pending_{nullptr};
+  std::atomic<size_t> num_batches_{0};
+  // Guards only the batcher's sleeping and waking. Submitting does not take the
+  // lock unless the batcher may be asleep.
+  std::mutex mutex_;
+  std::condition_variable wake_;
+  bool stopping_{false};
+  std::thread batcher_;
+};
+
+///////////////////////////////////////////////////////////////////////////////
+//                           Implementation below.                           //
+///////////////////////////////////////////////////////////////////////////////
+
+template<typename Forest>
+ConcurrentFrontEnd<Forest>::ConcurrentFrontEnd(
+    Forest* forest, std::chrono::microseconds batch_window)
+  : forest_{forest}
+  , batch_window_{batch_window}
+  , batcher_{[this] { RunBatcher(); }} {}
+
+template<typename Forest>
+ConcurrentFrontEnd<Forest>::~ConcurrentFrontEnd() {
+  {
+    std::lock_guard<std::mutex> lock{mutex_};
+    stopping_ = true;
+  }
+  wake_.notify_one();
+  batcher_.join();
+}
+
+template<typename Forest>
+std::future<bool> ConcurrentFrontEnd<Forest>::Link(int u, int v) {
+  return Submit(Kind::kLink, u, v);
+}
+
+template<typename Forest>
+std::future<bool> ConcurrentFrontEnd<Forest>::Cut(int u, int v) {
+  return Submit(Kind::kCut, u, v);
+}
+
+template<typename Forest>
+std::future<bool> ConcurrentFrontEnd<Forest>::IsConnected(int u, int v) {
+  return Submit(Kind::kIsConnected, u, v);
+}
+
+template<typename Forest>
+std::future<bool> ConcurrentFrontEnd<Forest>::Submit(Kind kind, int u, int v) {
+  Call* call{new Call{kind, std::this_thread::get_id(), {u, v}, {}, nullptr}};
+  std::future<bool> result{call->result.get_future()};
+  Call* head{pending_.load(std::memory_order_relaxed)};
+  do {
+    call->next = head;
+  } while (!pending_.compare_exchange_weak(
+        head, call, std::memory_order_release, std::memory_order_relaxed));
+  // Only the call that makes the stack nonempty needs to wake the batcher. The
+  // batcher checks the stack under the lock before sleeping, so taking the
+  // lock here ensures that the wakeup is not lost.
+  if (head == nullptr) {
+    { std::lock_guard<std::mutex> lock{mutex_}; }
+    wake_.notify_one();
+  }
+  return result;
+}
+
+template<typename Forest>
+void ConcurrentFrontEnd<Forest>::RunBatcher() {
+  while (true) {
+    bool stopping;
+    {
+      std::unique_lock<std::mutex> lock{mutex_};
+      wake_.wait(lock, [&] {
+        return stopping_ || pending_.load(std::memory_order_relaxed) != nullptr;
+      });
+      stopping = stopping_;
+    }
+    if (!stopping && batch_window_.count() > 0) {
+      std::this_thread::sleep_for(batch_window_);
+    }
+    std::vector<Call*> calls;
+    for (Call* call{pending_.exchange(nullptr, std::memory_order_acquire)};
+         call != nullptr; call = call->next) {
+      calls.push_back(call);
+    }
+    if (calls.empty()) {
+      return;  // Only reachable when stopping.
+    }
+    std::reverse(calls.begin(), calls.end());
+    Apply(calls);
+  }
+}
+
+template<typename Forest>
+void ConcurrentFrontEnd<Forest>::Apply(const std::vector<Call*>& calls) {
+  std::vector<std::vector<Call*>> phases;
+  std::unordered_map<std::thread::id, size_t> next_phases;
+  for (Call* call : calls) {
+    size_t& next_phase{next_phases[call->caller]};
+    const size_t kind{static_cast<size_t>(call->kind)};
+    const size_t phase{next_phase +
+      (kind + kNumKinds - next_phase % kNumKinds) % kNumKinds};
+    if (phase >= phases.size()) {
+      phases.resize(phase + 1);
+    }
+    phases[phase].push_back(call);
+    next_phase = phase + 1;
+  }
+
+  for (const std::vector<Call*>& phase_calls : phases) {
+    if (phase_calls.empty()) {
+      continue;
+    }
+    parlay::sequence<std::pair<int, int>> edges(phase_calls.size());
+    for (size_t i = 0; i < phase_calls.size(); i++) {
+      edges[i] = phase_calls[i]->edge;
+    }
+
+    parlay::sequence<bool> results;
+    switch (phase_calls[0]->kind) {
+      case Kind::kCut:
+        results = forest_->BatchCutIfPresent(edges);
+        break;
+      case Kind::kLink:
+        results = forest_->BatchLinkIfAcyclic(edges);
+        break;
+      case Kind::kIsConnected:
+        results = forest_->BatchIsConnected(edges);
+        break;
+    }
+    num_batches_++;
+    for (size_t i = 0; i < phase_calls.size(); i++) {
+      phase_calls[i]->result.set_value(results[i]);
+      delete phase_calls[i];
+    }
+  }
+}
+
+}  // namespace parallel_euler_tour_tree
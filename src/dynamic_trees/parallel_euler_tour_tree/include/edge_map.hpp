@@ -1,8 +1,9 @@
 #pragma once
 
+#include <algorithm>
 #include <utility>
 #include <parlay/parallel.h>
-#include <parlay/alloc.h>
+#include <parlay/primitives.h>
 
 #include <utilities/include/concurrentMap.h>
 #include <utilities/include/hash_pair.hpp>
@@ -10,13 +11,31 @@
 
 namespace parallel_euler_tour_tree {
 
+// Statistics on the store that maps edges to their sequence elements in an
+// Euler tour tree.
+struct EdgeMapStats {
+  size_t num_edges;
+  size_t num_tombstones;
+  size_t capacity;
+  // Mean and maximum number of slots probed to find a stored edge.
+  double mean_probe_length;
+  size_t max_probe_length;
+};
+
 namespace _internal {
 
 // Used in Euler tour tree for mapping directed edges (pairs of ints) to the
-// sequence element in the Euler tour representing the edge.
+// sequence element in the Euler tour representing the edge. This is the
+// default edge store (see `HashEdges`), backed by a concurrent hash table.
+//
+// Only one of (u, v) and (v, u) is added to the table; we can find the other
+// edge using `GetTwin()` on `Element`.
 //
-// Only one of (u, v) and (v, u) should be added to the map; we can find the
-// other edge using the `twin_` pointer in `Element`.
+// `Find` may run concurrently with other `Find` calls. Between updates, the
+// table is rebuilt when it gets too full of edges and tombstones (which
+// deletions leave behind and only rebuilding clears). Rebuilding grows the
+// table as needed and keeps probe sequences short under long runs of
+// insertions and deletions.
 template<typename Element>
 class EdgeMap {
  public:
@@ -24,23 +43,59 @@ class EdgeMap {
   explicit EdgeMap(int num_vertices);
   ~EdgeMap();
 
-  bool Insert(int u, int v, Element* edge);
-  bool Delete(int u, int v);
-  Element* Find(int u, int v);
+  // Adds edge {`u`, `v`}, which must not be present, represented by `edge` in
+  // direction (`u`, `v`).
+  void Insert(int u, int v, Element* edge);
+  // Removes edge {`u`, `v`}, which must be present.
+  void Delete(int u, int v);
+  // Returns the element representing edge {`u`, `v`} in direction (`u`, `v`),
+  // or null if the edge is absent.
+  Element* Find(int u, int v) const;
 
-  // Deallocate all elements held in the map. This assumes that all elements
-  // in the map were allocated through `allocator`.
-  void FreeElements(parlay::type_allocator<Element>* allocator);
+  // Adds the `len` edges in `edges`, where `edges[i]` is represented by
+  // `edge_elements[i]`. The edges must be distinct and not present.
+  void BatchInsert(const std::pair<int, int>* edges,
+      Element* const* edge_elements, int len);
+  // Removes the `len` edges in `edges`, which must be distinct and present.
+  void BatchDelete(const std::pair<int, int>* edges, int len);
+
+  EdgeMapStats Stats() const;
 
   concurrent_map::concurrentHT<
       std::pair<int, int>, Element*, HashIntPairStruct> map_;
+
+ private:
+  // The table is rebuilt once live edges and tombstones may take up more than
+  // this fraction of it...
+  static constexpr double kMaxLoad{0.75};
+  // ...and a rebuilt table has at least this fraction of its slots empty.
+  static constexpr double kRebuildLoad{0.5};
+
+  // Rebuilds the table if `num_edges_` plus `num_inserts` more edges and
+  // `num_deletes_` tombstones would exceed `kMaxLoad`.
+  void RebuildIfFull(int num_inserts);
+  // Makes room for inserting `num_inserts` edges.
+  void PrepareInserts(int num_inserts);
+  // Records that `num_deletes` edges were deleted, compacting the table if it
+  // holds too many tombstones.
+  void FinishDeletes(int num_deletes);
+  // Inserts into or deletes from `map_` without bookkeeping. These may run
+  // concurrently with each other.
+  void InsertUnchecked(int u, int v, Element* edge);
+  void DeleteUnchecked(int u, int v);
+
+  // Number of edges in the map, counting those covered by `PrepareInserts`.
+  size_t num_edges_{0};
+  // Number of deletions since the last rebuild, which bounds the number of
+  // tombstones.
+  size_t num_deletes_{0};
 };
 
 
+// The table starts small and grows as edges are inserted.
 template<typename Element>
-EdgeMap<Element>::EdgeMap(int num_vertices)
-    : map_{nullptr, static_cast<size_t>(num_vertices - 1),
-          std::make_pair(-1, -1), std::make_pair(-2, -2)} {}
+EdgeMap<Element>::EdgeMap(int)
+    : map_{nullptr, 0, std::make_pair(-1, -1), std::make_pair(-2, -2)} {}
 
 template<typename Element>
 EdgeMap<Element>::~EdgeMap() {
@@ -48,47 +103,118 @@ EdgeMap<Element>::~EdgeMap() {
 }
 
 template<typename Element>
-bool EdgeMap<Element>::Insert(int u, int v, Element* edge) {
+void EdgeMap<Element>::InsertUnchecked(int u, int v, Element* edge) {
   if (u > v) {
     std::swap(u, v);
-    edge = edge->twin_;
+    edge = edge->GetTwin();
   }
-  return map_.insert(make_pair(u, v), edge);
+  map_.insert(make_pair(u, v), edge);
 }
 
 template<typename Element>
-bool EdgeMap<Element>::Delete(int u, int v) {
+void EdgeMap<Element>::DeleteUnchecked(int u, int v) {
   if (u > v) {
     std::swap(u, v);
   }
-  return map_.deleteVal(make_pair(u, v));
+  map_.deleteVal(make_pair(u, v));
 }
 
 template<typename Element>
-Element* EdgeMap<Element>::Find(int u, int v) {
-  if (u > v) {
-    Element* vu{*map_.find(make_pair(v, u))};
-    return vu == nullptr ? nullptr : vu->twin_;
-  } else {
-    return *map_.find(make_pair(u, v));
-  }
+void EdgeMap<Element>::Insert(int u, int v, Element* edge) {
+  PrepareInserts(1);
+  InsertUnchecked(u, v, edge);
 }
 
 template<typename Element>
-void EdgeMap<Element>::FreeElements(parlay::type_allocator<Element>* allocator) {
-  parallel_for (0, map_.capacity, [&] (size_t i) {
-    auto kv{map_.table[i]};
-    auto key{get<0>(kv)};
-    if (key != map_.empty_key && key != map_.tombstone) {
-      Element* element{get<1>(kv)};
-      element->twin_->~Element();
-      allocator->free(element->twin_);
-      element->~Element();
-      allocator->free(element);
-    }
+void EdgeMap<Element>::Delete(int u, int v) {
+  DeleteUnchecked(u, v);
+  FinishDeletes(1);
+}
+
+template<typename Element>
+void EdgeMap<Element>::BatchInsert(const std::pair<int, int>* edges,
+    Element* const* edge_elements, int len) {
+  PrepareInserts(len);
+  parallel_for (0, len, [&] (size_t i) {
+    InsertUnchecked(edges[i].first, edges[i].second, edge_elements[i]);
+  });
+}
+
+template<typename Element>
+void EdgeMap<Element>::BatchDelete(const std::pair<int, int>* edges, int len) {
+  parallel_for (0, len, [&] (size_t i) {
+    DeleteUnchecked(edges[i].first, edges[i].second);
   });
+  FinishDeletes(len);
+}
+
+template<typename Element>
+void EdgeMap<Element>::RebuildIfFull(int num_inserts) {
+  const size_t num_edges{num_edges_ + num_inserts};
+  if (num_edges + num_deletes_ <= kMaxLoad * map_.capacity) {
+    return;
+  }
+  size_t capacity{map_.capacity};
+  while (capacity > 128 && num_edges < kRebuildLoad * capacity / 2) {
+    capacity /= 2;
+  }
+  while (num_edges > kRebuildLoad * capacity) {
+    capacity *= 2;
+  }
+  map_.rebuild(capacity);
+  num_deletes_ = 0;
+}
+
+template<typename Element>
+void EdgeMap<Element>::PrepareInserts(int num_inserts) {
+  RebuildIfFull(num_inserts);
+  num_edges_ += num_inserts;
+}
+
+template<typename Element>
+void EdgeMap<Element>::FinishDeletes(int num_deletes) {
+  num_edges_ -= num_deletes;
+  num_deletes_ += num_deletes;
+  RebuildIfFull(0);
+}
+
+template<typename Element>
+EdgeMapStats EdgeMap<Element>::Stats() const {
+  const size_t capacity{map_.capacity};
+  const auto probe_lengths{parlay::delayed_seq<size_t>(capacity,
+      [&] (size_t i) { return map_.is_live(i) ? map_.probe_length(i) : 0; })};
+  EdgeMapStats stats;
+  stats.num_edges = parlay::reduce(parlay::delayed_seq<size_t>(capacity,
+      [&] (size_t i) -> size_t { return map_.is_live(i); }));
+  stats.num_tombstones = parlay::reduce(parlay::delayed_seq<size_t>(capacity,
+      [&] (size_t i) -> size_t { return map_.is_tombstone(i); }));
+  stats.capacity = capacity;
+  stats.mean_probe_length = stats.num_edges == 0 ? 0.0 :
+      static_cast<double>(parlay::reduce(probe_lengths)) / stats.num_edges;
+  stats.max_probe_length =
+      parlay::reduce(probe_lengths, parlay::maximum<size_t>());
+  return stats;
+}
+
+template<typename Element>
+Element* EdgeMap<Element>::Find(int u, int v) const {
+  // Absent keys come back as invalid `maybe`s with indeterminate values.
+  if (u > v) {
+    auto vu{map_.find(make_pair(v, u))};
+    return vu ? (*vu)->GetTwin() : nullptr;
+  } else {
+    auto uv{map_.find(make_pair(u, v))};
+    return uv ? *uv : nullptr;
+  }
 }
 
 }  // namespace _internal
 
+// Edge store policy for `EulerTourTree` that keeps edges in a concurrent hash
+// table (see `_internal::EdgeMap`). This is the default.
+struct HashEdges {
+  template<typename Element>
+  using Store = _internal::EdgeMap<Element>;
+};
+
 }  // namespace parallel_euler_tour_tree
@@ -0,0 +1,127 @@
+#pragma once
+
+#include <algorithm>
+#include <cassert>
+#include <stdexcept>
+
+#include <utilities/include/utils.h>
+
+namespace parallel_euler_tour_tree {
+
+namespace _internal {
+
+// Used in Euler tour tree for recycling the sequence elements that represent
+// edges. An n-vertex forest has at most n - 1 edges and thus at most 2n - 2
+// edge elements alive at any time, so the tree builds all of them up front and
+// the pool keeps the ones not currently in a tour on a free stack. The pool
+// does not own the elements.
+//
+// Elements keep their skip list height and neighbor array across reuse, so
+// handing one out is O(1) and does no allocation. Elements must be completely
+// detached from any list before they are released back into the pool, which is
+// what cutting an edge already guarantees.
+//
+// `Acquire`/`Release` may not run concurrently with other pool operations. The
+// batch versions hand out or take back many elements in parallel.
+template <typename Element>
+class ElementPool {
+ public:
+  ElementPool() = delete;
+  // Starts with all `capacity` elements of the array `elements` unused.
+  ElementPool(Element* elements, int capacity);
+  ~ElementPool();
+  ElementPool(const ElementPool&) = delete;
+  ElementPool(ElementPool&&) = delete;
+  ElementPool& operator=(const ElementPool&) = delete;
+  ElementPool& operator=(ElementPool&&) = delete;
+
+  // Returns an unused element.
+  Element* Acquire();
+  // Returns `element` to the pool.
+  void Release(Element* element);
+
+  // Returns a pointer to `len` unused elements. The pointer is valid until the
+  // next call that returns elements to the pool.
+  Element** BatchAcquire(int len);
+  // Returns each of the `len` elements in `elements` along with its twin to
+  // the pool.
+  void BatchReleaseWithTwins(Element* const* elements, int len);
+
+  // Number of elements currently available.
+  int Size() const { return size_; }
+
+ private:
+  int capacity_;
+  // `free_[0]`, ..., `free_[size_ - 1]` are the elements not in use.
+  Element** free_;
+  int size_;
+};
+
+template <typename Element>
+ElementPool<Element>::ElementPool(Element* elements, int capacity)
+    : capacity_{capacity}, size_{capacity} {
+  free_ = pbbs::new_array_no_init<Element*>(capacity_);
+  parallel_for (0, capacity_, [&] (size_t i) {
+    free_[i] = &elements[i];
+  });
+}
+
+template <typename Element>
+ElementPool<Element>::~ElementPool() {
+  pbbs::delete_array(free_, capacity_);
+}
+
+template <typename Element>
+Element* ElementPool<Element>::Acquire() {
+  assert(size_ > 0);
+  return free_[--size_];
+}
+
+template <typename Element>
+void ElementPool<Element>::Release(Element* element) {
+  assert(size_ < capacity_);
+  element->ResetForReuse();
+  free_[size_++] = element;
+}
+
+template <typename Element>
+Element** ElementPool<Element>::BatchAcquire(int len) {
+  assert(size_ >= len);
+  size_ -= len;
+  return free_ + size_;
+}
+
+template <typename Element>
+void ElementPool<Element>::BatchReleaseWithTwins(
+    Element* const* elements, int len) {
+  assert(size_ + 2 * len <= capacity_);
+  Element** targets{free_ + size_};
+  parallel_for (0, len, [&] (size_t i) {
+    Element* uv{elements[i]};
+    Element* vu{uv->GetTwin()};
+    uv->ResetForReuse();
+    vu->ResetForReuse();
+    targets[2 * i] = uv;
+    targets[2 * i + 1] = vu;
+  });
+  size_ += 2 * len;
+}
+
+// Returns the number of elements in the array of an Euler tour tree on
+// `num_vertices` vertices: the n vertex elements and the 2n - 2 edge elements
+// that an n-vertex forest needs at most. Throws `std::length_error` if
+// `Links` cannot link every pair of elements in an array that long.
+template <typename Element, typename Links>
+int NumForestElements(int num_vertices) {
+  const int num_elements{num_vertices + 2 * std::max(num_vertices - 1, 0)};
+  if (static_cast<size_t>(num_elements) >
+      Links::template MaxArrayLength<Element>()) {
+    throw std::length_error{
+        "too many vertices for the skip list link policy of the forest"};
+  }
+  return num_elements;
+}
+
+}  // namespace _internal
+
+}  // namespace parallel_euler_tour_tree
@@ -1,49 +1,190 @@
 #pragma once
 
+#include <cstdint>
+#include <utility>
+
+#include <parlay/primitives.h>
+#include <parlay/sequence.h>
+
 #include <sequence/parallel_skip_list/include/augmented_skip_list.hpp>
 
+#include <utilities/include/random.h>
+
 namespace parallel_euler_tour_tree {
 
 namespace _internal {
 
-template<typename T>
-class Element : public parallel_skip_list::AugmentedElement<T> {
+template<typename T, typename Aggregate = parallel_skip_list::Augmentation<T>,
+         typename Links = parallel_skip_list::PointerLinks>
+class Element : public parallel_skip_list::AugmentedElement<T, Aggregate, Links> {
+  using Base = parallel_skip_list::AugmentedElement<T, Aggregate, Links>;
  public:
-  Element() : parallel_skip_list::AugmentedElement<T>{} {}
-  explicit Element(size_t random_int)
-    : parallel_skip_list::AugmentedElement<T>{random_int} {}
+  using typename Base::Neighbors;
+
+  Element() : Base{} {}
+  explicit Element(size_t random_int) : Base{random_int} {}
+  Element(size_t random_int, Neighbors* levels, const Aggregate* augmentation)
+    : Base{random_int, levels, augmentation} {}
+
+  // Restores a detached element to the state of a freshly constructed one so
+  // that it can represent a different edge.
+  void ResetForReuse() {
+    this->ClearNeighbors();
+    this->ResetValues();
+    SetTwin(nullptr);
+    split_mark_ = false;
+  }
+
+  // Sets the value of a detached element before it is linked into a tour.
+  void SetDetachedValue(T value) { this->Values()[0] = std::move(value); }
+
+  // If this element represents edge (u, v), its twin is (v, u).
+  Element* GetTwin() const { return Links::Get(this, twin_); }
+  void SetTwin(const Element* twin) { twin_ = Links::Make(this, twin); }
 
-  // If this element represents edge (u, v), `twin` should point towards (v, u).
-  Element* twin_{nullptr};
   // When batch splitting, we mark this as `true` for an edge that we will
   // splice out in the current round of recursion.
   bool split_mark_{false};
 
  private:
-  friend class parallel_skip_list::AugmentedElement<T>;
-  friend class parallel_skip_list::ElementBase<Element>;
+  friend Base;
+  friend class parallel_skip_list::ElementBase<Base, Links>;
   static void DerivedInitialize() {}
   static void DerivedFinish() {}
+
+  typename Links::template Link<Element> twin_{Links::Make(this, nullptr)};
 };
 
-class UnaugmentedElement : public parallel_skip_list::ElementBase<UnaugmentedElement> {
+template<typename Links = parallel_skip_list::PointerLinks>
+class UnaugmentedElement
+    : public parallel_skip_list::ElementBase<UnaugmentedElement<Links>, Links> {
+  using Base = parallel_skip_list::ElementBase<UnaugmentedElement, Links>;
  public:
-  UnaugmentedElement() : parallel_skip_list::ElementBase<UnaugmentedElement>{} {}
-  explicit UnaugmentedElement(size_t random_int)
-    : parallel_skip_list::ElementBase<UnaugmentedElement>{random_int} {}
+  using typename Base::Neighbors;
+
+  UnaugmentedElement() : Base{} {}
+  explicit UnaugmentedElement(size_t random_int) : Base{random_int} {}
+  UnaugmentedElement(size_t random_int, Neighbors* neighbors)
+    : Base{random_int, neighbors} {}
+
+  // Restores a detached element to the state of a freshly constructed one so
+  // that it can represent a different edge.
+  void ResetForReuse() {
+    this->ClearNeighbors();
+    SetTwin(nullptr);
+    split_mark_ = false;
+  }
+
+  // If this element represents edge (u, v), its twin is (v, u).
+  UnaugmentedElement* GetTwin() const { return Links::Get(this, twin_); }
+  void SetTwin(const UnaugmentedElement* twin) {
+    twin_ = Links::Make(this, twin);
+  }
 
-  // If this element represents edge (u, v), `twin` should point towards (v, u).
-  UnaugmentedElement* twin_{nullptr};
   // When batch splitting, we mark this as `true` for an edge that we will
   // splice out in the current round of recursion.
   bool split_mark_{false};
 
  private:
-  friend class parallel_skip_list::ElementBase<UnaugmentedElement>;
+  friend Base;
   static void DerivedInitialize() {}
   static void DerivedFinish() {}
+
+  typename Links::template Link<UnaugmentedElement> twin_{
+      Links::Make(this, nullptr)};
 };
 
+// An Euler tour tree keeps the per-level data of all of its elements in one
+// large array of `Element::Neighbors` that it owns. For `num_elements` elements
+// where element `i` is seeded with `randomness.ith_rand(i)`, this returns
+// offsets such that element `i`'s per-level data occupies indices
+// [`offsets[i]`, `offsets[i + 1]`) of that array.
+template<typename Element>
+parlay::sequence<size_t> LevelOffsets(int num_elements, pbbs::random randomness) {
+  parlay::sequence<size_t> offsets = parlay::tabulate(num_elements + 1, [&] (size_t i) {
+    return i < static_cast<size_t>(num_elements)
+      ? static_cast<size_t>(Element::LevelArrayLength(
+            Element::HeightFromSeed(randomness.ith_rand(i))))
+      : 0;
+  });
+  parlay::scan_inplace(offsets);
+  return offsets;
+}
+
+// The Euler tours of a forest laid out for `BatchBuildCycles`.
+template<typename SkipListElement, typename Element>
+struct EulerTours {
+  // The edge elements and the elements of vertices with at least one edge.
+  parlay::sequence<SkipListElement*> elements;
+  // `successors[i]` follows `elements[i]` in its tour.
+  parlay::sequence<SkipListElement*> successors;
+  // `edge_elements[i]` represents the `i`-th edge in its given direction.
+  parlay::sequence<Element*> edge_elements;
+};
+
+// Computes the Euler tours of the forest with vertex elements `vertices` and
+// the `len` edges in `edges`. The edges are represented by the `2 * len` unused
+// elements in `new_elements`, whose twins this sets.
+//
+// The tour around vertex x with neighbors y_1, y_2, ..., y_k goes (x, x),
+// (x, y_1), ..., (y_1, x), (x, y_2), ..., (y_k, x), and back to (x, x), which
+// matches the order `BatchLink` joins elements in.
+//
+// The elements are assigned to directed edges in order of the edges' heads.
+// When `new_elements` is ordered by address and neighboring vertices have
+// nearby ids, this keeps neighbors in a tour nearby in memory.
+template<typename SkipListElement, typename Element>
+EulerTours<SkipListElement, Element> ComputeEulerTours(Element* vertices,
+    const std::pair<int, int>* edges, Element* const* new_elements, int len) {
+  // `arcs` holds (x, j) for the `j`-th directed edge, which ends at vertex x.
+  // Directed edge `2 * i` is `edges[i]`, and `2 * i + 1` is its reverse.
+  // Semisort them by x.
+  parlay::sequence<std::pair<uint32_t, uint32_t>> arcs = parlay::tabulate(
+      2 * len, [&] (size_t j) {
+        return std::make_pair(static_cast<uint32_t>(
+            j % 2 == 0 ? edges[j / 2].second : edges[j / 2].first),
+            static_cast<uint32_t>(j));
+      });
+  parlay::integer_sort_inplace(arcs,
+      [] (const std::pair<uint32_t, uint32_t>& arc) { return arc.first; });
+
+  // Directed edge `arcs[p].second` gets element `new_elements[p]`.
+  parlay::sequence<Element*> arc_elements(2 * len);
+  parallel_for (0, 2 * len, [&] (size_t p) {
+    arc_elements[arcs[p].second] = new_elements[p];
+  });
+  EulerTours<SkipListElement, Element> tours;
+  tours.edge_elements = parlay::tabulate(len, [&] (size_t i) {
+    Element* uv{arc_elements[2 * i]};
+    Element* vu{arc_elements[2 * i + 1]};
+    uv->SetTwin(vu);
+    vu->SetTwin(uv);
+    return uv;
+  });
+
+  const auto is_group_start{[&] (size_t p) {
+    return p == 0 || arcs[p].first != arcs[p - 1].first;
+  }};
+  const parlay::sequence<int> group_starts{parlay::pack_index<int>(
+      parlay::delayed_seq<bool>(2 * len, is_group_start))};
+  const size_t num_elements{2 * len + group_starts.size()};
+  tours.elements = parlay::sequence<SkipListElement*>(num_elements);
+  tours.successors = parlay::sequence<SkipListElement*>(num_elements);
+  parallel_for (0, 2 * len, [&] (size_t p) {
+    tours.elements[p] = new_elements[p];
+    tours.successors[p] =
+      p + 1 < static_cast<size_t>(2 * len) && !is_group_start(p + 1)
+        ? arc_elements[arcs[p + 1].second ^ 1]
+        : &vertices[arcs[p].first];
+  });
+  parallel_for (0, group_starts.size(), [&] (size_t i) {
+    const std::pair<uint32_t, uint32_t>& arc{arcs[group_starts[i]]};
+    tours.elements[2 * len + i] = &vertices[arc.first];
+    tours.successors[2 * len + i] = arc_elements[arc.second ^ 1];
+  });
+  return tours;
+}
+
 }  // namespace _internal
 
 }  // namespace parallel_euler_tour_tree
@@ -1,9 +1,18 @@
 #pragma once
 
+#include <algorithm>
+#include <cassert>
+#include <cstdint>
+#include <functional>
+#include <memory>
 #include <utility>
 
+#include <dynamic_trees/parallel_euler_tour_tree/include/adjacency_edge_map.hpp>
+#include <dynamic_trees/parallel_euler_tour_tree/include/component_id_cache.hpp>
 #include <dynamic_trees/parallel_euler_tour_tree/include/edge_map.hpp>
+#include <dynamic_trees/parallel_euler_tour_tree/include/element_pool.hpp>
 #include <dynamic_trees/parallel_euler_tour_tree/include/euler_tour_sequence.hpp>
+#include <dynamic_trees/parallel_euler_tour_tree/include/spanning_forest.hpp>
 #include <sequence/parallel_skip_list/include/skip_list_base.hpp>
 
 #include <utilities/include/random.h>
@@ -13,22 +22,101 @@
 
 namespace parallel_euler_tour_tree {
 
+// A link (`is_link`) or cut of edge {`u`, `v`} in an update log given to
+// `EulerTourTree::ApplyBatch`.
+struct EdgeUpdate {
+  int u;
+  int v;
+  bool is_link;
+};
+
+// The net effect of an update log: the edges that `EulerTourTree::ApplyBatch`
+// cut and linked.
+struct AppliedUpdates {
+  parlay::sequence<std::pair<int, int>> cuts;
+  parlay::sequence<std::pair<int, int>> links;
+};
+
+// Which vertices were connected when `EulerTourTree::PublishSnapshot` made this
+// snapshot. Snapshots never change, so any number of threads may query one
+// while the forest goes on changing.
+//
+// The tree identifiers of the vertices are stored in fixed-size chunks that
+// consecutive snapshots share unless a vertex in the chunk changed trees.
+class ConnectivitySnapshot {
+ public:
+  static constexpr int kChunkSize{1024};
+  using Chunk = parlay::sequence<size_t>;
+
+  ConnectivitySnapshot(
+      uint64_t version, parlay::sequence<std::shared_ptr<const Chunk>> chunks)
+    : version_{version}, chunks_{std::move(chunks)} {}
+
+  // Snapshots are numbered from 1 in the order they are published.
+  uint64_t Version() const { return version_; }
+  // Returns true if `u` and `v` were in the same tree.
+  bool IsConnected(int u, int v) const {
+    return Representative(u) == Representative(v);
+  }
+  // Returns an identifier of the tree that contained `v`. Identifiers are only
+  // comparable within one snapshot.
+  size_t Representative(int v) const {
+    return (*chunks_[v / kChunkSize])[v % kChunkSize];
+  }
+  const parlay::sequence<std::shared_ptr<const Chunk>>& Chunks() const {
+    return chunks_;
+  }
+
+ private:
+  uint64_t version_;
+  parlay::sequence<std::shared_ptr<const Chunk>> chunks_;
+};
+
 // Euler tour trees represent forests. We may add an edge using `Link`, remove
 // an edge using `Cut`, and query whether two vertices are in the same tree
 // using `IsConnected`. This implementation can also exploit parallelism when
 // many edges are added at once through `BatchLink` or many edges are deleted at
 // once through `BatchCut`.
-template<typename T = int>
+//
+// Each tree owns all of its memory and its augmentation, so any number of
+// trees may be constructed, used, and destroyed independently and in parallel.
+//
+// Vertex values are aggregated with `Aggregate` (see
+// `parallel_skip_list::Augmentation`). The default chooses the aggregate
+// function at run time; a compile-time aggregate such as
+// `parallel_skip_list::SumAggregate<T>` avoids an indirect call per combine.
+//
+// `Links` is the skip list link policy. `parallel_skip_list::CompactLinks` uses
+// less memory per element than the default, but limits the forest to
+// `CompactLinks::MaxArrayLength<Element>() / 3` vertices, roughly 2^31 divided
+// by the size of an element in units of its alignment. Constructing a larger
+// forest throws `std::length_error`.
+//
+// `EdgeStore` is the policy for looking up the sequence element of an edge.
+// `AdjacencyEdges` keeps per-vertex edge lists instead of the default hash
+// table.
+template<typename T = int,
+         typename Aggregate = parallel_skip_list::Augmentation<T>,
+         typename Links = parallel_skip_list::PointerLinks,
+         typename EdgeStore = HashEdges>
 class EulerTourTree {
-using Element = _internal::Element<T>;
-using AugmentedElement = parallel_skip_list::AugmentedElement<T>;
+using Element = _internal::Element<T, Aggregate, Links>;
+using AugmentedElement =
+    parallel_skip_list::AugmentedElement<T, Aggregate, Links>;
  public:
-  static parlay::type_allocator<_internal::Element<T>> allocator;
+  // Update to vertex values for aggregates with tags (see
+  // `parallel_skip_list::AugmentedElement`).
+  using Tag = typename AugmentedElement::Tag;
 
   EulerTourTree() = delete;
-  // Initializes n-vertex forest with no edges.
+  // Initializes n-vertex forest with no edges. The forest uses a copy of
+  // `AugmentedElement<T, Aggregate, Links>::default_augmentation` as it is at
+  // construction time.
   explicit EulerTourTree(int num_vertices);
   explicit EulerTourTree(int num_vertices, size_t seed);
+  // Initializes n-vertex forest with no edges that aggregates vertex values
+  // with `augmentation`.
+  EulerTourTree(int num_vertices, size_t seed, Aggregate augmentation);
   ~EulerTourTree();
   EulerTourTree(const EulerTourTree&) = delete;
   EulerTourTree(EulerTourTree&&) = delete;
@@ -37,9 +125,180 @@ using AugmentedElement = parallel_skip_list::AugmentedElement<T>;
 
   // Returns true if `u` and `v` are in the same tree in the represented forest.
   bool IsConnected(int u, int v) const;
+
+  // Returns, for each vertex in `vertices`, an identifier of the tree
+  // containing it. Two vertices are in the same tree if and only if their
+  // identifiers are equal. Identifiers are only valid until the forest next
+  // changes.
+  parlay::sequence<size_t> BatchFindRepresentative(
+      const parlay::sequence<int>& vertices) const;
+  // Returns `IsConnected(u, v)` for each pair {`u`, `v`} in `queries`. This is
+  // faster than answering the queries one at a time, especially when queries
+  // share vertices or trees.
+  parlay::sequence<bool> BatchIsConnected(
+      const parlay::sequence<std::pair<int, int>>& queries) const;
+  // Computes and caches the tree identifier of each vertex, after which the
+  // queries above read identifiers from the cache instead of walking up the
+  // skip lists. Updates to the forest only discard the cached identifiers of
+  // the trees they touch, and calling this again recomputes just those. The
+  // cache is off until this is first called.
+  void CacheComponentIds();
+  // The queries above must not run during updates, which rewrite the skip
+  // lists in place. To answer connectivity queries during updates, the thread
+  // making updates calls `PublishSnapshot` after each batch, and readers query
+  // the latest snapshot from `GetSnapshot`, which reflects the forest as it was
+  // between batches.
+  //
+  // Publishing searches the tours of the trees changed since the last snapshot
+  // in parallel and copies the chunks of the snapshot that hold their vertices
+  // (see `ConnectivitySnapshot`), so its work grows with the size of those
+  // trees rather than of the forest, and its depth only polylogarithmically.
+  // Readers holding older snapshots keep them alive, and the last holder frees
+  // each one.
+  void PublishSnapshot();
+  // Returns the most recently published snapshot, or null if there is none.
+  // Never blocks, and may run concurrently with anything, including updates
+  // and `PublishSnapshot`.
+  std::shared_ptr<const ConnectivitySnapshot> GetSnapshot() const;
+
+  // Defers aggregate maintenance, for phases that change the forest many times
+  // between aggregate queries. While deferred, links and cuts only record where
+  // they changed the skip lists, and the stale aggregates are recomputed in one
+  // parallel pass by `Flush()`. The queries below that read aggregates must
+  // not run between a deferred link or cut and the next `Flush()`, so that
+  // they never write to the tree and may run concurrently as usual.
+  // `DeferAggregates(false)` flushes and resumes recomputing aggregates on
+  // every link and cut.
+  void DeferAggregates(bool defer = true);
+  // Recomputes the aggregates left stale by deferred links and cuts.
+  void Flush();
+
+  // Returns the aggregate of the values in `v`'s tree, which include the values
+  // of its edges (see `LinkWithValue`). Edges added without a value hold the
+  // identity, so for a true identity they leave the aggregate as it is.
+  T ComponentAggregate(int v) const;
+  // Returns `ComponentAggregate(v)` for each vertex in `vertices`. The
+  // aggregate of each distinct tree is computed once and shared by all the
+  // vertices in it.
+  parlay::sequence<T> BatchComponentAggregate(
+      const parlay::sequence<int>& vertices) const;
+  // Aggregates combine values in tour order, so the aggregate function need not
+  // be commutative. `ComponentAggregate` starts the tour at an arbitrary point
+  // that only changes when the tree does, while this returns the aggregate of
+  // `v`'s tour starting from `v`.
+  T TourAggregateFrom(int v) const;
+  // Returns `TourAggregateFrom(v)` for each vertex in `vertices` in parallel.
+  parlay::sequence<T> BatchTourAggregateFrom(
+      const parlay::sequence<int>& vertices) const;
+  // Returns the aggregate of the values in the subtree rooted at `v` when its
+  // tree is rooted so that `parent` is the parent of `v`. Edge {`v`, `parent`}
+  // must be present. The aggregate includes the values of the edges in the
+  // subtree and of edge {`v`, `parent`} itself. The values are combined in tour
+  // order from (`parent`, `v`) to (`v`, `parent`).
+  //
+  // The tours are cyclic, so a subtree is determined by `v` and `parent` alone
+  // and no rerooting is needed to query a tree under a different root.
+  T SubtreeAggregate(int v, int parent) const;
+  // Returns `SubtreeAggregate(v, parent)` for each pair (`v`, `parent`) in
+  // `queries` in parallel. The walks up the skip lists are shared, so queries
+  // whose subtrees are near each other in the tour cost little more than one.
+  parlay::sequence<T> BatchSubtreeAggregate(
+      const parlay::sequence<std::pair<int, int>>& queries) const;
+
+  // Order statistics over the vertices of a tour, in tour order starting from
+  // an arbitrary but fixed point that only changes when the tree does. These
+  // count `size(value)` vertices for each vertex value (see
+  // `parallel_skip_list::AugmentedElement::Rank`), so the aggregate must add
+  // sizes. Edge values count toward sizes too, so each edge value, including
+  // the identity that edges added without a value hold, must have size 0. For
+  // example, use `parallel_skip_list::SumAggregate<int>` and give every vertex
+  // value 1.
+  //
+  // Returns the number of vertices before `v` in its tour.
+  template<typename Size = parallel_skip_list::ValueSize>
+  size_t RankInTour(int v, const Size& size = Size{}) const;
+  // Returns the `k`-th vertex (from 0) of the tour containing `v`, or -1 if the
+  // tour has at most `k` vertices.
+  template<typename Size = parallel_skip_list::ValueSize>
+  int KthVertexInTour(int v, size_t k, const Size& size = Size{}) const;
+  // Returns `KthVertexInTour(v, k)` for each pair (`v`, `k`) in `queries` in
+  // parallel.
+  template<typename Size = parallel_skip_list::ValueSize>
+  parlay::sequence<int> BatchKthVertexInTour(
+      const parlay::sequence<std::pair<int, size_t>>& queries,
+      const Size& size = Size{}) const;
+  // Returns a vertex of `v`'s tree chosen by `random_int`, such that a uniformly
+  // random `random_int` gives a uniformly random vertex. `v`'s tree must have
+  // positive size.
+  template<typename Size = parallel_skip_list::ValueSize>
+  int SampleVertexInComponent(
+      int v, size_t random_int, const Size& size = Size{}) const;
+
+  // Searches for vertices whose values satisfy `predicate` (see
+  // `parallel_skip_list::AugmentedElement::FindFirst`) in the same tour order
+  // as above. Edge values, including the identity that edges added without a
+  // value hold, must fail `predicate`.
+  // For example, with `parallel_skip_list::OrAggregate<int>`, flags set with
+  // `Update` and the predicate `x != 0`, these find flagged vertices in
+  // O(log n) expected time each.
+  //
+  // Returns the first vertex of `v`'s tree that satisfies `predicate`, or -1 if
+  // there is none.
+  template<typename Predicate>
+  int FindFirstVertex(int v, const Predicate& predicate) const;
+  // Returns all vertices of `v`'s tree that satisfy `predicate`.
+  template<typename Predicate>
+  parlay::sequence<int> FindAllVertices(
+      int v, const Predicate& predicate) const;
+  // Returns `FindFirstVertex(v, predicate)` for each `v` in `vertices` in
+  // parallel.
+  template<typename Predicate>
+  parlay::sequence<int> BatchFindFirstVertex(
+      const parlay::sequence<int>& vertices, const Predicate& predicate) const;
+
+  // Updates to all the vertices of a tree or subtree at once, for aggregates
+  // with tags such as `parallel_skip_list::AddSumAggregate<T>`. Each takes
+  // O(log n) expected time however many vertices it updates. Tags reach the
+  // edge values in the range as well, so `Apply` must leave the identity as it
+  // is, and edges may only be given other values if the aggregate's values can
+  // opt out of tags (see `parallel_skip_list::SplitAddMaxAggregate<T>`). Edge
+  // values must then opt out.
+  //
+  // Applies `delta` to the value of each vertex in `v`'s tree.
+  void AddToComponent(int v, const Tag& delta);
+  // Applies `delta` to the value of each vertex in the subtree rooted at `v`
+  // when its tree is rooted so that `parent` is the parent of `v`. Edge {`v`,
+  // `parent`} must be present.
+  void AddToSubtree(int v, int parent, const Tag& delta);
+  // `AddToComponent(vertices[i], deltas[i])` for each `i`, in parallel.
+  void BatchAddToComponent(const parlay::sequence<int>& vertices,
+      const parlay::sequence<Tag>& deltas);
+  // `AddToSubtree(subtrees[i].first, subtrees[i].second, deltas[i])` for each
+  // `i`, in parallel.
+  void BatchAddToSubtree(const parlay::sequence<std::pair<int, int>>& subtrees,
+      const parlay::sequence<Tag>& deltas);
+
+  // Returns statistics on the store that maps edges to tour elements.
+  EdgeMapStats GetEdgeMapStats() const { return edges_.Stats(); }
   // Adds edge {`u`, `v`} to forest. The addition of this edge must not create a
   // cycle in the graph.
   void Link(int u, int v);
+  // Edges also have values, which are aggregated along with the vertex values.
+  // An edge added without a value holds the identity. Of the two tour elements
+  // of an edge, one holds its value and the other the identity, so each edge
+  // counts once in every aggregate.
+  //
+  // For aggregates with tags, edge values must opt out of them (see
+  // `AddToComponent`).
+  //
+  // `Link(u, v)` and sets the value of edge {`u`, `v`} to `value`.
+  void LinkWithValue(int u, int v, T value);
+  // Sets the value of edge {`u`, `v`}, which must be present, to `value`.
+  void UpdateEdge(int u, int v, T value);
+  // Sets the value of each edge `edges[i]` to `values[i]`, recomputing the
+  // aggregates in one pass. The edges must be present and distinct.
+  void BatchUpdateEdge(const parlay::sequence<std::pair<int, int>>& edges,
+      const parlay::sequence<T>& values);
   // Removes edge {`u`, `v`} from forest. The edge must be present in the
   // forest.
   void Cut(int u, int v);
@@ -49,12 +308,51 @@ using AugmentedElement = parallel_skip_list::AugmentedElement<T>;
   // Adds all edges in the `len`-length array `links` to the forest. Adding
   // these edges must not create cycles in the graph.
   void BatchLink(const std::pair<int, int>* links, int len);
+  // `BatchLink(links, len)` that also sets the value of each edge `links[i]` to
+  // `values[i]`.
+  void BatchLink(const std::pair<int, int>* links, const T* values, int len);
+  // Adds each edge of `edges` that does not close a cycle, through edges
+  // already in the forest or other edges of `edges`, and returns whether each
+  // edge was added. The added edges connect the same vertices as all of
+  // `edges` would. They are chosen in parallel, so which edge of a cycle is
+  // left out may vary from run to run.
+  parlay::sequence<bool> BatchLinkIfAcyclic(
+      const parlay::sequence<std::pair<int, int>>& edges);
   // Removes all edges in the `len`-length array `cuts` from the forest. These
   // edges must be present in the forest and must be distinct.
   void BatchCut(const std::pair<int, int>* cuts, int len);
+  // Removes the edges in `cuts` like `BatchCut`, except that cuts of edges not
+  // in the forest are skipped, as are all but one of the cuts of each edge.
+  // Returns whether each cut was performed. The checks happen in the pass that
+  // already looks up the cut edges, so this costs little more than `BatchCut`.
+  parlay::sequence<bool> BatchCutIfPresent(
+      const parlay::sequence<std::pair<int, int>>& cuts);
+  // Adds all edges in the `len`-length array `edges` to the forest, which must
+  // have no edges. Adding these edges must not create cycles in the graph.
+  //
+  // This constructs the Euler tours directly instead of joining them together
+  // piece by piece, so it builds a forest from scratch several times faster
+  // than `BatchLink`.
+  void BuildFromForest(const std::pair<int, int>* edges, int len);
+  // Applies a log of interleaved links and cuts as if in order, with the last
+  // update to each edge deciding whether the edge is present afterwards.
+  // Linking an edge that is already present or cutting one that is absent does
+  // nothing, so updates to an edge that cancel out, such as a cut followed by a
+  // link, leave it alone. The remaining cuts run as one batch followed by the
+  // remaining links. Returns those cuts and links, with each edge given as in
+  // its last update.
+  //
+  // The log applied in order must keep the graph a forest.
+  AppliedUpdates ApplyBatch(const parlay::sequence<EdgeUpdate>& updates);
   // Updates all the vertices in the `len`-length array `vertices` with the
   // new corresponding value in the `new_values` array.
-  void BatchUpdate(int* vertices, T* new_values, int len);
+  void BatchUpdate(const int* vertices, const T* new_values, int len);
+  // Sets the value of each vertex `vertices[i]` to `new_values[i]` and then
+  // recomputes the aggregates in one pass, which is much faster than calling
+  // `Update` on each vertex. If a vertex appears more than once, its last value
+  // wins.
+  void BatchUpdate(const parlay::sequence<int>& vertices,
+      const parlay::sequence<T>& new_values);
 
   // More modern interface helpers
   void batch_link(parlay::sequence<std::pair<int, int>>& links) {
@@ -66,126 +364,586 @@ using AugmentedElement = parallel_skip_list::AugmentedElement<T>;
   void BatchLink(const parlay::sequence<std::pair<int, int>>& links) {
     BatchLink(links.begin(), links.size());
   }
+  void BatchLink(const parlay::sequence<std::pair<int, int>>& links,
+      const parlay::sequence<T>& values) {
+    BatchLink(links.begin(), values.begin(), links.size());
+  }
   void BatchCut(const parlay::sequence<std::pair<int, int>>& cuts) {
     BatchCut(cuts.begin(), cuts.size());
   }
+  void BuildFromForest(const parlay::sequence<std::pair<int, int>>& edges) {
+    BuildFromForest(edges.begin(), edges.size());
+  }
 
  private:
+  // `BatchFindRepresentative` without the component identifier cache.
+  parlay::sequence<size_t> FindRepresentativeIds(
+      const parlay::sequence<int>& vertices) const;
+  // Returns the vertex that `element` represents, or -1 if it is null.
+  int VertexOf(const AugmentedElement* element) const;
+  // Marks the trees containing the endpoints of the `len` edges in `edges` as
+  // changed for the component identifier cache and for the next snapshot. Must
+  // be called before the edges are added to or removed from the forest.
+  void InvalidateComponents(const std::pair<int, int>* edges, int len);
+  // `LinkWithValue` and `BatchLink` without the check that edges may hold
+  // values. `values` may be null, in which case the edges hold the identity.
+  void LinkEdge(int u, int v, T value);
+  void BatchLinkEdges(const std::pair<int, int>* links, const T* values,
+      int len);
   void BatchCutRecurse(const std::pair<int, int>* cuts, int len, parlay::sequence<bool>& ignored,
-    parlay::sequence<Element*>& join_targets, parlay::sequence<Element*>& edge_elements);
+    parlay::sequence<Element*>& join_targets, parlay::sequence<Element*>& edge_elements,
+    parlay::sequence<bool>* performed = nullptr);
+  // Recomputes the aggregates of the ancestors of `elements` (see
+  // `parallel_skip_list::AugmentedElement::BatchRecomputeAggregate`), or
+  // records the elements for `FlushAggregates` if aggregates are deferred.
+  // `elements` may contain nulls.
+  void RecomputeAggregates(parlay::sequence<AugmentedElement*>& elements);
+  // Records `element` for `FlushAggregates`.
+  void DeferRecompute(AugmentedElement* element);
+  void FlushAggregates();
+
+  // Edges may hold values other than the identity unless tags would change
+  // them.
+  static constexpr bool kEdgeValuesAllowed{!AugmentedElement::kIsLazy ||
+    parallel_skip_list::_internal::ValuesCanOptOut<Aggregate>::value};
 
   int num_vertices_;
+  // Number of vertex and edge elements owned by the tree.
+  int num_elements_;
   pbbs::random randomness_;
-
-  std::vector<Element*> node_pool;
+  Aggregate augmentation_;
+  // Per-level data (neighbors and values) of all elements.
+  parlay::sequence<typename Element::Neighbors> level_arena_;
+  // All elements. The first `num_vertices_` are the vertex elements.
+  Element* elements_;
+  // Edge elements not currently in any tour.
+  _internal::ElementPool<Element> element_pool_;
+  _internal::ComponentIdCache component_ids_;
+  // Read and written only through `std::atomic_load` and `std::atomic_store`.
+  std::shared_ptr<const ConnectivitySnapshot> snapshot_;
+  uint64_t num_snapshots_{0};
+  // Endpoints of the edges added or removed since the last snapshot, once
+  // there is one. These may repeat.
+  parlay::sequence<int> snapshot_endpoints_;
+  bool defer_aggregates_{false};
+  // Elements whose ancestors' aggregates are stale because aggregates are
+  // deferred. These may repeat and may have since returned to the pool.
+  parlay::sequence<AugmentedElement*> stale_elements_;
  public:
-  _internal::Element<T>* vertices_;
-  _internal::EdgeMap<Element> edges_;
+  Element* vertices_;
+  typename EdgeStore::template Store<Element> edges_;
 };
 
-template<typename T>
-parlay::type_allocator<_internal::Element<T>> EulerTourTree<T>::allocator;
-
-
-
 namespace {
 
   // On BatchCut, randomly ignore 1/`kBatchCutRecursiveFactor` cuts and recurse
   // on them later.
   constexpr int kBatchCutRecursiveFactor{100};
 
-  template<typename T>
-  void BatchCutSequential(EulerTourTree<T>* ett, const pair<int, int>* cuts, int len) {
+  template<typename T, typename Aggregate, typename Links, typename EdgeStore>
+  void BatchCutSequential(EulerTourTree<T, Aggregate, Links, EdgeStore>* ett, const pair<int, int>* cuts, int len) {
     for (int i = 0; i < len; i++) {
       ett->Cut(cuts[i].first, cuts[i].second);
     }
   }
 
-  template<typename T>
-  void BatchLinkSequential(EulerTourTree<T>* ett, const pair<int, int>* links, int len) {
-    for (int i = 0; i < len; i++) {
-      ett->Link(links[i].first, links[i].second);
-    }
-  }
-
 }  // namespace
 
-template<typename T>
-EulerTourTree<T>::EulerTourTree(int num_vertices)
-    : num_vertices_{num_vertices} , edges_{num_vertices_} , randomness_{} {
-  Element::Initialize();
-  vertices_ = pbbs::new_array_no_init<Element>(num_vertices_);
+template<typename T, typename Aggregate, typename Links, typename EdgeStore>
+EulerTourTree<T, Aggregate, Links, EdgeStore>::EulerTourTree(int num_vertices)
+    : EulerTourTree{num_vertices, 0} {}
+
+template<typename T, typename Aggregate, typename Links, typename EdgeStore>
+EulerTourTree<T, Aggregate, Links, EdgeStore>::EulerTourTree(int num_vertices, size_t seed)
+    : EulerTourTree{num_vertices, seed, AugmentedElement::default_augmentation} {}
+
+// A forest on n vertices has at most n - 1 edges, so besides the n vertex
+// elements, the tree needs only 2n - 2 edge elements, which go in the pool.
+template<typename T, typename Aggregate, typename Links, typename EdgeStore>
+EulerTourTree<T, Aggregate, Links, EdgeStore>::EulerTourTree(int num_vertices, size_t seed,
+    Aggregate augmentation)
+    : num_vertices_{num_vertices}
+    , num_elements_{_internal::NumForestElements<Element, Links>(num_vertices)}
+    , randomness_{seed}
+    , augmentation_{std::move(augmentation)}
+    , elements_{pbbs::new_array_no_init<Element>(num_elements_)}
+    , element_pool_{elements_ + num_vertices_, num_elements_ - num_vertices_}
+    , vertices_{elements_}
+    , edges_{num_vertices_} {
+  parlay::sequence<size_t> offsets{
+      _internal::LevelOffsets<Element>(num_elements_, randomness_)};
+  level_arena_ =
+      parlay::sequence<typename Element::Neighbors>(offsets[num_elements_]);
+  parallel_for (0, num_elements_, [&] (size_t i) {
+    new (&elements_[i]) Element{
+        randomness_.ith_rand(i), &level_arena_[offsets[i]], &augmentation_};
+  });
   parallel_for (0, num_vertices_, [&] (size_t i) {
-    new (&vertices_[i]) Element{randomness_.ith_rand(i)};
     // The Euler tour on a vertex v (a singleton tree) is simply (v, v).
     Element::Join(&vertices_[i], &vertices_[i]);
   });
   randomness_ = randomness_.next();
-  for (int i = 0; i < 3*num_vertices-2; i++)
-    node_pool.push_back(allocator.create(randomness_.ith_rand(i)));
 }
 
-template<typename T>
-EulerTourTree<T>::EulerTourTree(int num_vertices, size_t seed)
-    : num_vertices_{num_vertices} , edges_{num_vertices_} , randomness_{seed} {
-  Element::Initialize();
-  vertices_ = pbbs::new_array_no_init<Element>(num_vertices_);
-  parallel_for (0, num_vertices_, [&] (size_t i) {
-    new (&vertices_[i]) Element{randomness_.ith_rand(i)};
-    // The Euler tour on a vertex v (a singleton tree) is simply (v, v).
-    Element::Join(&vertices_[i], &vertices_[i]);
+template<typename T, typename Aggregate, typename Links, typename EdgeStore>
+EulerTourTree<T, Aggregate, Links, EdgeStore>::~EulerTourTree() {
+  pbbs::delete_array(elements_, num_elements_);
+}
+
+template<typename T, typename Aggregate, typename Links, typename EdgeStore>
+bool EulerTourTree<T, Aggregate, Links, EdgeStore>::IsConnected(int u, int v) const {
+  size_t u_id, v_id;
+  if (component_ids_.Lookup(u, &u_id) && component_ids_.Lookup(v, &v_id)) {
+    return u_id == v_id;
+  }
+  return vertices_[u].FindRepresentative() == vertices_[v].FindRepresentative();
+}
+
+template<typename T, typename Aggregate, typename Links, typename EdgeStore>
+parlay::sequence<size_t> EulerTourTree<T, Aggregate, Links, EdgeStore>::BatchFindRepresentative(
+    const parlay::sequence<int>& vertices) const {
+  return component_ids_.Find(vertices,
+      [&] (const parlay::sequence<int>& misses) {
+        return FindRepresentativeIds(misses);
+      });
+}
+
+template<typename T, typename Aggregate, typename Links, typename EdgeStore>
+parlay::sequence<size_t> EulerTourTree<T, Aggregate, Links, EdgeStore>::FindRepresentativeIds(
+    const parlay::sequence<int>& vertices) const {
+  const parlay::sequence<AugmentedElement*> elements = parlay::tabulate(
+      vertices.size(), [&] (size_t i) -> AugmentedElement* {
+        return &vertices_[vertices[i]];
+      });
+  const parlay::sequence<AugmentedElement*> representatives{
+      AugmentedElement::BatchFindRepresentative(elements,
+          [&] (const AugmentedElement* element) {
+            return static_cast<size_t>(
+                static_cast<const Element*>(element) - elements_);
+          })};
+  return parlay::tabulate(vertices.size(), [&] (size_t i) {
+    return static_cast<size_t>(
+        static_cast<const Element*>(representatives[i]) - elements_);
   });
-  randomness_ = randomness_.next();
-  for (int i = 0; i < 3*num_vertices-2; i++)
-    node_pool.push_back(allocator.create(randomness_.ith_rand(i)));
 }
 
-template<typename T>
-EulerTourTree<T>::~EulerTourTree() {
-  pbbs::delete_array(vertices_, num_vertices_);
-  for (auto node : node_pool)
-    allocator.destroy(node);
-  edges_.FreeElements(&allocator);
-  Element::Finish();
+template<typename T, typename Aggregate, typename Links, typename EdgeStore>
+parlay::sequence<bool> EulerTourTree<T, Aggregate, Links, EdgeStore>::BatchIsConnected(
+    const parlay::sequence<std::pair<int, int>>& queries) const {
+  const size_t len{queries.size()};
+  const parlay::sequence<size_t> representatives{
+      BatchFindRepresentative(parlay::tabulate(2 * len, [&] (size_t i) {
+        return i < len ? queries[i].first : queries[i - len].second;
+      }))};
+  return parlay::tabulate(len, [&] (size_t i) {
+    return representatives[i] == representatives[i + len];
+  });
 }
 
-template<typename T>
-bool EulerTourTree<T>::IsConnected(int u, int v) const {
-  return vertices_[u].FindRepresentative() == vertices_[v].FindRepresentative();
+template<typename T, typename Aggregate, typename Links, typename EdgeStore>
+T EulerTourTree<T, Aggregate, Links, EdgeStore>::ComponentAggregate(int v) const {
+  assert(stale_elements_.empty());
+  return vertices_[v].GetSum();
 }
 
-template<typename T>
-void EulerTourTree<T>::Link(int u, int v) {
-  Element* uv{allocator.alloc()};
-  new (uv) Element{randomness_.ith_rand(0)};
-  Element* vu = allocator.alloc();
-  new (vu) Element{randomness_.ith_rand(1)};
-  randomness_ = randomness_.next();
-  uv->twin_ = vu;
-  vu->twin_ = uv;
+template<typename T, typename Aggregate, typename Links, typename EdgeStore>
+parlay::sequence<T> EulerTourTree<T, Aggregate, Links, EdgeStore>::BatchComponentAggregate(
+    const parlay::sequence<int>& vertices) const {
+  assert(stale_elements_.empty());
+  const parlay::sequence<size_t> representatives{
+      BatchFindRepresentative(vertices)};
+  const auto deduplicated{parallel_skip_list::_internal::Deduplicate(
+      parlay::map(representatives, [&] (size_t id) -> AugmentedElement* {
+        return &elements_[id];
+      }),
+      [&] (const AugmentedElement* element) {
+        return static_cast<size_t>(
+            static_cast<const Element*>(element) - elements_);
+      })};
+  // Each representative is on the top level of its list, so `GetSum` only
+  // walks that level.
+  const parlay::sequence<T> sums{parlay::map(deduplicated.first,
+      [&] (const AugmentedElement* element) { return element->GetSum(); })};
+  return parlay::tabulate(vertices.size(), [&] (size_t i) {
+    return sums[deduplicated.second[i]];
+  });
+}
+
+template<typename T, typename Aggregate, typename Links, typename EdgeStore>
+T EulerTourTree<T, Aggregate, Links, EdgeStore>::TourAggregateFrom(int v) const {
+  assert(stale_elements_.empty());
+  return vertices_[v].GetSumFromHere();
+}
+
+template<typename T, typename Aggregate, typename Links, typename EdgeStore>
+parlay::sequence<T> EulerTourTree<T, Aggregate, Links, EdgeStore>::BatchTourAggregateFrom(
+    const parlay::sequence<int>& vertices) const {
+  assert(stale_elements_.empty());
+  return AugmentedElement::BatchGetSumFromHere(parlay::map(vertices,
+      [&] (int v) -> AugmentedElement* { return &vertices_[v]; }));
+}
+
+// The tour goes from `parent` into the subtree along (`parent`, `v`) and comes
+// back along (`v`, `parent`), so the subtree is the part of the tour between
+// those two elements.
+template<typename T, typename Aggregate, typename Links, typename EdgeStore>
+T EulerTourTree<T, Aggregate, Links, EdgeStore>::SubtreeAggregate(
+    int v, int parent) const {
+  assert(stale_elements_.empty());
+  const Element* down{edges_.Find(parent, v)};
+  return AugmentedElement::GetSubsequenceSum(down, down->GetTwin());
+}
+
+template<typename T, typename Aggregate, typename Links, typename EdgeStore>
+parlay::sequence<T> EulerTourTree<T, Aggregate, Links, EdgeStore>::BatchSubtreeAggregate(
+    const parlay::sequence<std::pair<int, int>>& queries) const {
+  assert(stale_elements_.empty());
+  return AugmentedElement::BatchGetSubsequenceSum(
+      parlay::map(queries, [&] (const std::pair<int, int>& query) {
+        Element* down{edges_.Find(query.second, query.first)};
+        return std::make_pair(static_cast<AugmentedElement*>(down),
+            static_cast<AugmentedElement*>(down->GetTwin()));
+      }),
+      [&] (const AugmentedElement* element) {
+        return static_cast<size_t>(
+            static_cast<const Element*>(element) - elements_);
+      });
+}
+
+template<typename T, typename Aggregate, typename Links, typename EdgeStore>
+template<typename Size>
+size_t EulerTourTree<T, Aggregate, Links, EdgeStore>::RankInTour(
+    int v, const Size& size) const {
+  assert(stale_elements_.empty());
+  return vertices_[v].Rank(size);
+}
+
+template<typename T, typename Aggregate, typename Links, typename EdgeStore>
+template<typename Size>
+int EulerTourTree<T, Aggregate, Links, EdgeStore>::KthVertexInTour(
+    int v, size_t k, const Size& size) const {
+  assert(stale_elements_.empty());
+  return VertexOf(AugmentedElement::Select(&vertices_[v], k, size));
+}
+
+template<typename T, typename Aggregate, typename Links, typename EdgeStore>
+template<typename Size>
+parlay::sequence<int> EulerTourTree<T, Aggregate, Links, EdgeStore>::BatchKthVertexInTour(
+    const parlay::sequence<std::pair<int, size_t>>& queries,
+    const Size& size) const {
+  assert(stale_elements_.empty());
+  return parlay::map(queries, [&] (const std::pair<int, size_t>& query) {
+    return KthVertexInTour(query.first, query.second, size);
+  });
+}
+
+template<typename T, typename Aggregate, typename Links, typename EdgeStore>
+template<typename Size>
+int EulerTourTree<T, Aggregate, Links, EdgeStore>::SampleVertexInComponent(
+    int v, size_t random_int, const Size& size) const {
+  return KthVertexInTour(v, random_int % size(ComponentAggregate(v)), size);
+}
+
+template<typename T, typename Aggregate, typename Links, typename EdgeStore>
+template<typename Predicate>
+int EulerTourTree<T, Aggregate, Links, EdgeStore>::FindFirstVertex(
+    int v, const Predicate& predicate) const {
+  assert(stale_elements_.empty());
+  return VertexOf(AugmentedElement::FindFirst(&vertices_[v], predicate));
+}
+
+template<typename T, typename Aggregate, typename Links, typename EdgeStore>
+template<typename Predicate>
+parlay::sequence<int> EulerTourTree<T, Aggregate, Links, EdgeStore>::FindAllVertices(
+    int v, const Predicate& predicate) const {
+  assert(stale_elements_.empty());
+  return parlay::map(AugmentedElement::FindAll(&vertices_[v], predicate),
+      [&] (const AugmentedElement* element) { return VertexOf(element); });
+}
+
+template<typename T, typename Aggregate, typename Links, typename EdgeStore>
+template<typename Predicate>
+parlay::sequence<int> EulerTourTree<T, Aggregate, Links, EdgeStore>::BatchFindFirstVertex(
+    const parlay::sequence<int>& vertices, const Predicate& predicate) const {
+  assert(stale_elements_.empty());
+  return parlay::map(vertices, [&] (int v) {
+    return FindFirstVertex(v, predicate);
+  });
+}
+
+template<typename T, typename Aggregate, typename Links, typename EdgeStore>
+int EulerTourTree<T, Aggregate, Links, EdgeStore>::VertexOf(
+    const AugmentedElement* element) const {
+  return element == nullptr ? -1
+    : static_cast<const Element*>(element) - vertices_;
+}
+
+template<typename T, typename Aggregate, typename Links, typename EdgeStore>
+void EulerTourTree<T, Aggregate, Links, EdgeStore>::CacheComponentIds() {
+  if (!component_ids_.IsEnabled()) {
+    component_ids_.Enable(num_vertices_, num_elements_);
+  }
+  component_ids_.Refresh([&] (const parlay::sequence<int>& vertices) {
+    return FindRepresentativeIds(vertices);
+  });
+}
+
+template<typename T, typename Aggregate, typename Links, typename EdgeStore>
+void EulerTourTree<T, Aggregate, Links, EdgeStore>::InvalidateComponents(
+    const pair<int, int>* edges, int len) {
+  component_ids_.Invalidate(edges, len);
+  // Past one endpoint per vertex, the next snapshot is rebuilt from scratch
+  // and more endpoints would only take up memory.
+  if (num_snapshots_ > 0 &&
+      snapshot_endpoints_.size() <= static_cast<size_t>(num_vertices_)) {
+    snapshot_endpoints_.append(parlay::delayed_seq<int>(2 * len, [&] (size_t i) {
+      return i % 2 == 0 ? edges[i / 2].first : edges[i / 2].second;
+    }));
+  }
+}
+
+template<typename T, typename Aggregate, typename Links, typename EdgeStore>
+void EulerTourTree<T, Aggregate, Links, EdgeStore>::PublishSnapshot() {
+  using Chunk = ConnectivitySnapshot::Chunk;
+  constexpr int kChunkSize{ConnectivitySnapshot::kChunkSize};
+  const int num_chunks{(num_vertices_ + kChunkSize - 1) / kChunkSize};
+  parlay::sequence<std::shared_ptr<const Chunk>> chunks;
+  if (num_snapshots_ == 0 || snapshot_endpoints_.size() > static_cast<size_t>(num_vertices_)) {
+    // Recompute every identifier.
+    const parlay::sequence<size_t> ids{FindRepresentativeIds(
+        parlay::tabulate(num_vertices_, [] (size_t v) {
+          return static_cast<int>(v);
+        }))};
+    chunks = parlay::tabulate(num_chunks, [&] (size_t i) {
+      const size_t begin{i * kChunkSize};
+      const size_t end{std::min(begin + kChunkSize, ids.size())};
+      return std::shared_ptr<const Chunk>{std::make_shared<const Chunk>(
+          ids.begin() + begin, ids.begin() + end)};
+    });
+  } else {
+    // Every vertex whose tree changed is now in a tree with one of the
+    // endpoints. Collect the vertices of each such tree once, descending its
+    // skip list in parallel.
+    const parlay::sequence<size_t> representatives{
+      FindRepresentativeIds(snapshot_endpoints_)};
+    const parlay::sequence<AugmentedElement*> trees{
+      parallel_skip_list::_internal::Deduplicate(
+          parlay::map(representatives, [&] (size_t id) -> AugmentedElement* {
+            return &elements_[id];
+          }),
+          [&] (const AugmentedElement* element) {
+            return static_cast<size_t>(
+                static_cast<const Element*>(element) - elements_);
+          }).first};
+    parlay::sequence<parlay::sequence<std::pair<int, size_t>>> tree_ids{
+      parlay::map(trees, [&] (const AugmentedElement* representative) {
+        const size_t id{static_cast<size_t>(
+            static_cast<const Element*>(representative) - elements_)};
+        const parlay::sequence<int> tour{parlay::map(
+            AugmentedElement::FindAll(representative,
+                [] (const auto&) { return true; }),
+            [&] (const AugmentedElement* element) {
+              return VertexOf(element);
+            })};
+        return parlay::map(
+            parlay::filter(tour, [&] (int v) { return v < num_vertices_; }),
+            [&] (int v) { return std::make_pair(v, id); });
+      })};
+    parlay::sequence<std::pair<int, size_t>> ids{parlay::flatten(tree_ids)};
+    parlay::integer_sort_inplace(ids, [&] (const std::pair<int, size_t>& vertex_id) {
+      return static_cast<size_t>(vertex_id.first / kChunkSize);
+    });
+    // Copy each chunk that holds a changed vertex, and share the rest.
+    const parlay::sequence<int> chunk_starts{parlay::pack_index<int>(
+        parlay::delayed_seq<bool>(ids.size(), [&] (size_t i) {
+          return i == 0 ||
+            ids[i].first / kChunkSize != ids[i - 1].first / kChunkSize;
+        }))};
+    chunks = std::atomic_load(&snapshot_)->Chunks();
+    parallel_for (0, chunk_starts.size(), [&] (size_t i) {
+      const size_t begin{static_cast<size_t>(chunk_starts[i])};
+      const size_t end{i + 1 < chunk_starts.size()
+        ? static_cast<size_t>(chunk_starts[i + 1]) : ids.size()};
+      const int chunk{ids[begin].first / kChunkSize};
+      Chunk copy{*chunks[chunk]};
+      for (size_t j = begin; j < end; j++) {
+        copy[ids[j].first % kChunkSize] = ids[j].second;
+      }
+      chunks[chunk] = std::make_shared<const Chunk>(std::move(copy));
+    });
+  }
+  snapshot_endpoints_.clear();
+  num_snapshots_++;
+  std::atomic_store(&snapshot_,
+      std::shared_ptr<const ConnectivitySnapshot>{std::make_shared<
+        const ConnectivitySnapshot>(num_snapshots_, std::move(chunks))});
+}
+
+template<typename T, typename Aggregate, typename Links, typename EdgeStore>
+std::shared_ptr<const ConnectivitySnapshot>
+EulerTourTree<T, Aggregate, Links, EdgeStore>::GetSnapshot() const {
+  return std::atomic_load(&snapshot_);
+}
+
+template<typename T, typename Aggregate, typename Links, typename EdgeStore>
+void EulerTourTree<T, Aggregate, Links, EdgeStore>::DeferAggregates(bool defer) {
+  defer_aggregates_ = defer;
+  if (!defer) {
+    FlushAggregates();
+  }
+}
+
+template<typename T, typename Aggregate, typename Links, typename EdgeStore>
+void EulerTourTree<T, Aggregate, Links, EdgeStore>::Flush() {
+  FlushAggregates();
+}
+
+template<typename T, typename Aggregate, typename Links, typename EdgeStore>
+void EulerTourTree<T, Aggregate, Links, EdgeStore>::RecomputeAggregates(
+    parlay::sequence<AugmentedElement*>& elements) {
+  if (defer_aggregates_) {
+    stale_elements_.append(parlay::filter(elements,
+        [] (const AugmentedElement* element) { return element != nullptr; }));
+    if (stale_elements_.size() > static_cast<size_t>(num_elements_)) {
+      FlushAggregates();
+    }
+  } else {
+    Element::BatchRecomputeAggregate(elements);
+  }
+}
+
+template<typename T, typename Aggregate, typename Links, typename EdgeStore>
+void EulerTourTree<T, Aggregate, Links, EdgeStore>::DeferRecompute(
+    AugmentedElement* element) {
+  stale_elements_.push_back(element);
+  // Once there are more records than elements, a flush costs no more than
+  // recomputing every aggregate, so flush to keep the records bounded.
+  if (stale_elements_.size() > static_cast<size_t>(num_elements_)) {
+    FlushAggregates();
+  }
+}
+
+// Every stale aggregate belongs to an ancestor of a recorded element. The links
+// and cuts that made it stale recorded an element it was an ancestor of, and a
+// later split between the two records an element in between, so the
+// recomputation from the recorded elements' current ancestors covers it.
+template<typename T, typename Aggregate, typename Links, typename EdgeStore>
+void EulerTourTree<T, Aggregate, Links, EdgeStore>::FlushAggregates() {
+  if (stale_elements_.empty()) {
+    return;
+  }
+  AugmentedElement::BatchRecomputeAggregate(stale_elements_);
+  stale_elements_.clear();
+}
+
+template<typename T, typename Aggregate, typename Links, typename EdgeStore>
+void EulerTourTree<T, Aggregate, Links, EdgeStore>::AddToComponent(
+    int v, const Tag& delta) {
+  AugmentedElement::ApplyToList(&vertices_[v], delta);
+}
+
+template<typename T, typename Aggregate, typename Links, typename EdgeStore>
+void EulerTourTree<T, Aggregate, Links, EdgeStore>::AddToSubtree(
+    int v, int parent, const Tag& delta) {
+  Element* down{edges_.Find(parent, v)};
+  AugmentedElement::ApplyToSubsequence(down, down->GetTwin(), delta);
+}
+
+template<typename T, typename Aggregate, typename Links, typename EdgeStore>
+void EulerTourTree<T, Aggregate, Links, EdgeStore>::BatchAddToComponent(
+    const parlay::sequence<int>& vertices,
+    const parlay::sequence<Tag>& deltas) {
+  AugmentedElement::BatchApplyToList(
+      parlay::map(vertices, [&] (int v) {
+        return static_cast<AugmentedElement*>(&vertices_[v]);
+      }),
+      deltas);
+}
+
+template<typename T, typename Aggregate, typename Links, typename EdgeStore>
+void EulerTourTree<T, Aggregate, Links, EdgeStore>::BatchAddToSubtree(
+    const parlay::sequence<std::pair<int, int>>& subtrees,
+    const parlay::sequence<Tag>& deltas) {
+  AugmentedElement::BatchApplyToSubsequence(
+      parlay::map(subtrees, [&] (const std::pair<int, int>& subtree) {
+        Element* down{edges_.Find(subtree.second, subtree.first)};
+        return std::make_pair(static_cast<AugmentedElement*>(down),
+            static_cast<AugmentedElement*>(down->GetTwin()));
+      }),
+      deltas);
+}
+
+template<typename T, typename Aggregate, typename Links, typename EdgeStore>
+void EulerTourTree<T, Aggregate, Links, EdgeStore>::Link(int u, int v) {
+  LinkEdge(u, v, augmentation_.Identity());
+}
+
+template<typename T, typename Aggregate, typename Links, typename EdgeStore>
+void EulerTourTree<T, Aggregate, Links, EdgeStore>::LinkWithValue(
+    int u, int v, T value) {
+  static_assert(kEdgeValuesAllowed,
+      "edge values of an aggregate with tags must be able to opt out of them");
+  LinkEdge(u, v, std::move(value));
+}
+
+template<typename T, typename Aggregate, typename Links, typename EdgeStore>
+void EulerTourTree<T, Aggregate, Links, EdgeStore>::LinkEdge(
+    int u, int v, T value) {
+  const std::pair<int, int> edge{u, v};
+  InvalidateComponents(&edge, 1);
+  Element* uv{element_pool_.Acquire()};
+  Element* vu{element_pool_.Acquire()};
+  uv->SetTwin(vu);
+  vu->SetTwin(uv);
+  // The element in direction (min(u, v), max(u, v)) holds the value.
+  (u < v ? uv : vu)->SetDetachedValue(std::move(value));
   edges_.Insert(u, v, uv);
   Element* u_left{&vertices_[u]};
   Element* v_left{&vertices_[v]};
+  Element::PushDown(u_left);
+  Element::PushDown(v_left);
   Element* u_right{static_cast<Element*>(u_left->Split())};
   Element* v_right{static_cast<Element*>(v_left->Split())};
   Element::Join(u_left, uv);
   Element::Join(uv, v_right);
   Element::Join(v_left, vu);
   Element::Join(vu, u_right);
-  Element::RecomputeAggregate(u_left);
-  Element::RecomputeAggregate(uv);
-  Element::RecomputeAggregate(v_left);
-  Element::RecomputeAggregate(vu);
+  if (defer_aggregates_) {
+    for (Element* join_left : {u_left, uv, v_left, vu}) {
+      DeferRecompute(join_left);
+    }
+  } else {
+    Element::RecomputeAggregate(u_left);
+    Element::RecomputeAggregate(uv);
+    Element::RecomputeAggregate(v_left);
+    Element::RecomputeAggregate(vu);
+  }
+}
+
+template<typename T, typename Aggregate, typename Links, typename EdgeStore>
+void EulerTourTree<T, Aggregate, Links, EdgeStore>::BatchLink(const pair<int, int>* links, int len) {
+  BatchLinkEdges(links, nullptr, len);
 }
 
-template<typename T>
-void EulerTourTree<T>::BatchLink(const pair<int, int>* links, int len) {
+template<typename T, typename Aggregate, typename Links, typename EdgeStore>
+void EulerTourTree<T, Aggregate, Links, EdgeStore>::BatchLink(const pair<int, int>* links, const T* values, int len) {
+  static_assert(kEdgeValuesAllowed,
+      "edge values of an aggregate with tags must be able to opt out of them");
+  BatchLinkEdges(links, values, len);
+}
+
+template<typename T, typename Aggregate, typename Links, typename EdgeStore>
+void EulerTourTree<T, Aggregate, Links, EdgeStore>::BatchLinkEdges(const pair<int, int>* links, const T* values, int len) {
   if (len <= 75) {
-    BatchLinkSequential(this, links, len);
+    for (int i = 0; i < len; i++) {
+      LinkEdge(links[i].first, links[i].second,
+          values == nullptr ? augmentation_.Identity() : values[i]);
+    }
     return;
   }
+  InvalidateComponents(links, len);
 
-  // For each added edge {x, y}, allocate elements (x, y) and (y, x).
+  // For each added edge {x, y}, take elements (x, y) and (y, x) from the pool.
   // For each vertex x that shows up in an added edge, split on (x, x). Let
   // succ(x) denote the successor of (x, x) prior to splitting.
   // For each vertex x, identify which y_1, y_2, ... y_k that x will be newly
@@ -201,36 +959,44 @@ void EulerTourTree<T>::BatchLink(const pair<int, int>* links, int len) {
   });
   parlay::integer_sort_inplace(links_both_dirs, [&] (pair<uint32_t,uint32_t> p) { return p.first; });
 
+  Element** new_elements{element_pool_.BatchAcquire(2 * len)};
+  const parlay::sequence<Element*> link_elements = parlay::tabulate(len,
+      [&] (size_t i) {
+        Element* uv{new_elements[2 * i]};
+        Element* vu{new_elements[2 * i + 1]};
+        uv->SetTwin(vu);
+        vu->SetTwin(uv);
+        if (values != nullptr) {
+          (links[i].first < links[i].second ? uv : vu)
+              ->SetDetachedValue(values[i]);
+        }
+        return uv;
+      });
+  edges_.BatchInsert(links, link_elements.begin(), len);
+
   parlay::sequence<Element*> split_successors(2*len);
   parlay::sequence<AugmentedElement*> vertices = parlay::tabulate(2*len, [&] (size_t i) {
     int u, v;
     std::tie(u, v) = links_both_dirs[i];
 
-    // allocate edge element
-    if (u < v) {
-      Element* uv{allocator.create(randomness_.ith_rand(2*i))};
-      Element* vu{allocator.create(randomness_.ith_rand(2*i+1))};
-      uv->twin_ = vu;
-      vu->twin_ = uv;
-      edges_.Insert(u, v, uv);
-    }
-
     // split on each vertex that appears in the input
     if (i == 2 * len - 1 || u != links_both_dirs[i + 1].first) {
-      split_successors[i] = (Element*) vertices_[u].Split();
       return (AugmentedElement*) &vertices_[u];
     } else {
-      split_successors[i] = (Element*) nullptr;
       return (AugmentedElement*) nullptr;
     }
   });
-  randomness_ = randomness_.next();
+  Element::BatchPushDown(vertices);
+  parallel_for (0, 2 * len, [&] (size_t i) {
+    split_successors[i] =
+        vertices[i] == nullptr ? nullptr : (Element*) vertices[i]->Split();
+  });
 
   parlay::sequence<AugmentedElement*> join_lefts = parlay::tabulate(2*len, [&] (size_t i) {
     int u, v;
     std::tie(u, v) = links_both_dirs[i];
     Element* uv{edges_.Find(u, v)};
-    Element* vu{uv->twin_};
+    Element* vu{uv->GetTwin()};
     if (i == 0 ||
         u != links_both_dirs[i - 1].first) {
       Element::Join(&vertices_[u], uv);
@@ -245,29 +1011,66 @@ void EulerTourTree<T>::BatchLink(const pair<int, int>* links, int len) {
     }
     return (AugmentedElement*) vu;
   });
-  Element::BatchRecomputeAggregate(vertices);
-  Element::BatchRecomputeAggregate(join_lefts);
+  RecomputeAggregates(vertices);
+  RecomputeAggregates(join_lefts);
+}
+
+// Each edge is mapped to an edge between the trees containing its endpoints,
+// and a spanning forest of those edges is linked.
+template<typename T, typename Aggregate, typename Links, typename EdgeStore>
+parlay::sequence<bool> EulerTourTree<T, Aggregate, Links, EdgeStore>::BatchLinkIfAcyclic(
+    const parlay::sequence<std::pair<int, int>>& edges) {
+  const size_t len{edges.size()};
+  const parlay::sequence<size_t> representatives{BatchFindRepresentative(
+      parlay::tabulate(2 * len, [&] (size_t i) {
+        return i % 2 == 0 ? edges[i / 2].first : edges[i / 2].second;
+      }))};
+  // Number the trees touched by `edges` from 0.
+  const auto deduplicated{parallel_skip_list::_internal::Deduplicate(
+      parlay::map(representatives, [&] (size_t id) -> AugmentedElement* {
+        return &elements_[id];
+      }),
+      [&] (const AugmentedElement* element) {
+        return static_cast<size_t>(
+            static_cast<const Element*>(element) - elements_);
+      })};
+  const parlay::sequence<int>& trees{deduplicated.second};
+  const parlay::sequence<bool> accepted{_internal::SpanningForest(
+      deduplicated.first.size(),
+      parlay::tabulate(len, [&] (size_t i) {
+        return std::make_pair(trees[2 * i], trees[2 * i + 1]);
+      }))};
+  BatchLink(parlay::pack(edges, accepted));
+  return accepted;
 }
 
-template<typename T>
-void EulerTourTree<T>::Cut(int u, int v) {
+template<typename T, typename Aggregate, typename Links, typename EdgeStore>
+void EulerTourTree<T, Aggregate, Links, EdgeStore>::Cut(int u, int v) {
+  const std::pair<int, int> edge{u, v};
+  InvalidateComponents(&edge, 1);
   Element* uv{edges_.Find(u, v)};
-  Element* vu{uv->twin_};
+  Element* vu{uv->GetTwin()};
   edges_.Delete(u, v);
   Element* u_left{static_cast<Element*>(uv->GetPreviousElement())};
   Element* v_left{static_cast<Element*>(vu->GetPreviousElement())};
+  for (Element* split : {uv, vu, u_left, v_left}) {
+    Element::PushDown(split);
+  }
   Element* v_right{static_cast<Element*>(uv->Split())};
   Element* u_right{static_cast<Element*>(vu->Split())};
   u_left->Split();
   v_left->Split();
-  uv->~Element();
-  allocator.free(uv);
-  vu->~Element();
-  allocator.free(vu);
+  element_pool_.Release(uv);
+  element_pool_.Release(vu);
   Element::Join(u_left, u_right);
   Element::Join(v_left, v_right);
-  Element::RecomputeAggregate(u_left);
-  Element::RecomputeAggregate(v_left);
+  if (defer_aggregates_) {
+    DeferRecompute(u_left);
+    DeferRecompute(v_left);
+  } else {
+    Element::RecomputeAggregate(u_left);
+    Element::RecomputeAggregate(v_left);
+  }
 }
 
 // `ignored`, `join_targets`, and `edge_elements` are scratch space.
@@ -276,9 +1079,13 @@ void EulerTourTree<T>::Cut(int u, int v) {
 // `join_targets` stores sequence elements that need to be joined to each other.
 // `edge_elements[i]` stores a pointer to the sequence element corresponding to
 // edge `cuts[i]`.
-template<typename T>
-void EulerTourTree<T>::BatchCutRecurse(const pair<int, int>* cuts, int len, parlay::sequence<bool>& ignored,
-    parlay::sequence<Element*>& join_targets, parlay::sequence<Element*>& edge_elements) {
+// If `performed` is non-null, cuts of absent edges and all but one of the cuts
+// of each edge are skipped, and `(*performed)[i]` is set to whether `cuts[i]`
+// is not. `len` must then exceed the size at which cuts run sequentially.
+template<typename T, typename Aggregate, typename Links, typename EdgeStore>
+void EulerTourTree<T, Aggregate, Links, EdgeStore>::BatchCutRecurse(const pair<int, int>* cuts, int len, parlay::sequence<bool>& ignored,
+    parlay::sequence<Element*>& join_targets, parlay::sequence<Element*>& edge_elements,
+    parlay::sequence<bool>* performed) {
   if (len <= 75) {
     BatchCutSequential(this, cuts, len);
     return;
@@ -306,21 +1113,47 @@ void EulerTourTree<T>::BatchCutRecurse(const pair<int, int>* cuts, int len, parl
   parallel_for (0, len, [&] (size_t i) {
     ignored[i] = randomness_.ith_rand(i) % kBatchCutRecursiveFactor == 0;
 
-    if (!ignored[i]) {
+    if (performed != nullptr) {
+      // Of the cuts of a present edge, the one that marks it first is
+      // performed, now or in a later round. Cuts (u, v) and (v, u) find twin
+      // elements, so they race to mark the one with the lower address. Skipped
+      // cuts count as ignored in this round and are left out of later rounds.
+      // Other cuts of the edge may still be racing on the lower element, so
+      // the winner only writes to the other one.
+      Element* uv{edges_.Find(cuts[i].first, cuts[i].second)};
+      Element* const lower{uv == nullptr ? nullptr
+        : std::min(uv, uv->GetTwin(), std::less<Element*>{})};
+      (*performed)[i] = lower != nullptr && CAS(&lower->split_mark_, false, true);
+      if (!(*performed)[i]) {
+        ignored[i] = true;
+      } else if (!ignored[i]) {
+        edge_elements[i] = uv;
+        (lower == uv ? uv->GetTwin() : uv)->split_mark_ = true;
+      }
+    } else if (!ignored[i]) {
       int u, v;
       std::tie(u, v) = cuts[i];
       Element* uv{edges_.Find(u, v)};
       edge_elements[i] = uv;
-      Element* vu{uv->twin_};
+      Element* vu{uv->GetTwin()};
       uv->split_mark_ = vu->split_mark_ = true;
     }
   });
   randomness_ = randomness_.next();
+  if (performed != nullptr) {
+    // Edges whose cuts wait for a later round must not look cut in this one.
+    parallel_for (0, len, [&] (size_t i) {
+      if (ignored[i] && (*performed)[i]) {
+        Element* uv{edges_.Find(cuts[i].first, cuts[i].second)};
+        uv->split_mark_ = uv->GetTwin()->split_mark_ = false;
+      }
+    });
+  }
 
   parallel_for (0, len, [&] (size_t i) {
     if (!ignored[i]) {
       Element* uv{edge_elements[i]};
-      Element* vu{uv->twin_};
+      Element* vu{uv->GetTwin()};
 
       Element* left_target = (Element*) uv->GetPreviousElement();
       if (left_target->split_mark_) {
@@ -328,7 +1161,7 @@ void EulerTourTree<T>::BatchCutRecurse(const pair<int, int>* cuts, int len, parl
       } else {
         Element* right_target = (Element*) vu->GetNextElement();
         while (right_target->split_mark_) {
-          right_target = (Element*) right_target->twin_->GetNextElement();
+          right_target = (Element*) right_target->GetTwin()->GetNextElement();
         }
         join_targets[4 * i] = left_target;
         join_targets[4 * i + 1] = right_target;
@@ -340,7 +1173,7 @@ void EulerTourTree<T>::BatchCutRecurse(const pair<int, int>* cuts, int len, parl
       } else {
         Element* right_target = (Element*) uv->GetNextElement();
         while (right_target->split_mark_) {
-          right_target = (Element*) right_target->twin_->GetNextElement();
+          right_target = (Element*) right_target->GetTwin()->GetNextElement();
         }
         join_targets[4 * i + 2] = left_target;
         join_targets[4 * i + 3] = right_target;
@@ -348,10 +1181,22 @@ void EulerTourTree<T>::BatchCutRecurse(const pair<int, int>* cuts, int len, parl
     }
   });
 
+  // Pending tags must be out of the way of the splits below, which are on each
+  // edge element and its predecessor.
+  if constexpr (AugmentedElement::kIsLazy) {
+    Element::BatchPushDown(parlay::tabulate(4 * len, [&] (size_t i) {
+      if (ignored[i / 4]) {
+        return (AugmentedElement*) nullptr;
+      }
+      Element* uv{edge_elements[i / 4]};
+      Element* split{i % 2 == 0 ? uv : uv->GetTwin()};
+      return (AugmentedElement*) (i % 4 < 2 ? split : split->GetPreviousElement());
+    }));
+  }
   parallel_for (0, len, [&] (size_t i) {
     if (!ignored[i]) {
       Element* uv{edge_elements[i]};
-      Element* vu{uv->twin_};
+      Element* vu{uv->GetTwin()};
       uv->Split();
       vu->Split();
       Element* predecessor = (Element*) uv->GetPreviousElement();
@@ -368,29 +1213,35 @@ void EulerTourTree<T>::BatchCutRecurse(const pair<int, int>* cuts, int len, parl
   parlay::sequence<AugmentedElement*> recomputes(2*len);
   parallel_for (0, len, [&] (size_t i) {
     if (!ignored[i]) {
-      // Here we must use `edge_elements[i]` instead of `edges_.Find(u, v)`
-      // because the concurrent hash table cannot handle simultaneous lookups
-      // and deletions.
-      Element* uv{edge_elements[i]};
-      Element* vu{uv->twin_};
-      allocator.destroy(uv);
-      allocator.destroy(vu);
-      int u, v;
-      std::tie(u, v) = cuts[i];
-      edges_.Delete(u, v);
-
       if (join_targets[4 * i] != nullptr) {
         Element::Join(join_targets[4 * i], join_targets[4 * i + 1]);
-        recomputes[i/2] = join_targets[4*i];
+        recomputes[2*i] = join_targets[4*i];
       }
       if (join_targets[4 * i + 2] != nullptr) {
         Element::Join(join_targets[4 * i + 2], join_targets[4 * i + 3]);
-        recomputes[i/2+1] = join_targets[4*i+2];
+        recomputes[2*i+1] = join_targets[4*i+2];
       }
     }
   });
-  Element::BatchRecomputeAggregate(recomputes);
+  RecomputeAggregates(recomputes);
+
+  // Return the spliced-out edge elements to the pool. Here we must use
+  // `edge_elements[i]` instead of `edges_.Find(u, v)` because the concurrent
+  // hash table cannot handle simultaneous lookups and deletions.
+  parlay::sequence<Element*> cut_elements{parlay::pack(
+      parlay::make_slice(edge_elements.begin(), edge_elements.begin() + len),
+      parlay::delayed_seq<bool>(len, [&] (size_t i) { return !ignored[i]; }))};
+  element_pool_.BatchReleaseWithTwins(cut_elements.begin(), cut_elements.size());
+  const parlay::sequence<std::pair<int, int>> performed_cuts{parlay::pack(
+      parlay::make_slice(cuts, cuts + len),
+      parlay::delayed_seq<bool>(len, [&] (size_t i) { return !ignored[i]; }))};
+  edges_.BatchDelete(performed_cuts.begin(), performed_cuts.size());
 
+  if (performed != nullptr) {
+    parallel_for (0, len, [&] (size_t i) {
+      ignored[i] = ignored[i] && (*performed)[i];
+    });
+  }
   auto cuts_seq = seq::sequence<std::pair<int, int>>::tabulate<std::pair<int, int>>(len, [&](size_t i) { return cuts[i]; });
   seq::sequence<bool> ignored_seq(ignored.data(), static_cast<size_t>(len));
   seq::sequence<pair<int, int>> next_cuts_seq{pbbs::pack(cuts_seq, ignored_seq)};
@@ -399,30 +1250,150 @@ void EulerTourTree<T>::BatchCutRecurse(const pair<int, int>* cuts, int len, parl
   pbbs::delete_array(next_cuts_seq.as_array(), next_cuts_seq.size());
 }
 
-template<typename T>
-void EulerTourTree<T>::BatchCut(const pair<int, int>* cuts, int len) {
+template<typename T, typename Aggregate, typename Links, typename EdgeStore>
+void EulerTourTree<T, Aggregate, Links, EdgeStore>::BatchCut(const pair<int, int>* cuts, int len) {
   if (len <= 75) {
     BatchCutSequential(this, cuts, len);
     return;
   }
+  InvalidateComponents(cuts, len);
   parlay::sequence<bool> ignored(len);
   parlay::sequence<Element*> join_targets(4*len);
   parlay::sequence<Element*> edge_elements(len);
   BatchCutRecurse(cuts, len, ignored, join_targets, edge_elements);
 }
 
-template<typename T>
-void EulerTourTree<T>::Update(int v, T new_value) {
+template<typename T, typename Aggregate, typename Links, typename EdgeStore>
+parlay::sequence<bool> EulerTourTree<T, Aggregate, Links, EdgeStore>::BatchCutIfPresent(
+    const parlay::sequence<std::pair<int, int>>& cuts) {
+  const int len{static_cast<int>(cuts.size())};
+  parlay::sequence<bool> performed(len);
+  if (len <= 75) {
+    for (int i = 0; i < len; i++) {
+      performed[i] = edges_.Find(cuts[i].first, cuts[i].second) != nullptr;
+      if (performed[i]) {
+        Cut(cuts[i].first, cuts[i].second);
+      }
+    }
+    return performed;
+  }
+  InvalidateComponents(cuts.begin(), len);
+  parlay::sequence<bool> ignored(len);
+  parlay::sequence<Element*> join_targets(4*len);
+  parlay::sequence<Element*> edge_elements(len);
+  BatchCutRecurse(cuts.begin(), len, ignored, join_targets, edge_elements,
+      &performed);
+  return performed;
+}
+
+template<typename T, typename Aggregate, typename Links, typename EdgeStore>
+void EulerTourTree<T, Aggregate, Links, EdgeStore>::BuildFromForest(const pair<int, int>* edges, int len) {
+  if (len == 0) {
+    return;
+  }
+  InvalidateComponents(edges, len);
+
+  const auto tours{_internal::ComputeEulerTours<AugmentedElement>(
+      vertices_, edges, element_pool_.BatchAcquire(2 * len), len)};
+  edges_.BatchInsert(edges, tours.edge_elements.begin(), len);
+  AugmentedElement::BatchBuildCycles(tours.elements, tours.successors);
+}
+
+template<typename T, typename Aggregate, typename Links, typename EdgeStore>
+void EulerTourTree<T, Aggregate, Links, EdgeStore>::Update(int v, T new_value) {
   Element::Update(&vertices_[v], new_value);
 }
 
-template<typename T>
-void EulerTourTree<T>::BatchUpdate(int* vertices, T* new_values, int len) {
-  Element** update_targets{pbbs::new_array_no_init<Element*>(len)};
-  parallel_for (0, len, [&] (size_t i) {
-    update_targets[i] = vertices_[vertices[i]];
+template<typename T, typename Aggregate, typename Links, typename EdgeStore>
+void EulerTourTree<T, Aggregate, Links, EdgeStore>::UpdateEdge(
+    int u, int v, T value) {
+  static_assert(kEdgeValuesAllowed,
+      "edge values of an aggregate with tags must be able to opt out of them");
+  Element::Update(edges_.Find(std::min(u, v), std::max(u, v)), value);
+}
+
+template<typename T, typename Aggregate, typename Links, typename EdgeStore>
+void EulerTourTree<T, Aggregate, Links, EdgeStore>::BatchUpdateEdge(
+    const parlay::sequence<std::pair<int, int>>& edges,
+    const parlay::sequence<T>& values) {
+  static_assert(kEdgeValuesAllowed,
+      "edge values of an aggregate with tags must be able to opt out of them");
+  parlay::sequence<AugmentedElement*> elements{parlay::map(edges,
+      [&] (const std::pair<int, int>& edge) -> AugmentedElement* {
+        return edges_.Find(std::min(edge.first, edge.second),
+            std::max(edge.first, edge.second));
+      })};
+  parlay::sequence<T> new_values{values};
+  AugmentedElement::BatchUpdate(elements, new_values);
+}
+
+template<typename T, typename Aggregate, typename Links, typename EdgeStore>
+AppliedUpdates EulerTourTree<T, Aggregate, Links, EdgeStore>::ApplyBatch(
+    const parlay::sequence<EdgeUpdate>& updates) {
+  // Sorting the update indices stably by edge puts each edge's last update at
+  // the end of its run.
+  const size_t len{updates.size()};
+  const auto edge_key{[&] (int i) {
+    const int u{updates[i].u};
+    const int v{updates[i].v};
+    return static_cast<uint64_t>(std::min(u, v)) << 32 |
+        static_cast<uint32_t>(std::max(u, v));
+  }};
+  parlay::sequence<int> order{parlay::tabulate(len, [] (size_t i) {
+    return static_cast<int>(i);
+  })};
+  parlay::integer_sort_inplace(order, edge_key);
+  // Keep the last update of each edge if it changes whether the edge is
+  // present.
+  const parlay::sequence<int> net_updates{parlay::pack(order,
+      parlay::delayed_seq<bool>(len, [&] (size_t j) {
+        if (j + 1 < len && edge_key(order[j]) == edge_key(order[j + 1])) {
+          return false;
+        }
+        const EdgeUpdate& update{updates[order[j]]};
+        return update.is_link == (edges_.Find(update.u, update.v) == nullptr);
+      }))};
+
+  const auto edges_of{[&] (bool is_link) {
+    return parlay::map(
+        parlay::filter(net_updates,
+            [&] (int i) { return updates[i].is_link == is_link; }),
+        [&] (int i) { return std::make_pair(updates[i].u, updates[i].v); });
+  }};
+  AppliedUpdates applied{edges_of(false), edges_of(true)};
+  BatchCut(applied.cuts);
+  BatchLink(applied.links);
+  return applied;
+}
+
+template<typename T, typename Aggregate, typename Links, typename EdgeStore>
+void EulerTourTree<T, Aggregate, Links, EdgeStore>::BatchUpdate(const int* vertices, const T* new_values, int len) {
+  BatchUpdate(parlay::sequence<int>(vertices, vertices + len),
+      parlay::sequence<T>(new_values, new_values + len));
+}
+
+template<typename T, typename Aggregate, typename Links, typename EdgeStore>
+void EulerTourTree<T, Aggregate, Links, EdgeStore>::BatchUpdate(
+    const parlay::sequence<int>& vertices,
+    const parlay::sequence<T>& new_values) {
+  // Sorting the update indices stably by vertex puts each vertex's last update
+  // at the end of its run.
+  const size_t len{vertices.size()};
+  parlay::sequence<int> order{parlay::tabulate(len, [] (size_t i) {
+    return static_cast<int>(i);
+  })};
+  parlay::integer_sort_inplace(order, [&] (int i) {
+    return static_cast<uint32_t>(vertices[i]);
   });
-  BatchUpdate(update_targets, new_values, len);
+  const parlay::sequence<int> last_updates{parlay::pack(order,
+      parlay::delayed_seq<bool>(len, [&] (size_t j) {
+        return j + 1 == len || vertices[order[j]] != vertices[order[j + 1]];
+      }))};
+  parlay::sequence<AugmentedElement*> elements{parlay::map(last_updates,
+      [&] (int i) -> AugmentedElement* { return &vertices_[vertices[i]]; })};
+  parlay::sequence<T> values{parlay::map(last_updates,
+      [&] (int i) { return new_values[i]; })};
+  AugmentedElement::BatchUpdate(elements, values);
 }
 
 }  // namespace parallel_euler_tour_tree
@@ -0,0 +1,67 @@
+#pragma once
+
+#include <utility>
+
+#include <parlay/primitives.h>
+#include <parlay/sequence.h>
+
+#include <utilities/include/utils.h>
+
+namespace parallel_euler_tour_tree {
+
+namespace _internal {
+
+// Returns the root of `v`'s set in the union-find forest `parents`, halving
+// the path on the way. May run concurrently with other `FindRoot` and
+// `UniteRoots` calls.
+inline int FindRoot(parlay::sequence<int>& parents, int v) {
+  while (true) {
+    const int parent{parents[v]};
+    const int grandparent{parents[parent]};
+    if (parent == grandparent) {
+      return parent;
+    }
+    CAS(&parents[v], parent, grandparent);
+    v = grandparent;
+  }
+}
+
+// Unites the sets of `u` and `v` in the union-find forest `parents`. Returns
+// true if they were different sets. May run concurrently with other
+// `FindRoot` and `UniteRoots` calls.
+//
+// The root with the larger index is hooked under the other, so no cycles form
+// however the hooks interleave.
+inline bool UniteRoots(parlay::sequence<int>& parents, int u, int v) {
+  while (true) {
+    int u_root{FindRoot(parents, u)};
+    int v_root{FindRoot(parents, v)};
+    if (u_root == v_root) {
+      return false;
+    }
+    if (u_root < v_root) {
+      std::swap(u_root, v_root);
+    }
+    if (CAS(&parents[u_root], u_root, v_root)) {
+      return true;
+    }
+  }
+}
+
+// Returns, for each edge of the graph on vertices [0, `num_vertices`) given by
+// `edges`, whether it belongs to a spanning forest of the graph. The edges are
+// processed in parallel, so which spanning forest is chosen may depend on the
+// schedule.
+inline parlay::sequence<bool> SpanningForest(
+    int num_vertices, const parlay::sequence<std::pair<int, int>>& edges) {
+  parlay::sequence<int> parents{parlay::tabulate(num_vertices, [] (size_t i) {
+    return static_cast<int>(i);
+  })};
+  return parlay::map(edges, [&] (const std::pair<int, int>& edge) {
+    return UniteRoots(parents, edge.first, edge.second);
+  });
+}
+
+}  // namespace _internal
+
+}  // namespace parallel_euler_tour_tree
@@ -2,7 +2,10 @@
 
 #include <utility>
 
+#include <dynamic_trees/parallel_euler_tour_tree/include/adjacency_edge_map.hpp>
+#include <dynamic_trees/parallel_euler_tour_tree/include/component_id_cache.hpp>
 #include <dynamic_trees/parallel_euler_tour_tree/include/edge_map.hpp>
+#include <dynamic_trees/parallel_euler_tour_tree/include/element_pool.hpp>
 #include <dynamic_trees/parallel_euler_tour_tree/include/euler_tour_sequence.hpp>
 #include <sequence/parallel_skip_list/include/skip_list_base.hpp>
 
@@ -18,23 +21,58 @@ namespace parallel_euler_tour_tree {
 // using `IsConnected`. This implementation can also exploit parallelism when
 // many edges are added at once through `BatchLink` or many edges are deleted at
 // once through `BatchCut`.
-class UnaugmentedEulerTourTree {
-using Element = _internal::UnaugmentedElement;
+//
+// Each tree owns all of its memory, so any number of trees may be constructed,
+// used, and destroyed independently and in parallel.
+//
+// `Links` is the skip list link policy. `parallel_skip_list::CompactLinks` uses
+// less memory per element than the default, but limits the forest to
+// `CompactLinks::MaxArrayLength<Element>() / 3` vertices, roughly 2^31 divided
+// by the size of an element in units of its alignment. Constructing a larger
+// forest throws `std::length_error`.
+//
+// `EdgeStore` is the policy for looking up the sequence element of an edge.
+// `AdjacencyEdges` keeps per-vertex edge lists instead of the default hash
+// table.
+template<typename Links, typename EdgeStore = HashEdges>
+class BasicUnaugmentedEulerTourTree {
+using Element = _internal::UnaugmentedElement<Links>;
  public:
-  static parlay::type_allocator<_internal::UnaugmentedElement> allocator;
-
-  UnaugmentedEulerTourTree() = delete;
+  BasicUnaugmentedEulerTourTree() = delete;
   // Initializes n-vertex forest with no edges.
-  explicit UnaugmentedEulerTourTree(int num_vertices);
-  explicit UnaugmentedEulerTourTree(int num_vertices, size_t seed);
-  ~UnaugmentedEulerTourTree();
-  UnaugmentedEulerTourTree(const UnaugmentedEulerTourTree&) = delete;
-  UnaugmentedEulerTourTree(UnaugmentedEulerTourTree&&) = delete;
-  UnaugmentedEulerTourTree& operator=(const UnaugmentedEulerTourTree&) = delete;
-  UnaugmentedEulerTourTree& operator=(UnaugmentedEulerTourTree&&) = delete;
+  explicit BasicUnaugmentedEulerTourTree(int num_vertices);
+  explicit BasicUnaugmentedEulerTourTree(int num_vertices, size_t seed);
+  ~BasicUnaugmentedEulerTourTree();
+  BasicUnaugmentedEulerTourTree(const BasicUnaugmentedEulerTourTree&) = delete;
+  BasicUnaugmentedEulerTourTree(BasicUnaugmentedEulerTourTree&&) = delete;
+  BasicUnaugmentedEulerTourTree& operator=(
+      const BasicUnaugmentedEulerTourTree&) = delete;
+  BasicUnaugmentedEulerTourTree& operator=(
+      BasicUnaugmentedEulerTourTree&&) = delete;
 
   // Returns true if `u` and `v` are in the same tree in the represented forest.
   bool IsConnected(int u, int v) const;
+
+  // Returns, for each vertex in `vertices`, an identifier of the tree
+  // containing it. Two vertices are in the same tree if and only if their
+  // identifiers are equal. Identifiers are only valid until the forest next
+  // changes.
+  parlay::sequence<size_t> BatchFindRepresentative(
+      const parlay::sequence<int>& vertices) const;
+  // Returns `IsConnected(u, v)` for each pair {`u`, `v`} in `queries`. This is
+  // faster than answering the queries one at a time, especially when queries
+  // share vertices or trees.
+  parlay::sequence<bool> BatchIsConnected(
+      const parlay::sequence<std::pair<int, int>>& queries) const;
+  // Computes and caches the tree identifier of each vertex, after which the
+  // queries above read identifiers from the cache instead of walking up the
+  // skip lists. Updates to the forest only discard the cached identifiers of
+  // the trees they touch, and calling this again recomputes just those. The
+  // cache is off until this is first called.
+  void CacheComponentIds();
+
+  // Returns statistics on the store that maps edges to tour elements.
+  EdgeMapStats GetEdgeMapStats() const { return edges_.Stats(); }
   // Adds edge {`u`, `v`} to forest. The addition of this edge must not create a
   // cycle in the graph.
   void Link(int u, int v);
@@ -48,6 +86,13 @@ using Element = _internal::UnaugmentedElement;
   // Removes all edges in the `len`-length array `cuts` from the forest. These
   // edges must be present in the forest and must be distinct.
   void BatchCut(const std::pair<int, int>* cuts, int len);
+  // Adds all edges in the `len`-length array `edges` to the forest, which must
+  // have no edges. Adding these edges must not create cycles in the graph.
+  //
+  // This constructs the Euler tours directly instead of joining them together
+  // piece by piece, so it builds a forest from scratch several times faster
+  // than `BatchLink`.
+  void BuildFromForest(const std::pair<int, int>* edges, int len);
 
   // More modern interface helpers
   void batch_link(parlay::sequence<std::pair<int, int>>& links) {
@@ -62,23 +107,37 @@ using Element = _internal::UnaugmentedElement;
   void BatchCut(const parlay::sequence<std::pair<int, int>>& cuts) {
     BatchCut(cuts.begin(), cuts.size());
   }
+  void BuildFromForest(const parlay::sequence<std::pair<int, int>>& edges) {
+    BuildFromForest(edges.begin(), edges.size());
+  }
 
  private:
+  // `BatchFindRepresentative` without the component identifier cache.
+  parlay::sequence<size_t> FindRepresentativeIds(
+      const parlay::sequence<int>& vertices) const;
   void BatchCutRecurse(const std::pair<int, int>* cuts, int len,
-      bool* ignored, _internal::UnaugmentedElement** join_targets,
-      _internal::UnaugmentedElement** edge_elements);
+      bool* ignored, Element** join_targets, Element** edge_elements);
 
   int num_vertices_;
+  // Number of vertex and edge elements owned by the tree.
+  int num_elements_;
   pbbs::random randomness_;
-
-  std::vector<Element*> node_pool;
+  // Neighbor arrays of all elements.
+  parlay::sequence<typename Element::Neighbors> neighbor_arena_;
+  // All elements. The first `num_vertices_` are the vertex elements.
+  Element* elements_;
+  // Edge elements not currently in any tour.
+  _internal::ElementPool<Element> element_pool_;
+  _internal::ComponentIdCache component_ids_;
  public:
-  _internal::UnaugmentedElement* vertices_;
-  _internal::EdgeMap<Element> edges_;
+  Element* vertices_;
+  typename EdgeStore::template Store<Element> edges_;
 };
 
-parlay::type_allocator<_internal::UnaugmentedElement> UnaugmentedEulerTourTree::allocator;
-
+using UnaugmentedEulerTourTree =
+    BasicUnaugmentedEulerTourTree<parallel_skip_list::PointerLinks>;
+using CompactUnaugmentedEulerTourTree =
+    BasicUnaugmentedEulerTourTree<parallel_skip_list::CompactLinks>;
 
 namespace {
 
@@ -86,13 +145,15 @@ namespace {
   // on them later.
   constexpr int kBatchCutRecursiveFactorUA{100};
 
-  void BatchCutSequential(UnaugmentedEulerTourTree* ett, const pair<int, int>* cuts, int len) {
+  template<typename Links, typename EdgeStore>
+  void BatchCutSequential(BasicUnaugmentedEulerTourTree<Links, EdgeStore>* ett, const pair<int, int>* cuts, int len) {
     for (int i = 0; i < len; i++) {
       ett->Cut(cuts[i].first, cuts[i].second);
     }
   }
 
-  void BatchLinkSequential(UnaugmentedEulerTourTree* ett, const pair<int, int>* links, int len) {
+  template<typename Links, typename EdgeStore>
+  void BatchLinkSequential(BasicUnaugmentedEulerTourTree<Links, EdgeStore>* ett, const pair<int, int>* links, int len) {
     for (int i = 0; i < len; i++) {
       ett->Link(links[i].first, links[i].second);
     }
@@ -100,54 +161,111 @@ namespace {
 
 }  // namespace
 
-UnaugmentedEulerTourTree::UnaugmentedEulerTourTree(int num_vertices)
-    : num_vertices_{num_vertices} , edges_{num_vertices_} , randomness_{} {
-  Element::Initialize();
-  vertices_ = pbbs::new_array_no_init<Element>(num_vertices_);
+template<typename Links, typename EdgeStore>
+BasicUnaugmentedEulerTourTree<Links, EdgeStore>::BasicUnaugmentedEulerTourTree(
+    int num_vertices)
+    : BasicUnaugmentedEulerTourTree{num_vertices, 0} {}
+
+// A forest on n vertices has at most n - 1 edges, so besides the n vertex
+// elements, the tree needs only 2n - 2 edge elements, which go in the pool.
+template<typename Links, typename EdgeStore>
+BasicUnaugmentedEulerTourTree<Links, EdgeStore>::BasicUnaugmentedEulerTourTree(
+    int num_vertices, size_t seed)
+    : num_vertices_{num_vertices}
+    , num_elements_{_internal::NumForestElements<Element, Links>(num_vertices)}
+    , randomness_{seed}
+    , elements_{pbbs::new_array_no_init<Element>(num_elements_)}
+    , element_pool_{elements_ + num_vertices_, num_elements_ - num_vertices_}
+    , vertices_{elements_}
+    , edges_{num_vertices_} {
+  parlay::sequence<size_t> offsets{
+      _internal::LevelOffsets<Element>(num_elements_, randomness_)};
+  neighbor_arena_ =
+      parlay::sequence<typename Element::Neighbors>(offsets[num_elements_]);
+  parallel_for (0, num_elements_, [&] (size_t i) {
+    new (&elements_[i]) Element{
+        randomness_.ith_rand(i), &neighbor_arena_[offsets[i]]};
+  });
   parallel_for (0, num_vertices_, [&] (size_t i) {
-    new (&vertices_[i]) Element{randomness_.ith_rand(i)};
     // The Euler tour on a vertex v (a singleton tree) is simply (v, v).
     Element::Join(&vertices_[i], &vertices_[i]);
   });
   randomness_ = randomness_.next();
-  for (int i = 0; i < 3*num_vertices-2; i++)
-    node_pool.push_back(allocator.create(randomness_.ith_rand(i)));
 }
 
-UnaugmentedEulerTourTree::UnaugmentedEulerTourTree(int num_vertices, size_t seed)
-    : num_vertices_{num_vertices} , edges_{num_vertices_} , randomness_{seed} {
-  Element::Initialize();
-  vertices_ = pbbs::new_array_no_init<Element>(num_vertices_);
-  parallel_for (0, num_vertices_, [&] (size_t i) {
-    new (&vertices_[i]) Element{randomness_.ith_rand(i)};
-    // The Euler tour on a vertex v (a singleton tree) is simply (v, v).
-    Element::Join(&vertices_[i], &vertices_[i]);
+template<typename Links, typename EdgeStore>
+BasicUnaugmentedEulerTourTree<Links, EdgeStore>::~BasicUnaugmentedEulerTourTree() {
+  pbbs::delete_array(elements_, num_elements_);
+}
+
+template<typename Links, typename EdgeStore>
+bool BasicUnaugmentedEulerTourTree<Links, EdgeStore>::IsConnected(int u, int v) const {
+  size_t u_id, v_id;
+  if (component_ids_.Lookup(u, &u_id) && component_ids_.Lookup(v, &v_id)) {
+    return u_id == v_id;
+  }
+  return vertices_[u].FindRepresentative() == vertices_[v].FindRepresentative();
+}
+
+template<typename Links, typename EdgeStore>
+parlay::sequence<size_t> BasicUnaugmentedEulerTourTree<Links, EdgeStore>::BatchFindRepresentative(
+    const parlay::sequence<int>& vertices) const {
+  return component_ids_.Find(vertices,
+      [&] (const parlay::sequence<int>& misses) {
+        return FindRepresentativeIds(misses);
+      });
+}
+
+template<typename Links, typename EdgeStore>
+parlay::sequence<size_t> BasicUnaugmentedEulerTourTree<Links, EdgeStore>::FindRepresentativeIds(
+    const parlay::sequence<int>& vertices) const {
+  const parlay::sequence<Element*> elements = parlay::tabulate(
+      vertices.size(), [&] (size_t i) -> Element* {
+        return &vertices_[vertices[i]];
+      });
+  const parlay::sequence<Element*> representatives{
+      Element::BatchFindRepresentative(elements,
+          [&] (const Element* element) {
+            return static_cast<size_t>(
+                static_cast<const Element*>(element) - elements_);
+          })};
+  return parlay::tabulate(vertices.size(), [&] (size_t i) {
+    return static_cast<size_t>(
+        static_cast<const Element*>(representatives[i]) - elements_);
   });
-  randomness_ = randomness_.next();
-  for (int i = 0; i < 3*num_vertices-2; i++)
-    node_pool.push_back(allocator.create(randomness_.ith_rand(i)));
 }
 
-UnaugmentedEulerTourTree::~UnaugmentedEulerTourTree() {
-  pbbs::delete_array(vertices_, num_vertices_);
-  for (auto node : node_pool)
-    allocator.destroy(node);
-  edges_.FreeElements(&allocator);
-  Element::Finish();
+template<typename Links, typename EdgeStore>
+parlay::sequence<bool> BasicUnaugmentedEulerTourTree<Links, EdgeStore>::BatchIsConnected(
+    const parlay::sequence<std::pair<int, int>>& queries) const {
+  const size_t len{queries.size()};
+  const parlay::sequence<size_t> representatives{
+      BatchFindRepresentative(parlay::tabulate(2 * len, [&] (size_t i) {
+        return i < len ? queries[i].first : queries[i - len].second;
+      }))};
+  return parlay::tabulate(len, [&] (size_t i) {
+    return representatives[i] == representatives[i + len];
+  });
 }
 
-bool UnaugmentedEulerTourTree::IsConnected(int u, int v) const {
-  return vertices_[u].FindRepresentative() == vertices_[v].FindRepresentative();
+template<typename Links, typename EdgeStore>
+void BasicUnaugmentedEulerTourTree<Links, EdgeStore>::CacheComponentIds() {
+  if (!component_ids_.IsEnabled()) {
+    component_ids_.Enable(num_vertices_, num_elements_);
+  }
+  component_ids_.Refresh([&] (const parlay::sequence<int>& vertices) {
+    return FindRepresentativeIds(vertices);
+  });
 }
 
-void UnaugmentedEulerTourTree::Link(int u, int v) {
-  Element* uv{allocator.alloc()};
-  new (uv) Element{randomness_.ith_rand(0)};
-  Element* vu = allocator.alloc();
-  new (vu) Element{randomness_.ith_rand(1)};
-  randomness_ = randomness_.next();
-  uv->twin_ = vu;
-  vu->twin_ = uv;
+template<typename Links, typename EdgeStore>
+void BasicUnaugmentedEulerTourTree<Links, EdgeStore>::Link(int u, int v) {
+  const std::pair<int, int> edge{u, v};
+  component_ids_.Invalidate(&edge, 1);
+  Element* uv{element_pool_.Acquire()};
+  Element* vu{element_pool_.Acquire()};
+  uv->SetTwin(vu);
+  vu->SetTwin(uv);
   edges_.Insert(u, v, uv);
   Element* u_left{&vertices_[u]};
   Element* v_left{&vertices_[v]};
@@ -159,13 +277,15 @@ void UnaugmentedEulerTourTree::Link(int u, int v) {
   Element::Join(vu, u_right);
 }
 
-void UnaugmentedEulerTourTree::BatchLink(const pair<int, int>* links, int len) {
+template<typename Links, typename EdgeStore>
+void BasicUnaugmentedEulerTourTree<Links, EdgeStore>::BatchLink(const pair<int, int>* links, int len) {
   if (len <= 75) {
     BatchLinkSequential(this, links, len);
     return;
   }
+  component_ids_.Invalidate(links, len);
 
-  // For each added edge {x, y}, allocate elements (x, y) and (y, x).
+  // For each added edge {x, y}, take elements (x, y) and (y, x) from the pool.
   // For each vertex x that shows up in an added edge, split on (x, x). Let
   // succ(x) denote the successor of (x, x) prior to splitting.
   // For each vertex x, identify which y_1, y_2, ... y_k that x will be newly
@@ -181,6 +301,17 @@ void UnaugmentedEulerTourTree::BatchLink(const pair<int, int>* links, int len) {
   });
   parlay::integer_sort_inplace(links_both_dirs, [&] (pair<uint32_t,uint32_t> p) { return p.first; });
 
+  Element** new_elements{element_pool_.BatchAcquire(2 * len)};
+  const parlay::sequence<Element*> link_elements = parlay::tabulate(len,
+      [&] (size_t i) {
+        Element* uv{new_elements[2 * i]};
+        Element* vu{new_elements[2 * i + 1]};
+        uv->SetTwin(vu);
+        vu->SetTwin(uv);
+        return uv;
+      });
+  edges_.BatchInsert(links, link_elements.begin(), len);
+
   Element** split_successors{pbbs::new_array_no_init<Element*>(2 * len)};
   parallel_for (0, 2*len, [&] (size_t i) {
     int u, v;
@@ -190,23 +321,13 @@ void UnaugmentedEulerTourTree::BatchLink(const pair<int, int>* links, int len) {
     if (i == 2 * len - 1 || u != links_both_dirs[i + 1].first) {
       split_successors[i] = (Element*) vertices_[u].Split();
     }
-
-    // allocate edge element
-    if (u < v) {
-      Element* uv{allocator.create(randomness_.ith_rand(2*i))};
-      Element* vu{allocator.create(randomness_.ith_rand(2*i+1))};
-      uv->twin_ = vu;
-      vu->twin_ = uv;
-      edges_.Insert(u, v, uv);
-    }
   });
-  randomness_ = randomness_.next();
 
   parallel_for (0, 2*len, [&] (size_t i) {
     int u, v;
     std::tie(u, v) = links_both_dirs[i];
     Element* uv{edges_.Find(u, v)};
-    Element* vu{uv->twin_};
+    Element* vu{uv->GetTwin()};
     if (i == 0 ||
         u != links_both_dirs[i - 1].first) {
       Element::Join(&vertices_[u], uv);
@@ -223,9 +344,12 @@ void UnaugmentedEulerTourTree::BatchLink(const pair<int, int>* links, int len) {
   pbbs::delete_array(split_successors, 2 * len);
 }
 
-void UnaugmentedEulerTourTree::Cut(int u, int v) {
+template<typename Links, typename EdgeStore>
+void BasicUnaugmentedEulerTourTree<Links, EdgeStore>::Cut(int u, int v) {
+  const std::pair<int, int> edge{u, v};
+  component_ids_.Invalidate(&edge, 1);
   Element* uv{edges_.Find(u, v)};
-  Element* vu{uv->twin_};
+  Element* vu{uv->GetTwin()};
   edges_.Delete(u, v);
   Element* u_left{static_cast<Element*>(uv->GetPreviousElement())};
   Element* v_left{static_cast<Element*>(vu->GetPreviousElement())};
@@ -233,15 +357,14 @@ void UnaugmentedEulerTourTree::Cut(int u, int v) {
   Element* u_right{static_cast<Element*>(vu->Split())};
   u_left->Split();
   v_left->Split();
-  uv->~Element();
-  allocator.free(uv);
-  vu->~Element();
-  allocator.free(vu);
+  element_pool_.Release(uv);
+  element_pool_.Release(vu);
   Element::Join(u_left, u_right);
   Element::Join(v_left, v_right);
 }
 
-void UnaugmentedEulerTourTree::BatchCutRecurse(const pair<int, int>* cuts, int len,
+template<typename Links, typename EdgeStore>
+void BasicUnaugmentedEulerTourTree<Links, EdgeStore>::BatchCutRecurse(const pair<int, int>* cuts, int len,
     bool* ignored, Element** join_targets, Element** edge_elements) {
   if (len <= 75) {
     BatchCutSequential(this, cuts, len);
@@ -281,7 +404,7 @@ void UnaugmentedEulerTourTree::BatchCutRecurse(const pair<int, int>* cuts, int l
       std::tie(u, v) = cuts[i];
       Element* uv{edges_.Find(u, v)};
       edge_elements[i] = uv;
-      Element* vu{uv->twin_};
+      Element* vu{uv->GetTwin()};
       uv->split_mark_ = vu->split_mark_ = true;
     }
   });
@@ -290,7 +413,7 @@ void UnaugmentedEulerTourTree::BatchCutRecurse(const pair<int, int>* cuts, int l
   parallel_for (0, len, [&] (size_t i) {
     if (!ignored[i]) {
       Element* uv{edge_elements[i]};
-      Element* vu{uv->twin_};
+      Element* vu{uv->GetTwin()};
 
       Element* left_target = (Element*) uv->GetPreviousElement();
       if (left_target->split_mark_) {
@@ -298,7 +421,7 @@ void UnaugmentedEulerTourTree::BatchCutRecurse(const pair<int, int>* cuts, int l
       } else {
         Element* right_target = (Element*) vu->GetNextElement();
         while (right_target->split_mark_) {
-          right_target = (Element*) right_target->twin_->GetNextElement();
+          right_target = (Element*) right_target->GetTwin()->GetNextElement();
         }
         join_targets[4 * i] = left_target;
         join_targets[4 * i + 1] = right_target;
@@ -310,7 +433,7 @@ void UnaugmentedEulerTourTree::BatchCutRecurse(const pair<int, int>* cuts, int l
       } else {
         Element* right_target = (Element*) uv->GetNextElement();
         while (right_target->split_mark_) {
-          right_target = (Element*) right_target->twin_->GetNextElement();
+          right_target = (Element*) right_target->GetTwin()->GetNextElement();
         }
         join_targets[4 * i + 2] = left_target;
         join_targets[4 * i + 3] = right_target;
@@ -321,7 +444,7 @@ void UnaugmentedEulerTourTree::BatchCutRecurse(const pair<int, int>* cuts, int l
   parallel_for (0, len, [&] (size_t i) {
     if (!ignored[i]) {
       Element* uv{edge_elements[i]};
-      Element* vu{uv->twin_};
+      Element* vu{uv->GetTwin()};
       uv->Split();
       vu->Split();
       Element* predecessor = (Element*) uv->GetPreviousElement();
@@ -337,17 +460,6 @@ void UnaugmentedEulerTourTree::BatchCutRecurse(const pair<int, int>* cuts, int l
 
   parallel_for (0, len, [&] (size_t i) {
     if (!ignored[i]) {
-      // Here we must use `edge_elements[i]` instead of `edges_.Find(u, v)`
-      // because the concurrent hash table cannot handle simultaneous lookups
-      // and deletions.
-      Element* uv{edge_elements[i]};
-      Element* vu{uv->twin_};
-      allocator.destroy(uv);
-      allocator.destroy(vu);
-      int u, v;
-      std::tie(u, v) = cuts[i];
-      edges_.Delete(u, v);
-
       if (join_targets[4 * i] != nullptr) {
         Element::Join(join_targets[4 * i], join_targets[4 * i + 1]);
       }
@@ -357,6 +469,18 @@ void UnaugmentedEulerTourTree::BatchCutRecurse(const pair<int, int>* cuts, int l
     }
   });
 
+  // Return the spliced-out edge elements to the pool. Here we must use
+  // `edge_elements[i]` instead of `edges_.Find(u, v)` because the concurrent
+  // hash table cannot handle simultaneous lookups and deletions.
+  parlay::sequence<Element*> cut_elements{parlay::pack(
+      parlay::make_slice(edge_elements, edge_elements + len),
+      parlay::delayed_seq<bool>(len, [&] (size_t i) { return !ignored[i]; }))};
+  element_pool_.BatchReleaseWithTwins(cut_elements.begin(), cut_elements.size());
+  const parlay::sequence<std::pair<int, int>> performed_cuts{parlay::pack(
+      parlay::make_slice(cuts, cuts + len),
+      parlay::delayed_seq<bool>(len, [&] (size_t i) { return !ignored[i]; }))};
+  edges_.BatchDelete(performed_cuts.begin(), performed_cuts.size());
+
   auto cuts_seq = seq::sequence<std::pair<int, int>>::tabulate<std::pair<int, int>>(len, [&](size_t i) { return cuts[i]; });
   seq::sequence<bool> ignored_seq{seq::sequence<bool>(ignored, len)};
   seq::sequence<pair<int, int>> next_cuts_seq{pbbs::pack(cuts_seq, ignored_seq)};
@@ -365,11 +489,13 @@ void UnaugmentedEulerTourTree::BatchCutRecurse(const pair<int, int>* cuts, int l
   pbbs::delete_array(next_cuts_seq.as_array(), next_cuts_seq.size());
 }
 
-void UnaugmentedEulerTourTree::BatchCut(const pair<int, int>* cuts, int len) {
+template<typename Links, typename EdgeStore>
+void BasicUnaugmentedEulerTourTree<Links, EdgeStore>::BatchCut(const pair<int, int>* cuts, int len) {
   if (len <= 75) {
     BatchCutSequential(this, cuts, len);
     return;
   }
+  component_ids_.Invalidate(cuts, len);
   bool* ignored{pbbs::new_array_no_init<bool>(len)};
   Element** join_targets{pbbs::new_array_no_init<Element*>(4 * len)};
   Element** edge_elements{pbbs::new_array_no_init<Element*>(len)};
@@ -379,4 +505,17 @@ void UnaugmentedEulerTourTree::BatchCut(const pair<int, int>* cuts, int len) {
   pbbs::delete_array(ignored, len);
 }
 
+template<typename Links, typename EdgeStore>
+void BasicUnaugmentedEulerTourTree<Links, EdgeStore>::BuildFromForest(const pair<int, int>* edges, int len) {
+  if (len == 0) {
+    return;
+  }
+  component_ids_.Invalidate(edges, len);
+
+  const auto tours{_internal::ComputeEulerTours<Element>(
+      vertices_, edges, element_pool_.BatchAcquire(2 * len), len)};
+  edges_.BatchInsert(edges, tours.edge_elements.begin(), len);
+  Element::BatchBuildCycles(tours.elements, tours.successors);
+}
+
 }  // namespace parallel_euler_tour_tree
@@ -1,6 +1,14 @@
 #pragma once
 
+#include <algorithm>
+#include <cstdint>
+#include <functional>
+#include <limits>
+#include <optional>
+#include <tuple>
+#include <type_traits>
 #include <utility>
+#include <vector>
 #include <sequence/parallel_skip_list/include/skip_list_base.hpp>
 #include <cassert>
 #include <utilities/include/utils.h>
@@ -11,37 +19,376 @@ constexpr int NA{-1};
 
 namespace parallel_skip_list {
 
-// Batch-parallel augmented skip list. Currently, the augmentation is
-// hardcoded to the sum function with the value 1 assigned to each element. As
-// such, `GetSum()` returns the size of the list.
+int sum(int x, int y) { return x+y; }
+
+// An augmentation (or aggregate) is what is applied over the values of a list.
+// It is a type `Aggregate` that provides
+//   T operator()(const T& x, const T& y) const;  // associative
+//   T Identity() const;
+// where `Identity()` is the value that elements hold before they are assigned
+// one.
 //
-// TODO(tomtseng): Allow user to pass in their own arbitrary associative
-// augmentation functions. The contract for `GetSum` on a cyclic list should be
-// that the function will be applied starting from `this`, because where we
-// begin applying the function matters for non-commutative functions.
+// `Augmentation<T>` picks its operation at run time through `std::function`.
+// The types below it fix their operation at compile time, so combining values
+// compiles down to inline code.
+
+// Applies `aggregate_function`. Its `Identity()` is `default_value`, which need
+// not be an identity element of `aggregate_function`.
 template <typename T>
-class AugmentedElement : public ElementBase<AugmentedElement<T>> {
-  friend class ElementBase<AugmentedElement<T>>;
- public:
-  using ElementBase<AugmentedElement<T>>::Initialize;
-  using ElementBase<AugmentedElement<T>>::Finish;
+struct Augmentation {
+  std::function<T(T,T)> aggregate_function{sum};
+  T default_value{};
+
+  T operator()(const T& x, const T& y) const {
+    return aggregate_function(x, y);
+  }
+  const T& Identity() const { return default_value; }
+};
+
+template <typename T>
+struct SumAggregate {
+  constexpr T operator()(const T& x, const T& y) const { return x + y; }
+  constexpr T Identity() const { return T{}; }
+};
+
+template <typename T>
+struct MinAggregate {
+  constexpr T operator()(const T& x, const T& y) const {
+    return y < x ? y : x;
+  }
+  constexpr T Identity() const { return std::numeric_limits<T>::max(); }
+};
+
+template <typename T>
+struct MaxAggregate {
+  constexpr T operator()(const T& x, const T& y) const {
+    return x < y ? y : x;
+  }
+  constexpr T Identity() const { return std::numeric_limits<T>::lowest(); }
+};
+
+template <typename T>
+struct OrAggregate {
+  constexpr T operator()(const T& x, const T& y) const { return x | y; }
+  constexpr T Identity() const { return T{}; }
+};
+
+// An aggregate may also support updating the values of a whole subsequence at
+// once (see `AugmentedElement::ApplyToSubsequence()`) by providing
+//   using Tag = ...;  // an update to values
+//   Tag NoTag() const;  // the update that changes nothing
+//   T Apply(const T& x, const Tag& tag) const;
+//   Tag Compose(const Tag& a, const Tag& b) const;  // `a` and then `b`
+// where `Apply(x, tag)` for an aggregate x of some values must be the aggregate
+// of those values with `tag` applied to each. Tags must commute. An aggregate
+// whose values can opt out of tags, so that `Apply` leaves them as they are,
+// declares
+//   static constexpr bool kValuesCanOptOut{true};
+//
+// The aggregates below add a tag to each value.
+
+// Sum of some values along with how many there are, which adding a delta to
+// each value needs.
+template <typename T>
+struct CountedSum {
+  T sum{};
+  size_t count{};
+};
+
+// Sums `CountedSum` values. Give each element the count 1, or 0 to exclude it
+// from updates.
+template <typename T>
+struct AddSumAggregate {
+  using Tag = T;
+  static constexpr bool kValuesCanOptOut{true};
+  constexpr CountedSum<T> operator()(
+      const CountedSum<T>& x, const CountedSum<T>& y) const {
+    return {x.sum + y.sum, x.count + y.count};
+  }
+  constexpr CountedSum<T> Identity() const { return {}; }
+  constexpr Tag NoTag() const { return T{}; }
+  constexpr CountedSum<T> Apply(const CountedSum<T>& x, const Tag& delta) const {
+    return {x.sum + static_cast<T>(x.count) * delta, x.count};
+  }
+  constexpr Tag Compose(const Tag& a, const Tag& b) const { return a + b; }
+};
+
+// `MinAggregate` and `MaxAggregate` with adding a delta to each value, which
+// leaves `Identity()` as is.
+template <typename T>
+struct AddMinAggregate : MinAggregate<T> {
+  using Tag = T;
+  constexpr Tag NoTag() const { return T{}; }
+  constexpr T Apply(const T& x, const Tag& delta) const {
+    return x == this->Identity() ? x : x + delta;
+  }
+  constexpr Tag Compose(const Tag& a, const Tag& b) const { return a + b; }
+};
 
-  static concurrent_array_allocator::Allocator<T>* val_allocator;
+template <typename T>
+struct AddMaxAggregate : MaxAggregate<T> {
+  using Tag = T;
+  constexpr Tag NoTag() const { return T{}; }
+  constexpr T Apply(const T& x, const Tag& delta) const {
+    return x == this->Identity() ? x : x + delta;
+  }
+  constexpr Tag Compose(const Tag& a, const Tag& b) const { return a + b; }
+};
 
-  static T* AllocateValueArray(int len) {
-    T* values{val_allocator->Allocate(len)};
-    for (int i = 0; i < len; i++) {
-      values[i] = default_value;
+// Extremum of some values, kept apart by whether tags apply to them.
+template <typename T>
+struct SplitExtremum {
+  T tagged;
+  T untagged;
+};
+
+// `Extremum` (`AddMinAggregate<T>` or `AddMaxAggregate<T>`) over
+// `SplitExtremum` values, so that values can opt out of the deltas. Give each
+// element {x, identity} for deltas to apply to x, or {identity, x} to leave x
+// as it is.
+template <typename T, typename Extremum>
+struct SplitAddAggregate {
+  using Tag = T;
+  static constexpr bool kValuesCanOptOut{true};
+  constexpr SplitExtremum<T> operator()(
+      const SplitExtremum<T>& x, const SplitExtremum<T>& y) const {
+    return {Extremum{}(x.tagged, y.tagged), Extremum{}(x.untagged, y.untagged)};
+  }
+  constexpr SplitExtremum<T> Identity() const {
+    return {Extremum{}.Identity(), Extremum{}.Identity()};
+  }
+  constexpr Tag NoTag() const { return Extremum{}.NoTag(); }
+  constexpr SplitExtremum<T> Apply(
+      const SplitExtremum<T>& x, const Tag& delta) const {
+    return {Extremum{}.Apply(x.tagged, delta), x.untagged};
+  }
+  constexpr Tag Compose(const Tag& a, const Tag& b) const {
+    return Extremum{}.Compose(a, b);
+  }
+  // Returns the extremum of all the values that `x` aggregates.
+  constexpr T Get(const SplitExtremum<T>& x) const {
+    return Extremum{}(x.tagged, x.untagged);
+  }
+};
+
+template <typename T>
+using SplitAddMinAggregate = SplitAddAggregate<T, AddMinAggregate<T>>;
+template <typename T>
+using SplitAddMaxAggregate = SplitAddAggregate<T, AddMaxAggregate<T>>;
+
+// Stands in for the tag of an aggregate without one.
+struct EmptyTag {};
+
+namespace _internal {
+
+template <typename Aggregate, typename = void>
+struct AggregateTag {
+  static constexpr bool kIsLazy{false};
+  using type = EmptyTag;
+};
+
+template <typename Aggregate>
+struct AggregateTag<Aggregate, std::void_t<typename Aggregate::Tag>> {
+  static constexpr bool kIsLazy{true};
+  using type = typename Aggregate::Tag;
+};
+
+// Whether the values of `Aggregate` can opt out of its tags.
+template <typename Aggregate, typename = void>
+struct ValuesCanOptOut : std::false_type {};
+
+template <typename Aggregate>
+struct ValuesCanOptOut<Aggregate,
+    std::void_t<decltype(Aggregate::kValuesCanOptOut)>>
+  : std::bool_constant<Aggregate::kValuesCanOptOut> {};
+
+// Value type of `Aggregate`.
+template <typename Aggregate>
+using AggregateValue =
+    std::decay_t<decltype(std::declval<const Aggregate&>().Identity())>;
+
+// `TupleAggregate` has a tag if any of its components does.
+template <bool kHasTag, typename... Aggregates>
+struct TupleTag {};
+
+template <typename... Aggregates>
+struct TupleTag<true, Aggregates...> {
+  using Tag = std::tuple<typename AggregateTag<Aggregates>::type...>;
+};
+
+}  // namespace _internal
+
+// Aggregates tuples of values componentwise with `Aggregates`, so that one list
+// maintains several aggregates with each structural update. For instance,
+// `TupleAggregate<SumAggregate<int>, MaxAggregate<long>>` aggregates
+// `std::tuple<int, long>` values. Read one component of an aggregate with
+// `std::get`.
+//
+// If some of `Aggregates` have tags, tags are tuples of their tags, with
+// `EmptyTag{}` standing in for the components without one. Values can opt out
+// of tags if each of their components with tags can.
+template <typename... Aggregates>
+struct TupleAggregate : _internal::TupleTag<
+    (_internal::AggregateTag<Aggregates>::kIsLazy || ...), Aggregates...> {
+  using Value = std::tuple<_internal::AggregateValue<Aggregates>...>;
+  static constexpr bool kValuesCanOptOut{
+    ((!_internal::AggregateTag<Aggregates>::kIsLazy ||
+      _internal::ValuesCanOptOut<Aggregates>::value) && ...)};
+
+  std::tuple<Aggregates...> aggregates;
+
+  Value operator()(const Value& x, const Value& y) const {
+    return Combine(x, y, std::index_sequence_for<Aggregates...>{});
+  }
+  Value Identity() const {
+    return std::apply([] (const Aggregates&... aggregate) {
+      return Value{aggregate.Identity()...};
+    }, aggregates);
+  }
+
+  template <typename Self = TupleAggregate, typename Tag = typename Self::Tag>
+  Tag NoTag() const {
+    return std::apply([] (const Aggregates&... aggregate) {
+      return Tag{NoComponentTag(aggregate)...};
+    }, aggregates);
+  }
+  template <typename Self = TupleAggregate, typename Tag = typename Self::Tag>
+  Value Apply(const Value& x, const Tag& tag) const {
+    return ApplyTag(x, tag, std::index_sequence_for<Aggregates...>{});
+  }
+  template <typename Self = TupleAggregate, typename Tag = typename Self::Tag>
+  Tag Compose(const Tag& a, const Tag& b) const {
+    return ComposeTags(a, b, std::index_sequence_for<Aggregates...>{});
+  }
+
+ private:
+  template <size_t... I>
+  Value Combine(
+      const Value& x, const Value& y, std::index_sequence<I...>) const {
+    return Value{std::get<I>(aggregates)(std::get<I>(x), std::get<I>(y))...};
+  }
+
+  template <typename Aggregate>
+  static auto NoComponentTag(const Aggregate& aggregate) {
+    if constexpr (_internal::AggregateTag<Aggregate>::kIsLazy) {
+      return aggregate.NoTag();
+    } else {
+      return EmptyTag{};
     }
-    return values;
   }
+  template <typename Tag, size_t... I>
+  Value ApplyTag(
+      const Value& x, const Tag& tag, std::index_sequence<I...>) const {
+    const auto apply{[] (const auto& aggregate, const auto& value,
+        const auto& component_tag) {
+      if constexpr (_internal::AggregateTag<
+          std::decay_t<decltype(aggregate)>>::kIsLazy) {
+        return aggregate.Apply(value, component_tag);
+      } else {
+        return value;
+      }
+    }};
+    return Value{apply(
+        std::get<I>(aggregates), std::get<I>(x), std::get<I>(tag))...};
+  }
+  template <typename Tag, size_t... I>
+  Tag ComposeTags(
+      const Tag& a, const Tag& b, std::index_sequence<I...>) const {
+    const auto compose{[] (const auto& aggregate, const auto& first,
+        const auto& second) {
+      if constexpr (_internal::AggregateTag<
+          std::decay_t<decltype(aggregate)>>::kIsLazy) {
+        return aggregate.Compose(first, second);
+      } else {
+        return first;
+      }
+    }};
+    return Tag{compose(
+        std::get<I>(aggregates), std::get<I>(a), std::get<I>(b))...};
+  }
+};
+
+// Size function for the order statistics of `AugmentedElement` (see `Rank()`)
+// that takes each value to be a size itself, as with `SumAggregate` over
+// counts.
+struct ValueSize {
+  template <typename T>
+  size_t operator()(const T& value) const { return static_cast<size_t>(value); }
+};
+
+// Size function that takes sizes from component `I` of tuple values, such as
+// the count in a `TupleAggregate`, with `Size`.
+template <size_t I, typename Size = ValueSize>
+struct ComponentSize {
+  Size size{};
+
+  template <typename Tuple>
+  size_t operator()(const Tuple& value) const {
+    return size(std::get<I>(value));
+  }
+};
+
+// Batch-parallel augmented skip list. Each element holds a value, and at each
+// level `i`, each element holds the result of applying the aggregate function
+// over the values of the elements it covers at level `i`.
+//
+// The values live in the same block as the element's neighbor array, directly
+// after it (see `LevelArrayLength()`).
+//
+// If `Aggregate` has tags, the block also holds a tag for each level after the
+// values. The tag at level `i` > 0 is pending for the values that the element's
+// value at level `i` covers on level `i - 1`. Each value includes its own tag
+// but not the tags pending above it, which reads gather on the way and which
+// are pushed down out of the way before the list changes shape around them.
+//
+// Every element refers to an `Aggregate` object. Elements constructed without
+// one use `default_augmentation`, which is shared by all such elements of the
+// same type. For the default `Aggregate` of `Augmentation<T>`, its fields are
+// also exposed through the static `aggregate_function` and `default_value`.
+// Elements that are joined together must use the same aggregate object.
+//
+// `Links` is the link policy; see `ElementBase<>`.
+//
+// The aggregate function must be associative but need not be commutative:
+// aggregates combine values in list order, so sequence aggregates such as
+// matrix products or string hashes work too. A cyclic list has no first
+// element, so `GetSumFromHere()` chooses where to begin.
+template <typename T, typename Aggregate = Augmentation<T>,
+          typename Links = PointerLinks>
+class AugmentedElement
+    : public ElementBase<AugmentedElement<T, Aggregate, Links>, Links> {
+  using Base = ElementBase<AugmentedElement<T, Aggregate, Links>, Links>;
+  friend Base;
+ public:
+  using Base::Initialize;
+  using Base::Finish;
+  using typename Base::Neighbors;
+
+  static Aggregate default_augmentation;
+  static std::function<T(T,T)>& aggregate_function;
+  static T& default_value;
 
-  static std::function<T(T,T)> aggregate_function;
-  static T default_value;
+  // Whether `Aggregate` has tags, in which case the functions below that apply
+  // them may be used.
+  static constexpr bool kIsLazy{_internal::AggregateTag<Aggregate>::kIsLazy};
+  using Tag = typename _internal::AggregateTag<Aggregate>::type;
+
+  // Per-level blocks hold `height` neighbor pairs followed by `height` values
+  // and, if `Aggregate` has tags, `height` tags.
+  static int LevelArrayLength(int height) {
+    return height + (DataSize(height) + sizeof(Neighbors) - 1) /
+      sizeof(Neighbors);
+  }
 
   // See comments on `ElementBase<>`.
   AugmentedElement();
   explicit AugmentedElement(size_t random_int);
+  // Uses the caller-owned block `levels` of length
+  // `LevelArrayLength(HeightFromSeed(random_int))` for the neighbor and value
+  // arrays, and uses the caller-owned `augmentation`. The element does not free
+  // the block.
+  AugmentedElement(size_t random_int, Neighbors* levels,
+      const Aggregate* augmentation);
   ~AugmentedElement();
 
   // For each `{left, right}` in the `len`-length array `joins`, concatenate the
@@ -57,95 +404,376 @@ class AugmentedElement : public ElementBase<AugmentedElement<T>> {
   // after `v`.
   static void BatchSplit(AugmentedElement** splits, int len);
 
-  // For each `i`=0,1,...,`len`-1, assign value `new_values[i]` to element
-  // `elements[i]`.
+  // For each `i`, assign value `new_values[i]` to element `elements[i]`, in
+  // parallel.
   static void BatchUpdate(parlay::sequence<AugmentedElement*>& elements, parlay::sequence<T>& new_values);
   static void BatchRecomputeAggregate(parlay::sequence<AugmentedElement*>& elements);
 
+  // Like `ElementBase<>::BatchBuildCycles`, and also computes the aggregate
+  // values of the built lists from the elements' current values. Tags on an
+  // element are applied to its own value, so each element with tags must be
+  // alone in its list.
+  static void BatchBuildCycles(
+      const parlay::sequence<AugmentedElement*>& elements,
+      const parlay::sequence<AugmentedElement*>& successors);
+
   // Assign value `new_value` to element `element`.
   static void Update(AugmentedElement* element, T new_value);
   static void RecomputeAggregate(AugmentedElement* element, int level = 0);
 
   // Get the result of applying the augmentation function over the subsequence
-  // between `left` and `right` inclusive.
+  // between `left` and `right` inclusive, in list order.
   //
   // `left` and `right` must live in the same list, and `left` must precede
-  // `right` in the list.
+  // `right` in the list. In a cyclic list, the subsequence may wrap around past
+  // the representative.
   //
   // This function does not modify the data structure, so it may run
   // concurrently with other `GetSubsequenceSum` calls and const function calls.
   static T GetSubsequenceSum(const AugmentedElement* left, const AugmentedElement* right);
+  // `GetSubsequenceSum(subsequences[i].first, subsequences[i].second)` for each
+  // `i`, for subsequences of cyclic lists.
+  //
+  // The walks up the skip list are shared as in `BatchFindRepresentative()`.
+  // They proceed level by level, and each element that the walks reach
+  // aggregates the values beside it under its parent once, for all the walks
+  // through it to combine. `key` is as in `BatchFindRepresentative()`.
+  //
+  // May run concurrently with other const function calls.
+  template <typename Key>
+  static parlay::sequence<T> BatchGetSubsequenceSum(
+      const parlay::sequence<std::pair<AugmentedElement*, AugmentedElement*>>&
+          subsequences,
+      const Key& key);
 
   // Get result of applying the augmentation function over the whole list that
-  // the element lives in.
+  // the element lives in, in list order. A cyclic list is aggregated starting
+  // from its representative (see `FindRepresentative()`).
   T GetSum() const;
+  // Get result of applying the augmentation function over the whole list that
+  // the element lives in, in list order starting from this element. An acyclic
+  // list is treated as a cycle, so the values after this element come first,
+  // followed by those before it.
+  T GetSumFromHere() const;
+  // `GetSumFromHere()` of each element of `elements`, computed in parallel.
+  static parlay::sequence<T> BatchGetSumFromHere(
+      const parlay::sequence<AugmentedElement*>& elements);
+
+  // Order statistics. These treat each element as holding `size(value)` items,
+  // where `size` must turn the aggregate into a sum: `size(f(x, y))` is
+  // `size(x) + size(y)`. With `ValueSize` and `SumAggregate`, for instance,
+  // each element's value is its size.
+  //
+  // Positions count from the first element of an acyclic list and from the
+  // representative (see `FindRepresentative()`) of a cyclic one.
+  //
+  // Returns the number of items before this element in its list.
+  template <typename Size = ValueSize>
+  size_t Rank(const Size& size = Size{}) const;
+  // Returns the element holding the item at position `k` of the list that
+  // `list` lives in, which is the element `e` with
+  // `e->Rank() <= k < e->Rank() + size(e's value)`. Returns null if the list
+  // has at most `k` items.
+  template <typename Size = ValueSize>
+  static AugmentedElement* Select(
+      const AugmentedElement* list, size_t k, const Size& size = Size{});
+  // `Rank()` of each element of `elements`, computed in parallel.
+  template <typename Size = ValueSize>
+  static parlay::sequence<size_t> BatchRank(
+      const parlay::sequence<AugmentedElement*>& elements,
+      const Size& size = Size{});
+  // `Select(list, k)` for each `{list, k}` in `queries`, computed in parallel.
+  template <typename Size = ValueSize>
+  static parlay::sequence<AugmentedElement*> BatchSelect(
+      const parlay::sequence<std::pair<AugmentedElement*, size_t>>& queries,
+      const Size& size = Size{});
+
+  // Updates to whole subsequences, for aggregates with tags. A tag applied to a
+  // subsequence is applied to the O(log n) expected values that cover it and
+  // left pending there for the values below.
+  //
+  // Applies `tag` to the value of each element of the list that `list` lives
+  // in.
+  static void ApplyToList(AugmentedElement* list, const Tag& tag);
+  // Applies `tag` to the values of the elements between `left` and `right`
+  // inclusive, which must be as in `GetSubsequenceSum()`.
+  static void ApplyToSubsequence(
+      AugmentedElement* left, AugmentedElement* right, const Tag& tag);
+  // `ApplyToList(lists[i], tags[i])` for each `i`, computed in parallel. The
+  // lists need not be distinct.
+  static void BatchApplyToList(
+      const parlay::sequence<AugmentedElement*>& lists,
+      const parlay::sequence<Tag>& tags);
+  // `ApplyToSubsequence(subsequences[i].first, subsequences[i].second,
+  // tags[i])` for each `i`, computed in parallel. The subsequences may overlap.
+  static void BatchApplyToSubsequence(
+      const parlay::sequence<std::pair<AugmentedElement*, AugmentedElement*>>&
+          subsequences,
+      const parlay::sequence<Tag>& tags);
+  // Applies the tags pending above `element` to the values below them, so that
+  // none are pending over `element`'s value. `Split()` and `Join()` leave
+  // pending tags where they are, so when `Aggregate` has tags, call this on
+  // each element before splitting after it and on each `left` before joining
+  // it. The batch operations above and `Update()` do this themselves. These do
+  // nothing for aggregates without tags.
+  static void PushDown(AugmentedElement* element);
+  // `PushDown()` on each element of `elements`, computed in parallel.
+  static void BatchPushDown(const parlay::sequence<AugmentedElement*>& elements);
+
+  // Searches guided by a predicate on aggregate values. `predicate(x)` for an
+  // aggregate x of some elements' values must be true exactly when it is true
+  // for the value of one of those elements, as with `x != 0` for
+  // `OrAggregate` or `x > 0` for `SumAggregate` over counts. Subsequences
+  // whose aggregate fails the predicate are skipped whole, so each match costs
+  // O(log n) expected time. Lists are searched in the order of `Select()`.
+  //
+  // Returns the first element of the list that `list` lives in whose value
+  // satisfies `predicate`, or null if there is none.
+  template <typename Predicate>
+  static AugmentedElement* FindFirst(
+      const AugmentedElement* list, const Predicate& predicate);
+  // Returns all elements of the list that `list` lives in whose values satisfy
+  // `predicate`, in list order. The search descends a level at a time, in
+  // parallel across the values on each level.
+  template <typename Predicate>
+  static parlay::sequence<AugmentedElement*> FindAll(
+      const AugmentedElement* list, const Predicate& predicate);
+  // `FindFirst(list, predicate)` for each `list` in `lists`, computed in
+  // parallel.
+  template <typename Predicate>
+  static parlay::sequence<AugmentedElement*> BatchFindFirst(
+      const parlay::sequence<AugmentedElement*>& lists,
+      const Predicate& predicate);
+  // `FindAll(list, predicate)` for each `list` in `lists`, computed in
+  // parallel.
+  template <typename Predicate>
+  static parlay::sequence<parlay::sequence<AugmentedElement*>> BatchFindAll(
+      const parlay::sequence<AugmentedElement*>& lists,
+      const Predicate& predicate);
 
-  using ElementBase<AugmentedElement>::FindRepresentative;
-  using ElementBase<AugmentedElement>::GetPreviousElement;
-  using ElementBase<AugmentedElement>::GetNextElement;
+  using Base::FindRepresentative;
+  using Base::GetPreviousElement;
+  using Base::GetNextElement;
 
  private:
-  static void DerivedInitialize();
-  static void DerivedFinish();
+  static_assert(alignof(T) <= alignof(Neighbors),
+      "values are stored after the neighbor array");
+
+  static void DerivedInitialize() {}
+  static void DerivedFinish() {}
+
+  // Bytes after the neighbor array that the values and tags take up.
+  static constexpr size_t TagsOffset(int height) {
+    return (height * sizeof(T) + alignof(Tag) - 1) / alignof(Tag) *
+      alignof(Tag);
+  }
+  static constexpr size_t DataSize(int height) {
+    return kIsLazy ? TagsOffset(height) + height * sizeof(Tag)
+      : height * sizeof(T);
+  }
+  static_assert(alignof(Tag) <= alignof(Neighbors),
+      "tags are stored after the value array");
+
+  // Constructs the value array (and tag array) after the neighbor array.
+  void InitializeValues();
+
+  // A tag to apply to `element`'s value at `level`, or that is pending above
+  // it.
+  struct TaggedNode {
+    AugmentedElement* element;
+    int level;
+    Tag tag;
+  };
+  // Calls `f(element, level)` on each value read by `GetSum()`, which together
+  // cover the list that `list` lives in. No tags are pending above them.
+  template <typename F>
+  static void ForEachListNode(const AugmentedElement* list, const F& f);
+  // Calls `f(element, level)` on each value read by `GetSubsequenceSum()`.
+  template <typename F>
+  static void ForEachSubsequenceNode(
+      AugmentedElement* left, AugmentedElement* right, const F& f);
+  // Applies the tags in `nodes` in parallel, composing the tags of each node.
+  static void BatchApplyTags(parlay::sequence<TaggedNode>& nodes);
+  // Applies `tag` to the value at `level` and leaves it pending for the level
+  // below.
+  void ApplyTag(int level, const Tag& tag);
+  // Moves the tag at `level` to the values that the value at `level` covers on
+  // the level below.
+  void PushTag(int level);
+  // Pushes the tags pending above the value at `level` down to it.
+  void PushDownTo(int level);
+  // Like `UpdateTopDown()`, but pushes down tags on the way down instead of
+  // updating values on the way up.
+  void PushDownTopDown(int level);
+  void PushDownTopDownHelper(int level, AugmentedElement* curr);
+  // Sets `update_level_` on the ancestors of `elements` (see
+  // `BatchRecomputeAggregate()`) and returns those with no left parents, or
+  // null in place of ones claimed by others.
+  static parlay::sequence<AugmentedElement*> MarkAncestors(
+      const parlay::sequence<AugmentedElement*>& elements);
+
+  // `Aggregate::NoTag()`, or an empty tag for aggregates without tags.
+  Tag NoTag() const {
+    if constexpr (kIsLazy) {
+      return augmentation_->NoTag();
+    } else {
+      return Tag{};
+    }
+  }
+  // Returns the composition of the tags pending above the value at `level`.
+  Tag PendingTag(int level) const;
+  // Returns `value` with `pending` applied.
+  decltype(auto) WithTag(const T& value, const Tag& pending) const {
+    if constexpr (kIsLazy) {
+      return augmentation_->Apply(value, pending);
+    } else {
+      return (value);
+    }
+  }
+  // Returns the tags pending above the values on `level - 1` that the value at
+  // `level` covers, given that `pending` is pending above the value at
+  // `level`.
+  Tag TagBelow(int level, const Tag& pending) const {
+    if constexpr (kIsLazy) {
+      return augmentation_->Compose(pending, Tags()[level]);
+    } else {
+      return pending;
+    }
+  }
+  // Returns the value at `level` with the tags pending above it applied.
+  decltype(auto) ValueAt(int level) const {
+    if constexpr (kIsLazy) {
+      return augmentation_->Apply(Values()[level], PendingTag(level));
+    } else {
+      return (Values()[level]);
+    }
+  }
+  // Sets the value at `level` > 0 from `sum`, the aggregate of the values it
+  // covers on the level below.
+  void SetAggregate(int level, T sum) {
+    if constexpr (kIsLazy) {
+      Values()[level] = augmentation_->Apply(sum, Tags()[level]);
+    } else {
+      Values()[level] = std::move(sum);
+    }
+  }
+  // Aggregates the values from this element to the end of its list, which
+  // must be acyclic.
+  T SumToEnd() const;
+  // Aggregates the values before this element in its list, which must be
+  // acyclic, or returns nothing if this is the first element.
+  std::optional<T> SumBefore() const;
+  // Returns the element that order statistics count from in the list that
+  // `list` lives in.
+  static AugmentedElement* ListStart(const AugmentedElement* list);
+  // Returns the values on level `node.level - 1` that `node` covers and that
+  // satisfy `predicate`, each with the tags pending above it.
+  template <typename Predicate>
+  static parlay::sequence<TaggedNode> MatchesBelow(
+      const TaggedNode& node, const Predicate& predicate);
 
   // Update aggregate value of node and clear `join_update_level` after joins.
   void UpdateTopDown(int level);
   void UpdateTopDownHelper(int level, AugmentedElement* curr);
   void UpdateTopDownSequential(int level);
 
-  // When updating augmented values, this marks the lowest index at which the
-  // `values_` needs to be updated.
+  // When updating augmented values, this marks the lowest level at which the
+  // values need to be updated.
   int update_level_;
 
-public:
-  T* values_;
+ protected:
+  // `Values()[i]` is the aggregate value of the element at level `i`.
+  T* Values() const {
+    return reinterpret_cast<T*>(this->neighbors_ + this->height_);
+  }
+  // `Tags()[i]` is the tag at level `i` if `Aggregate` has tags.
+  Tag* Tags() const {
+    return reinterpret_cast<Tag*>(
+        reinterpret_cast<char*>(Values()) + TagsOffset(this->height_));
+  }
+  // Restores the values and tags that the element was constructed with.
+  void ResetValues();
+
+  const Aggregate* augmentation_;
 };
 
-template<typename T>
-concurrent_array_allocator::Allocator<T>* AugmentedElement<T>::val_allocator;
+template<typename T, typename Aggregate, typename Links>
+Aggregate AugmentedElement<T, Aggregate, Links>::default_augmentation{};
 
-int sum(int x, int y) { return x+y; }
+template<typename T, typename Aggregate, typename Links>
+std::function<T(T,T)>& AugmentedElement<T, Aggregate, Links>::aggregate_function =
+    default_augmentation.aggregate_function;
 
-template<typename T>
-std::function<T(T,T)> AugmentedElement<T>::aggregate_function = sum;
+template<typename T, typename Aggregate, typename Links>
+T& AugmentedElement<T, Aggregate, Links>::default_value =
+    default_augmentation.default_value;
 
-template<typename T>
-T AugmentedElement<T>::default_value = 0;
+template<typename T, typename Aggregate, typename Links>
+AugmentedElement<T, Aggregate, Links>::AugmentedElement() :
+  Base{}, update_level_{NA},
+  augmentation_{&default_augmentation} {
+  InitializeValues();
+}
 
-template<typename T>
-void AugmentedElement<T>::DerivedInitialize() {
-  if (val_allocator == nullptr) {
-    val_allocator = new concurrent_array_allocator::Allocator<T>;
-  }
+template<typename T, typename Aggregate, typename Links>
+AugmentedElement<T, Aggregate, Links>::AugmentedElement(size_t random_int) :
+  Base{random_int}, update_level_{NA},
+  augmentation_{&default_augmentation} {
+  InitializeValues();
 }
 
-template<typename T>
-void AugmentedElement<T>::DerivedFinish() {
-  if (val_allocator != nullptr) {
-    delete val_allocator;
-    val_allocator = nullptr;
-  }
+template<typename T, typename Aggregate, typename Links>
+AugmentedElement<T, Aggregate, Links>::AugmentedElement(size_t random_int,
+    Neighbors* levels, const Aggregate* augmentation) :
+  Base{random_int, levels}, update_level_{NA},
+  augmentation_{augmentation} {
+  InitializeValues();
 }
 
-template<typename T>
-AugmentedElement<T>::AugmentedElement() :
-  ElementBase<AugmentedElement>{}, update_level_{NA} {
-  values_ = AllocateValueArray(this->height_);
+template<typename T, typename Aggregate, typename Links>
+AugmentedElement<T, Aggregate, Links>::~AugmentedElement() {
+  T* values{Values()};
+  for (int i = 0; i < this->height_; i++) {
+    values[i].~T();
+  }
+  if constexpr (kIsLazy) {
+    Tag* tags{Tags()};
+    for (int i = 0; i < this->height_; i++) {
+      tags[i].~Tag();
+    }
+  }
 }
 
-template<typename T>
-AugmentedElement<T>::AugmentedElement(size_t random_int) :
-  ElementBase<AugmentedElement>{random_int}, update_level_{NA} {
-  values_ = AllocateValueArray(this->height_);
+template<typename T, typename Aggregate, typename Links>
+void AugmentedElement<T, Aggregate, Links>::InitializeValues() {
+  T* values{Values()};
+  for (int i = 0; i < this->height_; i++) {
+    new (&values[i]) T(augmentation_->Identity());
+  }
+  if constexpr (kIsLazy) {
+    Tag* tags{Tags()};
+    for (int i = 0; i < this->height_; i++) {
+      new (&tags[i]) Tag(augmentation_->NoTag());
+    }
+  }
 }
 
-template<typename T>
-AugmentedElement<T>::~AugmentedElement() {
-  val_allocator->Free(values_, this->height_);
+template<typename T, typename Aggregate, typename Links>
+void AugmentedElement<T, Aggregate, Links>::ResetValues() {
+  T* values{Values()};
+  for (int i = 0; i < this->height_; i++) {
+    values[i] = augmentation_->Identity();
+  }
+  if constexpr (kIsLazy) {
+    Tag* tags{Tags()};
+    for (int i = 0; i < this->height_; i++) {
+      tags[i] = augmentation_->NoTag();
+    }
+  }
 }
 
-template<typename T>
-void AugmentedElement<T>::UpdateTopDownSequential(int level) {
+template<typename T, typename Aggregate, typename Links>
+void AugmentedElement<T, Aggregate, Links>::UpdateTopDownSequential(int level) {
   if (level == 0) {
     if (this->height_ == 1) {
       update_level_ = NA;
@@ -156,16 +784,16 @@ void AugmentedElement<T>::UpdateTopDownSequential(int level) {
   if (update_level_ < level) {
     UpdateTopDownSequential(level - 1);
   }
-  T sum{values_[level - 1]};
-  AugmentedElement* curr{this->neighbors_[level - 1].next};
+  T sum{Values()[level - 1]};
+  AugmentedElement* curr{this->GetNext(level - 1)};
   while (curr != nullptr && curr->height_ < level + 1) {
     if (curr->update_level_ != NA && curr->update_level_ < level) {
       curr->UpdateTopDownSequential(level - 1);
     }
-    sum = aggregate_function(sum, curr->values_[level-1]);
-    curr = curr->neighbors_[level - 1].next;
+    sum = (*augmentation_)(sum, curr->Values()[level-1]);
+    curr = curr->GetNext(level - 1);
   }
-  values_[level] = sum;
+  SetAggregate(level, std::move(sum));
 
   if (this->height_ == level + 1) {
     update_level_ = NA;
@@ -176,8 +804,8 @@ void AugmentedElement<T>::UpdateTopDownSequential(int level) {
 // `level`-th node. `update_level_` is used to determine what nodes need
 // updating. `update_level_` is reset to `NA` for all traversed nodes at end of
 // this function.
-template<typename T>
-void AugmentedElement<T>::UpdateTopDown(int level) {
+template<typename T, typename Aggregate, typename Links>
+void AugmentedElement<T, Aggregate, Links>::UpdateTopDown(int level) {
   if (level <= 6) {
     UpdateTopDownSequential(level);
     return;
@@ -188,56 +816,64 @@ void AugmentedElement<T>::UpdateTopDown(int level) {
 
   // Now that children have correct augmented valeus, update self's augmented
   // value.
-  T sum{values_[level - 1]};
-  AugmentedElement* curr = this->neighbors_[level - 1].next;
+  T sum{Values()[level - 1]};
+  AugmentedElement* curr = this->GetNext(level - 1);
   while (curr != nullptr && curr->height_ < level + 1) {
-    sum = aggregate_function(sum, curr->values_[level-1]);
-    curr = curr->neighbors_[level - 1].next;
+    sum = (*augmentation_)(sum, curr->Values()[level-1]);
+    curr = curr->GetNext(level - 1);
   }
-  values_[level] = sum;
+  SetAggregate(level, std::move(sum));
 
   if (this->height_ == level + 1) {
     update_level_ = NA;
   }
 }
 
-template<typename T>
-void AugmentedElement<T>::UpdateTopDownHelper(int level, AugmentedElement* curr) {
+template<typename T, typename Aggregate, typename Links>
+void AugmentedElement<T, Aggregate, Links>::UpdateTopDownHelper(int level, AugmentedElement* curr) {
   if (curr->update_level_ != NA && curr->update_level_ < level) {
     parlay::parallel_do(
       [&] {
-        auto next = curr->neighbors_[level-1].next;
+        auto next = curr->GetNext(level-1);
         if (next != nullptr && next->height_ < level+1)
           UpdateTopDownHelper(level, next);
       },
       [&] { curr->UpdateTopDown(level-1); }
     );
   } else {
-    auto next = curr->neighbors_[level-1].next;
+    auto next = curr->GetNext(level-1);
     if (next != nullptr && next->height_ < level+1)
       UpdateTopDownHelper(level, next);
   }
 }
 
-// If `new_values` is non-null, for each `i`=0,1,...,`len`-1, assign value
-// `new_vals[i]` to element `elements[i]`.
-//
-// If `new_values` is null, update the augmented values of the ancestors of
-// `elements`, where the "ancestors" of element `v` refer to `v`,
-// `v->FindLeftParent(0)`, `v->FindLeftParent(0)->FindLeftParent(1)`,
-// `v->FindLeftParent(0)->FindLeftParent(2)`, and so on. This functionality is
-// used privately to keep the augmented values correct when the list has
-// structurally changed.
-template<typename T>
-void AugmentedElement<T>::BatchUpdate(parlay::sequence<AugmentedElement*>& elements, parlay::sequence<T>& new_values) {
+// Pushes the tags pending above `elements` down out of the way, so that none
+// is applied to the new values later, then writes the new values on level 0
+// and recomputes the aggregates of all the elements' ancestors in one pass
+// (see `BatchRecomputeAggregate()`).
+template<typename T, typename Aggregate, typename Links>
+void AugmentedElement<T, Aggregate, Links>::BatchUpdate(parlay::sequence<AugmentedElement*>& elements, parlay::sequence<T>& new_values) {
+  BatchPushDown(elements);
   parallel_for (0, new_values.size(), [&] (size_t i) {
-    elements[i]->values_[0] = new_values[i];
+    elements[i]->Values()[0] = new_values[i];
   });
   BatchRecomputeAggregate(elements);
 }
 
-template<typename T>
-void AugmentedElement<T>::BatchRecomputeAggregate(parlay::sequence<AugmentedElement*>& elements) {
+template<typename T, typename Aggregate, typename Links>
+void AugmentedElement<T, Aggregate, Links>::BatchRecomputeAggregate(parlay::sequence<AugmentedElement*>& elements) {
+  const parlay::sequence<AugmentedElement*> top_nodes{MarkAncestors(elements)};
+  parallel_for (0, top_nodes.size(), [&] (size_t i) {
+    if (top_nodes[i] != nullptr) {
+      top_nodes[i]->UpdateTopDown(top_nodes[i]->height_ - 1);
+    }
+  });
+}
+
+template<typename T, typename Aggregate, typename Links>
+parlay::sequence<AugmentedElement<T, Aggregate, Links>*>
+AugmentedElement<T, Aggregate, Links>::MarkAncestors(
+    const parlay::sequence<AugmentedElement*>& elements) {
   // The nodes whose augmented values need updating are the ancestors of
   // `elements`. Some nodes may share ancestors. `top_nodes` will contain,
   // without duplicates, the set of all ancestors of `elements` with no left
@@ -266,45 +902,83 @@ void AugmentedElement<T>::BatchRecomputeAggregate(parlay::sequence<AugmentedElem
       }
     }
   });
+  return top_nodes;
+}
 
-  parallel_for (0, top_nodes.size(), [&] (size_t i) {
-    if (top_nodes[i] != nullptr) {
-      top_nodes[i]->UpdateTopDown(top_nodes[i]->height_ - 1);
-    }
-  });
+template<typename T, typename Aggregate, typename Links>
+void AugmentedElement<T, Aggregate, Links>::BatchBuildCycles(
+    const parlay::sequence<AugmentedElement*>& elements,
+    const parlay::sequence<AugmentedElement*>& successors) {
+  if constexpr (kIsLazy) {
+    // The elements are taken to be alone in their lists, so their tags all
+    // apply to their own values.
+    parallel_for (0, elements.size(), [&] (size_t i) {
+      AugmentedElement* element{elements[i]};
+      const Aggregate& augmentation{*element->augmentation_};
+      for (int level = 1; level < element->height_; level++) {
+        element->Values()[0] =
+            augmentation.Apply(element->Values()[0], element->Tags()[level]);
+        element->Tags()[level] = augmentation.NoTag();
+      }
+    });
+  }
+  // Compute values bottom-up as the links are built. Each element's value on a
+  // level aggregates the values on the level below along the walk that just
+  // found its next element, so that walk is still in cache.
+  Base::BatchBuildCycles(elements, successors,
+      [] (AugmentedElement* element, int level) {
+        const Aggregate& aggregate_function{*element->augmentation_};
+        T sum{element->Values()[level - 1]};
+        AugmentedElement* curr{element->GetNext(level - 1)};
+        while (curr->height_ == level) {
+          sum = aggregate_function(sum, curr->Values()[level - 1]);
+          curr = curr->GetNext(level - 1);
+        }
+        element->Values()[level] = std::move(sum);
+      });
 }
 
-template<typename T>
-void AugmentedElement<T>::Update(AugmentedElement* element, T new_value) {
-  element->values_[0] = new_value;
+template<typename T, typename Aggregate, typename Links>
+void AugmentedElement<T, Aggregate, Links>::Update(AugmentedElement* element, T new_value) {
+  PushDown(element);
+  element->Values()[0] = new_value;
   RecomputeAggregate(element, 0);
 }
 
-template<typename T>
-void AugmentedElement<T>::RecomputeAggregate(AugmentedElement* element, int level) {
+template<typename T, typename Aggregate, typename Links>
+void AugmentedElement<T, Aggregate, Links>::RecomputeAggregate(AugmentedElement* element, int level) {
   AugmentedElement* parent{element->FindLeftParent(level)};
   if (!parent) return;
-  T sum = parent->values_[level];
-  AugmentedElement* curr = parent->neighbors_[level].next;
+  const Aggregate& aggregate_function{*parent->augmentation_};
+  T sum = parent->Values()[level];
+  AugmentedElement* curr = parent->GetNext(level);
   while (curr != nullptr && curr->height_ == level+1) {
-    sum = aggregate_function(sum, curr->values_[level]);
-    curr = curr->neighbors_[level].next;
+    sum = aggregate_function(sum, curr->Values()[level]);
+    curr = curr->GetNext(level);
   }
-  parent->values_[level+1] = std::move(sum);
+  parent->SetAggregate(level + 1, std::move(sum));
   RecomputeAggregate(parent, level+1);
 }
 
-template<typename T>
-void AugmentedElement<T>::BatchJoin(pair<AugmentedElement*, AugmentedElement*>* joins, int len) {
+template<typename T, typename Aggregate, typename Links>
+void AugmentedElement<T, Aggregate, Links>::BatchJoin(pair<AugmentedElement*, AugmentedElement*>* joins, int len) {
+  if constexpr (kIsLazy) {
+    BatchPushDown(parlay::tabulate(len, [&] (size_t i) {
+      return joins[i].first;
+    }));
+  }
   parlay::sequence<AugmentedElement*> join_lefts = parlay::tabulate(len, [&] (size_t i) {
-    AugmentedElement<T>::Join(joins[i].first, joins[i].second);
+    AugmentedElement::Join(joins[i].first, joins[i].second);
     return joins[i].first;
   });
   BatchRecomputeAggregate(join_lefts);
 }
 
-template<typename T>
-void AugmentedElement<T>::BatchSplit(AugmentedElement** splits, int len) {
+template<typename T, typename Aggregate, typename Links>
+void AugmentedElement<T, Aggregate, Links>::BatchSplit(AugmentedElement** splits, int len) {
+  if constexpr (kIsLazy) {
+    BatchPushDown(parlay::tabulate(len, [&] (size_t i) { return splits[i]; }));
+  }
   parlay::sequence<AugmentedElement*> split_lefts = parlay::tabulate(len, [&] (size_t i) {
     splits[i]->Split();
     return splits[i];
@@ -312,55 +986,685 @@ void AugmentedElement<T>::BatchSplit(AugmentedElement** splits, int len) {
   BatchRecomputeAggregate(split_lefts);
 }
 
-template<typename T>
-T AugmentedElement<T>::GetSubsequenceSum(const AugmentedElement* left, const AugmentedElement* right) {
-  int level{0};
-  T sum{right->values_[level]};
+// The walk closes in on the subsequence from both ends, so values passed on the
+// left are appended to `left_sum` and values passed on the right are prepended
+// to `right_sum`.
+template<typename T, typename Aggregate, typename Links>
+T AugmentedElement<T, Aggregate, Links>::GetSubsequenceSum(const AugmentedElement* left, const AugmentedElement* right) {
+  const Aggregate& aggregate_function{*left->augmentation_};
+  std::optional<T> left_sum;
+  T right_sum{right->ValueAt(0)};
   while (left != right) {
-    level = min(left->height_, right->height_) - 1;
+    const int level{min(left->height_, right->height_) - 1};
     if (level == left->height_ - 1) {
-      sum = aggregate_function(sum, left->values_[level]);
-      left = left->neighbors_[level].next;
+      left_sum = left_sum
+        ? aggregate_function(*left_sum, left->ValueAt(level))
+        : T{left->ValueAt(level)};
+      left = left->GetNext(level);
     } else {
-      right = right->neighbors_[level].prev;
-      sum = aggregate_function(sum, right->values_[level]);
+      right = right->GetPrev(level);
+      right_sum = aggregate_function(right->ValueAt(level), right_sum);
     }
   }
-  return sum;
+  return left_sum ? aggregate_function(*left_sum, right_sum) : right_sum;
+}
+
+// The value of an element `e` on level `l` is covered on level `l + 1` by its
+// left parent `p`, which covers `p` through the element before the next parent
+// on level `l`. A walk from the left end climbs from each element to its left
+// parent, adding the values after it under the parent, and a walk from the
+// right end adds the values before it. The walks finish under the first parent
+// in which the left one's element comes before the right one's. Otherwise the
+// subsequence wraps around, and they finish on the top level of the cycle.
+template<typename T, typename Aggregate, typename Links>
+template<typename Key>
+parlay::sequence<T> AugmentedElement<T, Aggregate, Links>::BatchGetSubsequenceSum(
+    const parlay::sequence<std::pair<AugmentedElement*, AugmentedElement*>>&
+        subsequences,
+    const Key& key) {
+  // What the walks through an element on a level share: its left parent, its
+  // position after the parent, and the aggregates of the values before and
+  // after it under the parent. On the top level of a cycle, the parent is
+  // null.
+  struct Climb {
+    AugmentedElement* parent;
+    int rank;
+    std::optional<T> before;
+    std::optional<T> after;
+  };
+  const size_t len{subsequences.size()};
+  if (len == 0) {
+    return {};
+  }
+  const Aggregate& aggregate_function{*subsequences[0].first->augmentation_};
+  const auto combine{[&] (const std::optional<T>& x, const std::optional<T>& y) {
+    return !x ? y : !y ? x : std::optional<T>{aggregate_function(*x, *y)};
+  }};
+  // Aggregates the values on `level` strictly between `left` and `right`.
+  const auto sum_between{[&] (const AugmentedElement* left,
+      const AugmentedElement* right, int level) {
+    std::optional<T> sum;
+    for (const AugmentedElement* curr{left->GetNext(level)}; curr != right;
+         curr = curr->GetNext(level)) {
+      sum = combine(sum, curr->Values()[level]);
+    }
+    return sum;
+  }};
+
+  // `frontiers[l]` holds the distinct elements that the walks reach on level
+  // `l`, `climbs[l][i]` is what walks through `frontiers[l][i]` share, and
+  // `parents[l][i]` is the index of its parent in `frontiers[l + 1]`.
+  auto deduplicated{_internal::Deduplicate(
+      parlay::tabulate(2 * len, [&] (size_t i) {
+        return i % 2 == 0 ? subsequences[i / 2].first
+          : subsequences[i / 2].second;
+      }),
+      key)};
+  const parlay::sequence<int> positions{std::move(deduplicated.second)};
+  std::vector<parlay::sequence<AugmentedElement*>> frontiers;
+  std::vector<parlay::sequence<Climb>> climbs;
+  std::vector<parlay::sequence<int>> parents;
+  frontiers.push_back(std::move(deduplicated.first));
+  for (int level = 0; !frontiers.back().empty(); level++) {
+    climbs.push_back(parlay::map(frontiers.back(),
+        [&] (const AugmentedElement* element) {
+          Climb climb{nullptr, 0, std::nullopt, std::nullopt};
+          const AugmentedElement* curr{element};
+          while (curr->height_ <= level + 1) {
+            curr = curr->GetPrev(level);
+            if (curr == element) {
+              return climb;
+            }
+            climb.before = combine(curr->Values()[level], climb.before);
+            climb.rank++;
+          }
+          climb.parent = const_cast<AugmentedElement*>(curr);
+          for (curr = element->GetNext(level); curr->height_ <= level + 1;
+               curr = curr->GetNext(level)) {
+            climb.after = combine(climb.after, curr->Values()[level]);
+          }
+          return climb;
+        }));
+    deduplicated = _internal::Deduplicate(
+        parlay::map(climbs.back(), [] (const Climb& climb) {
+          return climb.parent;
+        }),
+        key);
+    parents.push_back(std::move(deduplicated.second));
+    frontiers.push_back(std::move(deduplicated.first));
+  }
+
+  return parlay::tabulate(len, [&] (size_t i) -> T {
+    const AugmentedElement* left{subsequences[i].first};
+    const AugmentedElement* right{subsequences[i].second};
+    if (left == right) {
+      return left->ValueAt(0);
+    }
+    // `left_sum` aggregates from the left end through the end of what the left
+    // walk's element covers, and `right_sum` from the start of what the right
+    // walk's element covers through the right end, each with the tags pending
+    // in between applied.
+    T left_sum{left->Values()[0]};
+    T right_sum{right->Values()[0]};
+    int left_position{positions[2 * i]};
+    int right_position{positions[2 * i + 1]};
+    for (int level = 0; ; level++) {
+      const Climb& left_climb{climbs[level][left_position]};
+      const Climb& right_climb{climbs[level][right_position]};
+      const AugmentedElement* left_element{frontiers[level][left_position]};
+      const AugmentedElement* right_element{
+          frontiers[level][right_position]};
+      if (left_climb.parent == nullptr) {
+        // The top level is a cycle with no tags pending above it. If both
+        // walks reached the same element, the values between them are all
+        // the others.
+        return *combine(combine(left_sum,
+            sum_between(left_element, right_element, level)), right_sum);
+      }
+      if (left_climb.parent == right_climb.parent &&
+          left_climb.rank < right_climb.rank) {
+        const AugmentedElement* parent{left_climb.parent};
+        const T sum{*combine(combine(left_sum,
+            sum_between(left_element, right_element, level)), right_sum)};
+        return parent->WithTag(sum,
+            parent->TagBelow(level + 1, parent->PendingTag(level + 1)));
+      }
+      left_sum = *combine(left_sum, left_climb.after);
+      right_sum = *combine(right_climb.before, right_sum);
+      if constexpr (kIsLazy) {
+        left_sum = aggregate_function.Apply(
+            left_sum, left_climb.parent->Tags()[level + 1]);
+        right_sum = aggregate_function.Apply(
+            right_sum, right_climb.parent->Tags()[level + 1]);
+      }
+      left_position = parents[level][left_position];
+      right_position = parents[level][right_position];
+    }
+  });
 }
 
-template<typename T>
-T AugmentedElement<T>::GetSum() const {
+template<typename T, typename Aggregate, typename Links>
+T AugmentedElement<T, Aggregate, Links>::GetSum() const {
   // Here we use knowledge of the implementation of `FindRepresentative()`.
   // `FindRepresentative()` gives some element that reaches the top level of the
-  // list. For acyclic lists, the element is the leftmost one.
+  // list. For acyclic lists, the element is the first one on that level, which
+  // may have elements on lower levels before it.
   AugmentedElement* root{FindRepresentative()};
-  // Sum the values across the top level of the list.
-  int level{root->height_ - 1};
-  T sum{root->values_[level]};
-  AugmentedElement* curr{root->neighbors_[level].next};
-  while (curr != nullptr && curr != root) {
-    sum = aggregate_function(sum, curr->values_[level]);
-    curr = curr->neighbors_[level].next;
+  const int level{root->height_ - 1};
+  if (root->GetPrev(level) == nullptr) {
+    const std::optional<T> before{root->SumBefore()};
+    T after{root->SumToEnd()};
+    return before ? (*augmentation_)(*before, after) : after;
+  }
+  // Sum the values across the top level of the cycle.
+  const Aggregate& aggregate_function{*augmentation_};
+  T sum{root->Values()[level]};
+  AugmentedElement* curr{root->GetNext(level)};
+  while (curr != root) {
+    sum = aggregate_function(sum, curr->Values()[level]);
+    curr = curr->GetNext(level);
+  }
+  return sum;
+}
+
+template<typename T, typename Aggregate, typename Links>
+T AugmentedElement<T, Aggregate, Links>::GetSumFromHere() const {
+  const AugmentedElement* prev{this->GetPreviousElement()};
+  if (prev == nullptr) {
+    return SumToEnd();
+  }
+  const AugmentedElement* representative{FindRepresentative()};
+  if (representative->GetPrev(representative->height_ - 1) != nullptr) {
+    return GetSubsequenceSum(this, prev);
+  }
+  const std::optional<T> before{SumBefore()};
+  T after{SumToEnd()};
+  return before ? (*augmentation_)(after, *before) : after;
+}
+
+template<typename T, typename Aggregate, typename Links>
+parlay::sequence<T> AugmentedElement<T, Aggregate, Links>::BatchGetSumFromHere(
+    const parlay::sequence<AugmentedElement*>& elements) {
+  return parlay::map(elements, [&] (const AugmentedElement* element) {
+    return element->GetSumFromHere();
+  });
+}
+
+// Mirrors `Rank()`: walks right from this element, climbing to each element's
+// top level, whose value covers exactly the elements up to the next element on
+// the walk.
+template<typename T, typename Aggregate, typename Links>
+T AugmentedElement<T, Aggregate, Links>::SumToEnd() const {
+  const Aggregate& aggregate_function{*augmentation_};
+  T sum{ValueAt(this->height_ - 1)};
+  const AugmentedElement* curr{this->GetNext(this->height_ - 1)};
+  while (curr != nullptr) {
+    const int level{curr->height_ - 1};
+    sum = aggregate_function(sum, curr->ValueAt(level));
+    curr = curr->GetNext(level);
   }
+  return sum;
+}
+
+// Mirrors `Rank()`.
+template<typename T, typename Aggregate, typename Links>
+std::optional<T> AugmentedElement<T, Aggregate, Links>::SumBefore() const {
+  const Aggregate& aggregate_function{*augmentation_};
+  std::optional<T> sum;
+  const AugmentedElement* curr{this};
+  int level{this->height_ - 1};
+  while (level >= 0) {
+    const AugmentedElement* prev{curr->GetPrev(level)};
+    if (prev == nullptr) {
+      level--;
+    } else {
+      sum = sum ? aggregate_function(prev->ValueAt(level), *sum)
+                : T{prev->ValueAt(level)};
+      curr = prev;
+      level = curr->height_ - 1;
+    }
+  }
+  return sum;
+}
+
+template<typename T, typename Aggregate, typename Links>
+template<typename F>
+void AugmentedElement<T, Aggregate, Links>::ForEachListNode(
+    const AugmentedElement* list, const F& f) {
+  AugmentedElement* root{list->FindRepresentative()};
+  int level{root->height_ - 1};
+  AugmentedElement* curr{root};
+  do {
+    f(curr, level);
+    curr = curr->GetNext(level);
+  } while (curr != nullptr && curr != root);
   if (curr == nullptr) {
-    // The list is not circular, so we need to traverse backwards to beginning
-    // of list and sum values to the left of `root`.
     curr = root;
     while (true) {
-      while (level >= 0 && curr->neighbors_[level].prev == nullptr) {
+      while (level >= 0 && curr->GetPrev(level) == nullptr) {
         level--;
       }
       if (level < 0) {
         break;
       }
-      while (curr->neighbors_[level].prev != nullptr) {
-        curr = curr->neighbors_[level].prev;
-        sum = aggregate_function(sum, curr->values_[level]);
+      while (curr->GetPrev(level) != nullptr) {
+        curr = curr->GetPrev(level);
+        f(curr, level);
       }
     }
   }
-  return sum;
+}
+
+template<typename T, typename Aggregate, typename Links>
+template<typename F>
+void AugmentedElement<T, Aggregate, Links>::ForEachSubsequenceNode(
+    AugmentedElement* left, AugmentedElement* right, const F& f) {
+  f(right, 0);
+  while (left != right) {
+    const int level{min(left->height_, right->height_) - 1};
+    if (level == left->height_ - 1) {
+      f(left, level);
+      left = left->GetNext(level);
+    } else {
+      right = right->GetPrev(level);
+      f(right, level);
+    }
+  }
+}
+
+template<typename T, typename Aggregate, typename Links>
+void AugmentedElement<T, Aggregate, Links>::ApplyTag(int level, const Tag& tag) {
+  Values()[level] = augmentation_->Apply(Values()[level], tag);
+  if (level > 0) {
+    Tags()[level] = augmentation_->Compose(Tags()[level], tag);
+  }
+}
+
+template<typename T, typename Aggregate, typename Links>
+void AugmentedElement<T, Aggregate, Links>::PushTag(int level) {
+  const Tag tag{Tags()[level]};
+  Tags()[level] = augmentation_->NoTag();
+  AugmentedElement* curr{this};
+  do {
+    curr->ApplyTag(level - 1, tag);
+    curr = curr->GetNext(level - 1);
+  } while (curr != nullptr && curr->height_ == level);
+}
+
+template<typename T, typename Aggregate, typename Links>
+void AugmentedElement<T, Aggregate, Links>::PushDownTo(int level) {
+  AugmentedElement* parent{this->FindLeftParent(level)};
+  if (parent != nullptr) {
+    parent->PushDownTo(level + 1);
+    parent->PushTag(level + 1);
+  }
+}
+
+// Mirrors `UpdateTopDownSequential()` and `UpdateTopDown()`.
+template<typename T, typename Aggregate, typename Links>
+void AugmentedElement<T, Aggregate, Links>::PushDownTopDown(int level) {
+  if (level == 0) {
+    if (this->height_ == 1) {
+      update_level_ = NA;
+    }
+    return;
+  }
+
+  PushTag(level);
+  if (level <= 6) {
+    if (update_level_ < level) {
+      PushDownTopDown(level - 1);
+    }
+    AugmentedElement* curr{this->GetNext(level - 1)};
+    while (curr != nullptr && curr->height_ < level + 1) {
+      if (curr->update_level_ != NA && curr->update_level_ < level) {
+        curr->PushDownTopDown(level - 1);
+      }
+      curr = curr->GetNext(level - 1);
+    }
+  } else {
+    PushDownTopDownHelper(level, this);
+  }
+
+  if (this->height_ == level + 1) {
+    update_level_ = NA;
+  }
+}
+
+template<typename T, typename Aggregate, typename Links>
+void AugmentedElement<T, Aggregate, Links>::PushDownTopDownHelper(int level, AugmentedElement* curr) {
+  const auto push_rest{[&] {
+    AugmentedElement* next{curr->GetNext(level - 1)};
+    if (next != nullptr && next->height_ < level + 1) {
+      PushDownTopDownHelper(level, next);
+    }
+  }};
+  if (curr->update_level_ != NA && curr->update_level_ < level) {
+    parlay::parallel_do(push_rest, [&] { curr->PushDownTopDown(level - 1); });
+  } else {
+    push_rest();
+  }
+}
+
+template<typename T, typename Aggregate, typename Links>
+void AugmentedElement<T, Aggregate, Links>::PushDown(AugmentedElement* element) {
+  if constexpr (kIsLazy) {
+    element->PushDownTo(0);
+  }
+}
+
+template<typename T, typename Aggregate, typename Links>
+void AugmentedElement<T, Aggregate, Links>::BatchPushDown(
+    const parlay::sequence<AugmentedElement*>& elements) {
+  if constexpr (kIsLazy) {
+    // Ancestors shared by several elements must push their tags down once, so
+    // mark the ancestors as `BatchRecomputeAggregate()` does and push tags down
+    // from each top node.
+    const parlay::sequence<AugmentedElement*> top_nodes{MarkAncestors(elements)};
+    parallel_for (0, top_nodes.size(), [&] (size_t i) {
+      if (top_nodes[i] != nullptr) {
+        top_nodes[i]->PushDownTopDown(top_nodes[i]->height_ - 1);
+      }
+    });
+  }
+}
+
+template<typename T, typename Aggregate, typename Links>
+typename AugmentedElement<T, Aggregate, Links>::Tag
+AugmentedElement<T, Aggregate, Links>::PendingTag(int level) const {
+  Tag pending{augmentation_->NoTag()};
+  const AugmentedElement* curr{this};
+  while (true) {
+    const AugmentedElement* parent{curr->FindLeftParent(level)};
+    if (parent == nullptr) {
+      return pending;
+    }
+    level++;
+    pending = augmentation_->Compose(pending, parent->Tags()[level]);
+    curr = parent;
+  }
+}
+
+template<typename T, typename Aggregate, typename Links>
+void AugmentedElement<T, Aggregate, Links>::ApplyToList(
+    AugmentedElement* list, const Tag& tag) {
+  static_assert(kIsLazy, "the aggregate must have tags");
+  ForEachListNode(list, [&] (AugmentedElement* element, int level) {
+    element->ApplyTag(level, tag);
+  });
+}
+
+// Tags the values that `GetSubsequenceSum()` reads. Each value that covers some
+// of those values and not others also covers `left` or `right`, so it is an
+// ancestor of `left` or `right` and gets recomputed.
+template<typename T, typename Aggregate, typename Links>
+void AugmentedElement<T, Aggregate, Links>::ApplyToSubsequence(
+    AugmentedElement* left, AugmentedElement* right, const Tag& tag) {
+  static_assert(kIsLazy, "the aggregate must have tags");
+  ForEachSubsequenceNode(left, right, [&] (AugmentedElement* element, int level) {
+    element->ApplyTag(level, tag);
+  });
+  RecomputeAggregate(left);
+  RecomputeAggregate(right);
+}
+
+template<typename T, typename Aggregate, typename Links>
+void AugmentedElement<T, Aggregate, Links>::BatchApplyTags(
+    parlay::sequence<TaggedNode>& nodes) {
+  parlay::integer_sort_inplace(nodes, [] (const TaggedNode& node) {
+    return reinterpret_cast<uintptr_t>(node.element) * _internal::kMaxHeight +
+      node.level;
+  });
+  const auto is_first{[&] (size_t i) {
+    return i == 0 || nodes[i].element != nodes[i - 1].element ||
+      nodes[i].level != nodes[i - 1].level;
+  }};
+  const parlay::sequence<size_t> starts{parlay::pack_index<size_t>(
+      parlay::delayed_seq<bool>(nodes.size(), is_first))};
+  parallel_for (0, starts.size(), [&] (size_t i) {
+    const size_t end{i + 1 < starts.size() ? starts[i + 1] : nodes.size()};
+    const TaggedNode& node{nodes[starts[i]]};
+    Tag tag{node.tag};
+    for (size_t j = starts[i] + 1; j < end; j++) {
+      tag = node.element->augmentation_->Compose(tag, nodes[j].tag);
+    }
+    node.element->ApplyTag(node.level, tag);
+  });
+}
+
+template<typename T, typename Aggregate, typename Links>
+void AugmentedElement<T, Aggregate, Links>::BatchApplyToList(
+    const parlay::sequence<AugmentedElement*>& lists,
+    const parlay::sequence<Tag>& tags) {
+  static_assert(kIsLazy, "the aggregate must have tags");
+  parlay::sequence<TaggedNode> nodes{parlay::flatten(
+      parlay::tabulate(lists.size(), [&] (size_t i) {
+        parlay::sequence<TaggedNode> list_nodes;
+        ForEachListNode(lists[i], [&] (AugmentedElement* element, int level) {
+          list_nodes.push_back({element, level, tags[i]});
+        });
+        return list_nodes;
+      }))};
+  BatchApplyTags(nodes);
+}
+
+template<typename T, typename Aggregate, typename Links>
+void AugmentedElement<T, Aggregate, Links>::BatchApplyToSubsequence(
+    const parlay::sequence<std::pair<AugmentedElement*, AugmentedElement*>>&
+        subsequences,
+    const parlay::sequence<Tag>& tags) {
+  static_assert(kIsLazy, "the aggregate must have tags");
+  parlay::sequence<TaggedNode> nodes{parlay::flatten(
+      parlay::tabulate(subsequences.size(), [&] (size_t i) {
+        parlay::sequence<TaggedNode> subsequence_nodes;
+        ForEachSubsequenceNode(subsequences[i].first, subsequences[i].second,
+            [&] (AugmentedElement* element, int level) {
+              subsequence_nodes.push_back({element, level, tags[i]});
+            });
+        return subsequence_nodes;
+      }))};
+  BatchApplyTags(nodes);
+  parlay::sequence<AugmentedElement*> endpoints{
+      parlay::tabulate(2 * subsequences.size(), [&] (size_t i) {
+        return i % 2 == 0 ? subsequences[i / 2].first
+          : subsequences[i / 2].second;
+      })};
+  BatchRecomputeAggregate(endpoints);
+}
+
+// Walks left from this element, climbing to each element's top level. Each
+// element passed on level `level` contributes its value at that level, which
+// covers exactly the elements up to the previous element on the walk.
+template<typename T, typename Aggregate, typename Links>
+template<typename Size>
+size_t AugmentedElement<T, Aggregate, Links>::Rank(const Size& size) const {
+  const AugmentedElement* representative{FindRepresentative()};
+  const bool is_cyclic{
+    representative->GetPrev(representative->height_ - 1) != nullptr};
+  size_t rank{0};
+  const AugmentedElement* curr{this};
+  int level{this->height_ - 1};
+  // The representative of a cyclic list reaches the top level, so the walk
+  // meets it rather than passing it.
+  while (level >= 0 && !(is_cyclic && curr == representative)) {
+    const AugmentedElement* prev{curr->GetPrev(level)};
+    if (prev == nullptr) {
+      level--;
+    } else {
+      rank += size(prev->ValueAt(level));
+      curr = prev;
+      level = curr->height_ - 1;
+    }
+  }
+  return rank;
+}
+
+// Walks right from the start of the list, stepping over an element's values at
+// its top level when all of them precede the target item and descending
+// otherwise.
+template<typename T, typename Aggregate, typename Links>
+template<typename Size>
+AugmentedElement<T, Aggregate, Links>* AugmentedElement<T, Aggregate, Links>::Select(
+    const AugmentedElement* list, size_t k, const Size& size) {
+  AugmentedElement* start{ListStart(list)};
+  AugmentedElement* curr{start};
+  int level{curr->height_ - 1};
+  // Tags pending above `curr`'s value at `level`. Until the walk descends, it
+  // only passes values with none pending above them.
+  Tag pending{start->NoTag()};
+  while (true) {
+    const size_t covered{size(curr->WithTag(curr->Values()[level], pending))};
+    if (k < covered) {
+      if (level == 0) {
+        return curr;
+      }
+      pending = curr->TagBelow(level, pending);
+      level--;
+    } else {
+      k -= covered;
+      curr = curr->GetNext(level);
+      if (curr == nullptr || curr == start) {
+        return nullptr;
+      }
+      level = curr->height_ - 1;
+    }
+  }
+}
+
+template<typename T, typename Aggregate, typename Links>
+template<typename Size>
+parlay::sequence<size_t> AugmentedElement<T, Aggregate, Links>::BatchRank(
+    const parlay::sequence<AugmentedElement*>& elements, const Size& size) {
+  return parlay::map(elements, [&] (const AugmentedElement* element) {
+    return element->Rank(size);
+  });
+}
+
+template<typename T, typename Aggregate, typename Links>
+template<typename Size>
+parlay::sequence<AugmentedElement<T, Aggregate, Links>*>
+AugmentedElement<T, Aggregate, Links>::BatchSelect(
+    const parlay::sequence<std::pair<AugmentedElement*, size_t>>& queries,
+    const Size& size) {
+  return parlay::map(queries,
+      [&] (const std::pair<AugmentedElement*, size_t>& query) {
+        return Select(query.first, query.second, size);
+      });
+}
+
+template<typename T, typename Aggregate, typename Links>
+AugmentedElement<T, Aggregate, Links>* AugmentedElement<T, Aggregate, Links>::ListStart(
+    const AugmentedElement* list) {
+  AugmentedElement* start{list->FindRepresentative()};
+  if (start->GetPrev(start->height_ - 1) == nullptr) {
+    // Acyclic, so move to the head of the list.
+    for (int level = start->height_ - 1; level >= 0; level--) {
+      while (start->GetPrev(level) != nullptr) {
+        start = start->GetPrev(level);
+      }
+    }
+  }
+  return start;
+}
+
+// Same walk as `Select()`, descending into the first covered subsequence whose
+// aggregate satisfies the predicate.
+template<typename T, typename Aggregate, typename Links>
+template<typename Predicate>
+AugmentedElement<T, Aggregate, Links>* AugmentedElement<T, Aggregate, Links>::FindFirst(
+    const AugmentedElement* list, const Predicate& predicate) {
+  AugmentedElement* start{ListStart(list)};
+  AugmentedElement* curr{start};
+  int level{curr->height_ - 1};
+  Tag pending{start->NoTag()};
+  while (true) {
+    if (predicate(curr->WithTag(curr->Values()[level], pending))) {
+      if (level == 0) {
+        return curr;
+      }
+      pending = curr->TagBelow(level, pending);
+      level--;
+    } else {
+      curr = curr->GetNext(level);
+      if (curr == nullptr || curr == start) {
+        return nullptr;
+      }
+      level = curr->height_ - 1;
+    }
+  }
+}
+
+template<typename T, typename Aggregate, typename Links>
+template<typename Predicate>
+parlay::sequence<typename AugmentedElement<T, Aggregate, Links>::TaggedNode>
+AugmentedElement<T, Aggregate, Links>::MatchesBelow(
+    const TaggedNode& node, const Predicate& predicate) {
+  // The value covers `node.element` and the following elements on the level
+  // below up to the next one that is taller.
+  const int level{node.level - 1};
+  const Tag pending_below{node.element->TagBelow(node.level, node.tag)};
+  parlay::sequence<TaggedNode> matches;
+  AugmentedElement* curr{node.element};
+  do {
+    if (predicate(curr->WithTag(curr->Values()[level], pending_below))) {
+      matches.push_back(TaggedNode{curr, level, pending_below});
+    }
+    curr = curr->GetNext(level);
+  } while (curr != nullptr && curr->height_ == level + 1);
+  return matches;
+}
+
+template<typename T, typename Aggregate, typename Links>
+template<typename Predicate>
+parlay::sequence<AugmentedElement<T, Aggregate, Links>*>
+AugmentedElement<T, Aggregate, Links>::FindAll(
+    const AugmentedElement* list, const Predicate& predicate) {
+  // The matching values that cover the list, in list order.
+  parlay::sequence<TaggedNode> matches;
+  AugmentedElement* start{ListStart(list)};
+  AugmentedElement* curr{start};
+  int top_level{0};
+  do {
+    const int level{curr->height_ - 1};
+    if (predicate(curr->Values()[level])) {
+      matches.push_back(TaggedNode{curr, level, start->NoTag()});
+      top_level = std::max(top_level, level);
+    }
+    curr = curr->GetNext(level);
+  } while (curr != nullptr && curr != start);
+  // Replace the matches on each level by the matches they cover on the level
+  // below. Matches on lower levels wait for the descent to reach them.
+  for (int level = top_level; level > 0; level--) {
+    matches = parlay::flatten(parlay::map(matches, [&] (const TaggedNode& node) {
+      return node.level == level ? MatchesBelow(node, predicate)
+        : parlay::sequence<TaggedNode>(1, node);
+    }));
+  }
+  return parlay::map(matches, [] (const TaggedNode& node) {
+    return node.element;
+  });
+}
+
+template<typename T, typename Aggregate, typename Links>
+template<typename Predicate>
+parlay::sequence<AugmentedElement<T, Aggregate, Links>*>
+AugmentedElement<T, Aggregate, Links>::BatchFindFirst(
+    const parlay::sequence<AugmentedElement*>& lists,
+    const Predicate& predicate) {
+  return parlay::map(lists, [&] (const AugmentedElement* list) {
+    return FindFirst(list, predicate);
+  });
+}
+
+template<typename T, typename Aggregate, typename Links>
+template<typename Predicate>
+parlay::sequence<parlay::sequence<AugmentedElement<T, Aggregate, Links>*>>
+AugmentedElement<T, Aggregate, Links>::BatchFindAll(
+    const parlay::sequence<AugmentedElement*>& lists,
+    const Predicate& predicate) {
+  return parlay::map(lists, [&] (const AugmentedElement* list) {
+    return FindAll(list, predicate);
+  });
 }
 
 }  // namespace parallel_skip_list
@@ -1,11 +1,96 @@
 #pragma once
 
+#include <cassert>
+#include <cstdint>
+#include <limits>
+#include <utility>
+#include <vector>
+
+#include <parlay/primitives.h>
+#include <parlay/sequence.h>
+
 #include <sequence/parallel_skip_list/include/concurrent_array_allocator.hpp>
 #include <utilities/include/random.h>
 #include <utilities/include/utils.h>
 
 namespace parallel_skip_list {
 
+namespace _internal {
+
+// Wrapping a template parameter in this keeps it from being deduced.
+template <typename T>
+struct NonDeduced { using type = T; };
+
+}  // namespace _internal
+
+// A link policy decides how an element stores links to other elements. It
+// provides
+//   template <typename Element> using Link = ...;
+//   static Element* Get(const Element* self, Link<Element> link);
+//   static Link<Element> Make(const Element* self, const Element* target);
+//   template <typename Element> static constexpr size_t MaxArrayLength();
+// where `self` is the element holding the link, and a null target is allowed.
+// `MaxArrayLength<Element>()` is the length up to which any element of an
+// array of `Element`s may link to any other.
+
+// Stores links as pointers.
+struct PointerLinks {
+  template <typename Element>
+  using Link = Element*;
+
+  template <typename Element>
+  static Element* Get(const Element*, Element* link) { return link; }
+  template <typename Element>
+  static Element* Make(const Element*,
+      const typename _internal::NonDeduced<Element>::type* target) {
+    return const_cast<Element*>(target);
+  }
+  template <typename Element>
+  static constexpr size_t MaxArrayLength() {
+    return std::numeric_limits<size_t>::max();
+  }
+};
+
+// Stores a link as the signed 32-bit distance from the element holding it to
+// its target, in units of `alignof(Element)` bytes. This halves the size of a
+// link, but every element must be within 2^31 units (16 GiB for 8-byte aligned
+// elements) of every element it links to. Elements allocated in one array of at
+// most `MaxArrayLength<Element>()` elements, like those of an Euler tour tree,
+// satisfy this. `Make` only checks the distance in debug builds.
+struct CompactLinks {
+  template <typename Element>
+  using Link = int32_t;
+
+  static constexpr int32_t kNull{std::numeric_limits<int32_t>::min()};
+
+  template <typename Element>
+  static Element* Get(const Element* self, int32_t link) {
+    if (link == kNull) {
+      return nullptr;
+    }
+    return reinterpret_cast<Element*>(
+        const_cast<char*>(reinterpret_cast<const char*>(self)) +
+        static_cast<ptrdiff_t>(link) * alignof(Element));
+  }
+  template <typename Element>
+  static int32_t Make(const Element* self,
+      const typename _internal::NonDeduced<Element>::type* target) {
+    if (target == nullptr) {
+      return kNull;
+    }
+    const ptrdiff_t distance{(reinterpret_cast<const char*>(target) -
+        reinterpret_cast<const char*>(self)) /
+        static_cast<ptrdiff_t>(alignof(Element))};
+    assert(distance > kNull && distance <= std::numeric_limits<int32_t>::max());
+    return static_cast<int32_t>(distance);
+  }
+  template <typename Element>
+  static constexpr size_t MaxArrayLength() {
+    return static_cast<size_t>(std::numeric_limits<int32_t>::max()) /
+      (sizeof(Element) / alignof(Element)) + 1;
+  }
+};
+
 // This is the base implementation of a phase-concurrent skip list supporting
 // splits and joins.
 //
@@ -24,21 +109,50 @@ namespace parallel_skip_list {
 // elements. This means that elements must not be created as global or static
 // variables. `Finish()` can be called after we are done with all
 // `ElementBase<Derived>` elements.
-template <typename Derived>
+//
+// Alternatively, the owner of a set of elements can hand each element its
+// neighbor array at construction time. Such elements do not touch the shared
+// allocator at all, so they need neither `Initialize()` nor `Finish()`, and the
+// owner is responsible for freeing the arrays after destroying the elements.
+//
+// Derived classes that keep per-level data of their own may store it in the
+// same block as the neighbor array, right after it, by shadowing
+// `LevelArrayLength()`. Then an element's per-level data takes one allocation
+// instead of several, and walking a level touches one block.
+//
+// `Links` is the link policy (see `PointerLinks` and `CompactLinks`). Elements
+// are not polymorphic, so they must be destroyed through their most-derived
+// type.
+template <typename Derived, typename Links = PointerLinks>
 class ElementBase {
  public:
+  using Link = typename Links::template Link<Derived>;
+  // Aligned so that derived classes can keep 8-byte-aligned per-level data
+  // after the neighbor array.
+  struct alignas(8) Neighbors { Link prev; Link next; };
+
   // Call this before creating any `ElementBase<Derived>` elements.
   static void Initialize();
   // Call this after being done with `ElementBase<Derived>`.
   static void Finish();
 
+  // Returns the height of an element constructed with seed `random_int`.
+  static int HeightFromSeed(size_t random_int);
+  // Returns the length of the block of `Neighbors` that holds the per-level
+  // data of an element of height `height`.
+  static int LevelArrayLength(int height) { return height; }
+
   // Running this concurrently may lead to poor randomness in the height
   // distribution of skip list elements.
   ElementBase();
   // Uses random_int as a seed to generate a random height for the element.
   explicit ElementBase(size_t random_int);
+  // Like `ElementBase(random_int)`, but uses `neighbors`, an array of length
+  // `Derived::LevelArrayLength(HeightFromSeed(random_int))` owned by the
+  // caller, as the element's neighbor array.
+  ElementBase(size_t random_int, Neighbors* neighbors);
 
-  virtual ~ElementBase();
+  ~ElementBase();
   ElementBase(const ElementBase&) = delete;
   ElementBase(ElementBase&&) = delete;
   ElementBase& operator=(const ElementBase&) = delete;
@@ -55,6 +169,34 @@ class ElementBase {
   // call.
   Derived* FindRepresentative() const;
 
+  // Returns `FindRepresentative()` of each element in `elements`, which may
+  // contain duplicates and null pointers (for which it returns null).
+  //
+  // The walks up the skip list are shared. They proceed level by level, and
+  // once several walks reach the same element, only one continues from it.
+  // `key` must map elements to distinct unsigned integers and is used to
+  // deduplicate elements, so small keys, like indices into an array of
+  // elements, are best.
+  //
+  // May run concurrently with other const function calls.
+  template <typename Key>
+  static parlay::sequence<Derived*> BatchFindRepresentative(
+      const parlay::sequence<Derived*>& elements, const Key& key);
+
+  // Links `elements` into cyclic lists in which `successors[i]` follows
+  // `elements[i]`. `successors` must be a permutation of `elements`. Existing
+  // links of the elements are overwritten, so no element outside `elements`
+  // may link to them.
+  //
+  // This builds the same lists as joining each element to its successor, but
+  // it builds them level by level with O(n) expected work. Each element finds
+  // its next element on a level by walking along the level below, which takes
+  // O(1) expected steps.
+  static void BatchBuildCycles(const parlay::sequence<Derived*>& elements,
+      const parlay::sequence<Derived*>& successors) {
+    BatchBuildCycles(elements, successors, [] (Derived*, int) {});
+  }
+
   // Concatenates the list that `left` lives in to the list that `right` lives
   // in. `left` must be the last element in its list. `right` must be the first
   // element in its list. `left` and `right` are allowed to be in the same list,
@@ -74,7 +216,28 @@ class ElementBase {
   Derived* Split();
 
  protected:
-  struct Neighbors { Derived* prev; Derived* next; };
+  // `BatchBuildCycles()` that also calls `on_link(element, level)` right after
+  // linking `element` to its next element on `level` >= 1. At that point all
+  // links on lower levels are built.
+  template <typename OnLink>
+  static void BatchBuildCycles(const parlay::sequence<Derived*>& elements,
+      const parlay::sequence<Derived*>& successors, const OnLink& on_link);
+
+  // Neighbors at level `level`.
+  Derived* GetPrev(int level) const {
+    return Links::Get(Self(), neighbors_[level].prev);
+  }
+  Derived* GetNext(int level) const {
+    return Links::Get(Self(), neighbors_[level].next);
+  }
+  void SetPrev(int level, const Derived* prev) {
+    neighbors_[level].prev = Links::Make(Self(), prev);
+  }
+  void SetNext(int level, const Derived* next) {
+    neighbors_[level].next = Links::Make(Self(), next);
+  }
+  // Sets all neighbors to null.
+  void ClearNeighbors();
 
   bool CASNext(int level, Derived* old_next, Derived* new_next);
   bool CASPrev(int level, Derived* old_prev, Derived* new_prev);
@@ -95,7 +258,14 @@ class ElementBase {
   // neighbors_[i] holds neighbors at level i, where level 0 is the lowest level
   // and is the level at which the list contains all elements
   Neighbors* neighbors_;
-  int height_;
+  uint8_t height_;
+  // Whether `neighbors_` came from `neighbor_allocator_` and should be freed
+  // with the element. The block has length
+  // `Derived::LevelArrayLength(height_)`.
+  bool owns_neighbors_;
+
+ private:
+  const Derived* Self() const { return static_cast<const Derived*>(this); }
 };
 
 ///////////////////////////////////////////////////////////////////////////////
@@ -118,16 +288,48 @@ int GenerateHeight(size_t random_int) {
   return min(h, kMaxHeight);
 }
 
+// Deduplicates the non-null elements of `elements`, using `key` to compare
+// them. Returns the distinct elements and, for each `elements[i]`, its index
+// among the distinct elements, or -1 if it is null.
+template <typename Element, typename Key>
+std::pair<parlay::sequence<Element*>, parlay::sequence<int>> Deduplicate(
+    const parlay::sequence<Element*>& elements, const Key& key) {
+  parlay::sequence<int> order{parlay::pack_index<int>(
+      parlay::delayed_seq<bool>(elements.size(), [&] (size_t i) {
+        return elements[i] != nullptr;
+      }))};
+  parlay::integer_sort_inplace(order, [&] (int i) { return key(elements[i]); });
+  const auto is_first{[&] (size_t j) {
+    return j == 0 || elements[order[j]] != elements[order[j - 1]];
+  }};
+  parlay::sequence<int> ranks = parlay::tabulate(order.size(), [&] (size_t j) {
+    return is_first(j) ? 1 : 0;
+  });
+  const int num_distinct{parlay::scan_inplace(ranks)};
+
+  parlay::sequence<Element*> distinct(num_distinct);
+  parlay::sequence<int> positions(elements.size(), -1);
+  parallel_for (0, order.size(), [&] (size_t j) {
+    const int position{is_first(j) ? ranks[j] : ranks[j] - 1};
+    if (is_first(j)) {
+      distinct[position] = elements[order[j]];
+    }
+    positions[order[j]] = position;
+  });
+  return {std::move(distinct), std::move(positions)};
+}
+
 }  // namespace _internal
 
-template <typename Derived>
-concurrent_array_allocator::Allocator<typename ElementBase<Derived>::Neighbors>*
-    ElementBase<Derived>::neighbor_allocator_{nullptr};
-template <typename Derived>
-pbbs::random ElementBase<Derived>::default_randomness_{};
+template <typename Derived, typename Links>
+concurrent_array_allocator::Allocator<
+    typename ElementBase<Derived, Links>::Neighbors>*
+    ElementBase<Derived, Links>::neighbor_allocator_{nullptr};
+template <typename Derived, typename Links>
+pbbs::random ElementBase<Derived, Links>::default_randomness_{};
 
-template <typename Derived>
-void ElementBase<Derived>::Initialize() {
+template <typename Derived, typename Links>
+void ElementBase<Derived, Links>::Initialize() {
   if (neighbor_allocator_ == nullptr) {
     neighbor_allocator_ =
       new concurrent_array_allocator::Allocator<Neighbors>{};
@@ -135,8 +337,8 @@ void ElementBase<Derived>::Initialize() {
   Derived::DerivedInitialize();
 }
 
-template <typename Derived>
-void ElementBase<Derived>::Finish() {
+template <typename Derived, typename Links>
+void ElementBase<Derived, Links>::Finish() {
   if (neighbor_allocator_ != nullptr) {
     delete neighbor_allocator_;
     neighbor_allocator_ = nullptr;
@@ -144,81 +346,103 @@ void ElementBase<Derived>::Finish() {
   Derived::DerivedFinish();
 }
 
-template <typename Derived>
-ElementBase<Derived>::ElementBase() {
+template <typename Derived, typename Links>
+int ElementBase<Derived, Links>::HeightFromSeed(size_t random_int) {
+  return _internal::GenerateHeight(random_int);
+}
+
+template <typename Derived, typename Links>
+ElementBase<Derived, Links>::ElementBase() : owns_neighbors_{true} {
   size_t random_int{default_randomness_.rand()};
   default_randomness_ = default_randomness_.next();  // race if run concurrently
   height_ = _internal::GenerateHeight(random_int);
-  neighbors_ = neighbor_allocator_->Allocate(height_);
-  for (int i = 0; i < height_; i++) {
-    neighbors_[i].prev = neighbors_[i].next = nullptr;
-  }
+  neighbors_ =
+    neighbor_allocator_->Allocate(Derived::LevelArrayLength(height_));
+  ClearNeighbors();
 }
 
-template <typename Derived>
-ElementBase<Derived>::ElementBase(size_t random_int) {
+template <typename Derived, typename Links>
+ElementBase<Derived, Links>::ElementBase(size_t random_int) : owns_neighbors_{true} {
   height_ = _internal::GenerateHeight(random_int);
-  neighbors_ = neighbor_allocator_->Allocate(height_);
+  neighbors_ =
+    neighbor_allocator_->Allocate(Derived::LevelArrayLength(height_));
+  ClearNeighbors();
+}
+
+template <typename Derived, typename Links>
+ElementBase<Derived, Links>::ElementBase(size_t random_int, Neighbors* neighbors)
+    : neighbors_{neighbors}, owns_neighbors_{false} {
+  height_ = _internal::GenerateHeight(random_int);
+  ClearNeighbors();
+}
+
+template <typename Derived, typename Links>
+void ElementBase<Derived, Links>::ClearNeighbors() {
   for (int i = 0; i < height_; i++) {
-    neighbors_[i].prev = neighbors_[i].next = nullptr;
+    SetPrev(i, nullptr);
+    SetNext(i, nullptr);
   }
 }
 
-template <typename Derived>
-ElementBase<Derived>::~ElementBase() {
-  neighbor_allocator_->Free(neighbors_, height_);
+template <typename Derived, typename Links>
+ElementBase<Derived, Links>::~ElementBase() {
+  if (owns_neighbors_) {
+    neighbor_allocator_->Free(neighbors_, Derived::LevelArrayLength(height_));
+  }
 }
 
-template <typename Derived>
-bool ElementBase<Derived>::CASNext(
+template <typename Derived, typename Links>
+bool ElementBase<Derived, Links>::CASNext(
     int level, Derived* old_next, Derived* new_next) {
-  return CAS(&neighbors_[level].next, old_next, new_next);
+  return CAS(&neighbors_[level].next,
+      Links::Make(Self(), old_next), Links::Make(Self(), new_next));
 }
 
-template <typename Derived>
-bool ElementBase<Derived>::CASPrev(
+template <typename Derived, typename Links>
+bool ElementBase<Derived, Links>::CASPrev(
     int level, Derived* old_prev, Derived* new_prev) {
-  return CAS(&neighbors_[level].prev, old_prev, new_prev);
+  return CAS(&neighbors_[level].prev,
+      Links::Make(Self(), old_prev), Links::Make(Self(), new_prev));
 }
 
-template <typename Derived>
-Derived* ElementBase<Derived>::GetPreviousElement() const {
-  return neighbors_[0].prev;
+template <typename Derived, typename Links>
+Derived* ElementBase<Derived, Links>::GetPreviousElement() const {
+  return GetPrev(0);
 }
 
-template <typename Derived>
-Derived* ElementBase<Derived>::GetNextElement() const {
-  return neighbors_[0].next;
+template <typename Derived, typename Links>
+Derived* ElementBase<Derived, Links>::GetNextElement() const {
+  return GetNext(0);
 }
 
-template <typename Derived>
-Derived* ElementBase<Derived>::FindLeftParent(int level) const {
+template <typename Derived, typename Links>
+Derived* ElementBase<Derived, Links>::FindLeftParent(int level) const {
   const Derived* current_element{static_cast<const Derived*>(this)};
   const Derived* start_element{current_element};
   do {
     if (current_element->height_ > level + 1) {
       return const_cast<Derived*>(current_element);
     }
-    current_element = current_element->neighbors_[level].prev;
+    current_element = current_element->GetPrev(level);
   } while (current_element != nullptr && current_element != start_element);
   return nullptr;
 }
 
-template <typename Derived>
-Derived* ElementBase<Derived>::FindRightParent(int level) const {
+template <typename Derived, typename Links>
+Derived* ElementBase<Derived, Links>::FindRightParent(int level) const {
   const Derived* current_element{static_cast<const Derived*>(this)};
   const Derived* start_element{current_element};
   do {
     if (current_element->height_ > level + 1) {
       return const_cast<Derived*>(current_element);
     }
-    current_element = current_element->neighbors_[level].next;
+    current_element = current_element->GetNext(level);
   } while (current_element != nullptr && current_element != start_element);
   return nullptr;
 }
 
-template <typename Derived>
-Derived* ElementBase<Derived>::FindRepresentative() const {
+template <typename Derived, typename Links>
+Derived* ElementBase<Derived, Links>::FindRepresentative() const {
   // If the list is cyclic, return element on highest level, breaking ties in
   // favor of the lowest address.
   // If the list is not cyclic, then return the head element on the highest
@@ -229,12 +453,12 @@ Derived* ElementBase<Derived>::FindRepresentative() const {
   int current_level{current_element->height_ - 1};
 
   // walk up while moving forward
-  while (current_element->neighbors_[current_level].next != nullptr &&
+  while (current_element->GetNext(current_level) != nullptr &&
     seen_element != current_element) {
     if (seen_element == nullptr || current_element < seen_element) {
       seen_element = current_element;
     }
-    current_element = current_element->neighbors_[current_level].next;
+    current_element = current_element->GetNext(current_level);
     const int top_level{current_element->height_ - 1};
     if (current_level < top_level) {
       current_level = top_level;
@@ -246,19 +470,85 @@ Derived* ElementBase<Derived>::FindRepresentative() const {
     return const_cast<Derived*>(seen_element);
   } else {
     // walk up while moving backward
-    while (current_element->neighbors_[current_level].prev != nullptr) {
-      current_element = current_element->neighbors_[current_level].prev;
+    while (current_element->GetPrev(current_level) != nullptr) {
+      current_element = current_element->GetPrev(current_level);
       current_level = current_element->height_ - 1;
     }
     return const_cast<Derived*>(current_element);
   }
 }
 
-template <typename Derived>
-void ElementBase<Derived>::Join(Derived* left, Derived* right) {
+template <typename Derived, typename Links>
+template <typename Key>
+parlay::sequence<Derived*> ElementBase<Derived, Links>::BatchFindRepresentative(
+    const parlay::sequence<Derived*>& elements, const Key& key) {
+  // `frontiers[l]` holds the distinct elements that the walks reach at level
+  // `l`. `parents[l][i]` is the index in `frontiers[l + 1]` of
+  // `frontiers[l][i]->FindRightParent(l)`, or -1 if `frontiers[l][i]` is on the
+  // top level of its list, in which case we find its representative directly.
+  auto deduplicated{_internal::Deduplicate(elements, key)};
+  const parlay::sequence<int> positions{std::move(deduplicated.second)};
+  std::vector<parlay::sequence<Derived*>> frontiers;
+  std::vector<parlay::sequence<int>> parents;
+  frontiers.push_back(std::move(deduplicated.first));
+  for (int level = 0; !frontiers.back().empty(); level++) {
+    parlay::sequence<Derived*> right_parents = parlay::map(frontiers.back(),
+        [&] (const Derived* element) {
+          return element->FindRightParent(level);
+        });
+    deduplicated = _internal::Deduplicate(right_parents, key);
+    parents.push_back(std::move(deduplicated.second));
+    frontiers.push_back(std::move(deduplicated.first));
+  }
+
+  parlay::sequence<Derived*> representatives;
+  for (int level = static_cast<int>(parents.size()) - 1; level >= 0; level--) {
+    const parlay::sequence<Derived*>& frontier{frontiers[level]};
+    const parlay::sequence<int>& parent{parents[level]};
+    representatives = parlay::tabulate(frontier.size(), [&] (size_t i) {
+      return parent[i] == -1
+        ? frontier[i]->FindRepresentative()
+        : representatives[parent[i]];
+    });
+  }
+  return parlay::tabulate(elements.size(), [&] (size_t i) {
+    return positions[i] == -1 ? nullptr : representatives[positions[i]];
+  });
+}
+
+template <typename Derived, typename Links>
+template <typename OnLink>
+void ElementBase<Derived, Links>::BatchBuildCycles(
+    const parlay::sequence<Derived*>& elements,
+    const parlay::sequence<Derived*>& successors, const OnLink& on_link) {
+  parallel_for (0, elements.size(), [&] (size_t i) {
+    elements[i]->SetNext(0, successors[i]);
+    successors[i]->SetPrev(0, elements[i]);
+  });
+  // `level_elements` holds the elements with a node on level `level`.
+  parlay::sequence<Derived*> level_elements{parlay::filter(elements,
+      [] (const Derived* element) { return element->height_ > 1; })};
+  for (int level = 1; !level_elements.empty(); level++) {
+    parallel_for (0, level_elements.size(), [&] (size_t i) {
+      Derived* element{level_elements[i]};
+      Derived* next{element->GetNext(level - 1)};
+      while (next->height_ <= level) {
+        next = next->GetNext(level - 1);
+      }
+      element->SetNext(level, next);
+      next->SetPrev(level, element);
+      on_link(element, level);
+    });
+    level_elements = parlay::filter(level_elements,
+        [&] (const Derived* element) { return element->height_ > level + 1; });
+  }
+}
+
+template <typename Derived, typename Links>
+void ElementBase<Derived, Links>::Join(Derived* left, Derived* right) {
   int level{0};
   while (left != nullptr && right != nullptr) {
-    if (left->neighbors_[level].next == nullptr &&
+    if (left->GetNext(level) == nullptr &&
       left->CASNext(level, nullptr, right)) {
       // This CAS prevents read-write reordering of these `prev` pointers that
       // might cause concurrent `Join`s to collectively fail to find a link to
@@ -273,8 +563,8 @@ void ElementBase<Derived>::Join(Derived* left, Derived* right) {
   }
 }
 
-template <typename Derived>
-Derived* ElementBase<Derived>::Split() {
+template <typename Derived, typename Links>
+Derived* ElementBase<Derived, Links>::Split() {
   // It's tempting to set `successor = GetNextElement()` here, but we need to
   // wait for the CAS in case multiple `Split` calls are made on the same
   // element.
@@ -282,7 +572,7 @@ Derived* ElementBase<Derived>::Split() {
   Derived* current_element{static_cast<Derived*>(this)};
   int level{0};
   while (current_element != nullptr) {
-    Derived* next{current_element->neighbors_[level].next};
+    Derived* next{current_element->GetNext(level)};
     if (next != nullptr && current_element->CASNext(level, next, nullptr)) {
       if (level == 0) {
         successor = next;
@@ -294,7 +584,7 @@ Derived* ElementBase<Derived>::Split() {
       // path up to the next level when the path has already been cut. This
       // might cause a small amount of extra work, but it's not a correctness
       // issue.
-      next->neighbors_[level].prev = nullptr;
+      next->SetPrev(level, nullptr);
       current_element = current_element->FindLeftParent(level);
       level++;
     } else {
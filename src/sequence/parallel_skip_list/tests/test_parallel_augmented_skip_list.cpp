@@ -53,6 +53,135 @@ void CheckListSize(int idx, parlay::sequence<Element>& elements) {
   assert(true_size == get_size);
 }
 
+// Every element has value 1, so ranks are positions in the list.
+void CheckRankAndSelect(int idx, parlay::sequence<Element>& elements) {
+  const size_t rank{elements[idx].Rank()};
+  assert(Element::Select(&elements[idx], rank) == &elements[idx]);
+  const size_t size = elements[idx].GetSum();
+  if (rank >= size) TRACE(idx _ rank _ size);
+  assert(rank < size);
+  assert(Element::Select(&elements[idx], size) == nullptr);
+  Element* next{elements[idx].GetNextElement()};
+  if (next != nullptr && next->Rank() != 0) {
+    assert(next->Rank() == rank + 1);
+  }
+}
+
+// Every element matches a positive predicate, so searches return the elements
+// in rank order.
+void CheckFind(int idx, parlay::sequence<Element>& elements) {
+  const auto is_positive{[] (int x) { return x > 0; }};
+  parlay::sequence<Element*> found{Element::FindAll(&elements[idx], is_positive)};
+  assert(found.size() == static_cast<size_t>(elements[idx].GetSum()));
+  for (size_t i = 0; i < found.size(); i++) {
+    assert(found[i]->Rank() == i);
+  }
+  assert(Element::FindFirst(&elements[idx], is_positive) == found[0]);
+  assert(Element::FindFirst(&elements[idx], [] (int x) { return x > 1000000; })
+      == nullptr);
+}
+
+// A run of consecutive indices, wrapping around after `NumElements - 1`.
+// Combining runs out of order clears `in_order`, so sums over runs check that
+// values are aggregated in list order.
+struct Run {
+  int first;
+  int last;
+  bool in_order;
+};
+
+struct RunAggregate {
+  Run operator()(const Run& x, const Run& y) const {
+    return {x.first, y.last,
+      x.in_order && y.in_order && (x.last + 1) % NumElements == y.first};
+  }
+  Run Identity() const { return {0, 0, false}; }
+};
+
+using RunElement = parallel_skip_list::AugmentedElement<Run, RunAggregate>;
+
+void CheckRun(const Run& run, int first, int last) {
+  assert(run.in_order);
+  assert(run.first == first);
+  assert(run.last == last);
+}
+
+// Checks sums over the acyclic list of consecutive indices [`first`, `last`]
+// in `elements`.
+void CheckOrderedSums(parlay::sequence<RunElement>& elements, int first, int last) {
+  CheckRun(elements[first].GetSum(), first, last);
+  parallel_for (first, last + 1, [&] (size_t i) {
+    for (int j = i; j <= last; j += 7) {
+      CheckRun(RunElement::GetSubsequenceSum(&elements[i], &elements[j]), i, j);
+    }
+  });
+}
+
+void TestOrderedSums() {
+  RunElement::Initialize();
+  pbbs::random r;
+  parlay::sequence<RunElement> elements = parlay::sequence<RunElement>::from_function(NumElements, [&] (size_t i) {
+    return r.ith_rand(i);
+  });
+  parlay::sequence<RunElement*> updates{parlay::tabulate(NumElements, [&] (size_t i) {
+    return &elements[i];
+  })};
+  parlay::sequence<Run> runs{parlay::tabulate(NumElements, [&] (size_t i) {
+    return Run{static_cast<int>(i), static_cast<int>(i), true};
+  })};
+  RunElement::BatchUpdate(updates, runs);
+
+  pair<RunElement*, RunElement*>* joins{
+    pbbs::new_array_no_init<pair<RunElement*, RunElement*>>(NumElements)};
+  parallel_for (0, NumElements - 1, [&] (size_t i) {
+    joins[i] = make_pair(&elements[i], &elements[i + 1]);
+  });
+  RunElement::BatchJoin(joins, NumElements - 1);
+  CheckOrderedSums(elements, 0, NumElements - 1);
+  // An acyclic list is summed from an element as if it were a cycle.
+  parlay::sequence<Run> sums{RunElement::BatchGetSumFromHere(updates)};
+  parallel_for (0, NumElements, [&] (size_t i) {
+    CheckRun(sums[i], i, (i + NumElements - 1) % NumElements);
+  });
+
+  joins[0] = make_pair(&elements[NumElements - 1], &elements[0]);
+  RunElement::BatchJoin(joins, 1);
+  // A cycle is summed from its representative, and subsequences of it may wrap
+  // around.
+  const int representative{static_cast<int>(
+      elements[0].FindRepresentative() - elements.begin())};
+  CheckRun(elements[0].GetSum(),
+      representative, (representative + NumElements - 1) % NumElements);
+  parallel_for (0, NumElements, [&] (size_t i) {
+    for (int j = i % 7; j < NumElements; j += 7) {
+      CheckRun(RunElement::GetSubsequenceSum(&elements[i], &elements[j]), i, j);
+    }
+  });
+  sums = RunElement::BatchGetSumFromHere(updates);
+  parallel_for (0, NumElements, [&] (size_t i) {
+    CheckRun(sums[i], i, (i + NumElements - 1) % NumElements);
+  });
+
+  // Split the cycle into lists at prime indices.
+  RunElement** splits{pbbs::new_array_no_init<RunElement*>(NumElements)};
+  int len{0};
+  for (int i = 0; i < NumElements; i++) {
+    if (split_points[i]) {
+      splits[len++] = &elements[i];
+    }
+  }
+  RunElement::BatchSplit(splits, len);
+  for (int i = 0; i < NumElements; i++) {
+    if (split_points[i] && start_index_of_list[i] <= i) {
+      CheckOrderedSums(elements, start_index_of_list[i], i);
+    }
+  }
+
+  pbbs::delete_array(joins, NumElements);
+  pbbs::delete_array(splits, NumElements);
+  RunElement::Finish();
+}
+
 int main() {
   Element::Initialize();
   Element::aggregate_function = [&] (int x, int y) { return x + y; };
@@ -80,7 +209,10 @@ int main() {
       assert(representative_i != elements[j].FindRepresentative());
     }
     CheckListSize(i, elements);
+    CheckRankAndSelect(i, elements);
   });
+  CheckFind(0, elements);
+  CheckFind(NumElements - 1, elements);
 
   ElementPPair* joins{pbbs::new_array_no_init<ElementPPair>(NumElements)};
   Element** splits{pbbs::new_array_no_init<Element*>(NumElements)};
@@ -95,6 +227,8 @@ int main() {
   parallel_for (0, NumElements, [&] (size_t i) {
     assert(representative_0 == elements[i].FindRepresentative());
     CheckListSize(i, elements);
+    assert(elements[i].Rank() == i);
+    assert(Element::Select(&elements[0], i) == &elements[i]);
   });
 
   // Join into one big cycle
@@ -105,7 +239,10 @@ int main() {
   parallel_for (0, NumElements, [&] (size_t i) {
     assert(representative_0 == elements[i].FindRepresentative());
     CheckListSize(i, elements);
+    CheckRankAndSelect(i, elements);
   });
+  CheckFind(0, elements);
+  CheckFind(NumElements - 1, elements);
 
   // Split into lists
   int len{0};
@@ -125,7 +262,10 @@ int main() {
           elements[i].FindRepresentative());
     }
     CheckListSize(i, elements);
+    CheckRankAndSelect(i, elements);
   });
+  CheckFind(0, elements);
+  CheckFind(NumElements - 1, elements);
 
   // Join individual lists into individual cycles
   len = 0;
@@ -145,7 +285,10 @@ int main() {
           elements[i].FindRepresentative());
     }
     CheckListSize(i, elements);
+    CheckRankAndSelect(i, elements);
   });
+  CheckFind(0, elements);
+  CheckFind(NumElements - 1, elements);
 
   // Break cycles back into lists
   Element::BatchSplit(splits, len);
@@ -163,12 +306,17 @@ int main() {
   parallel_for (0, NumElements, [&] (size_t i) {
     assert(representative_0 == elements[i].FindRepresentative());
     CheckListSize(i, elements);
+    CheckRankAndSelect(i, elements);
   });
+  CheckFind(0, elements);
+  CheckFind(NumElements - 1, elements);
 
   pbbs::delete_array(joins, NumElements);
   pbbs::delete_array(splits, NumElements);
   Element::Finish();
 
+  TestOrderedSums();
+
   cout << "Test complete." << endl;
 
   return 0;
@@ -66,6 +66,41 @@ public:
       }
     }
 
+  // Not concurrent with other operations. Moves the live entries into a new
+  // table of `new_capacity` slots, which must be a power of two greater than
+  // the number of live entries. This drops all tombstones.
+  inline void rebuild(size_t new_capacity) {
+    KV* old_table = table;
+    size_t old_capacity = capacity;
+    bool old_alloc = alloc;
+    capacity = new_capacity;
+    mask = capacity-1;
+    table = alloc_table(capacity);
+    alloc = true;
+    parlay::parallel_for(0, old_capacity, [&] (size_t i) {
+      K t_k = get<0>(old_table[i]);
+      if (t_k != empty_key && t_k != tombstone) {
+        insert(t_k, get<1>(old_table[i]));
+      }
+    });
+    if (old_alloc) {
+      free(old_table);
+    }
+    n_tombstones = 0;
+  }
+
+  inline bool is_live(size_t i) const {
+    K t_k = get<0>(table[i]);
+    return t_k != empty_key && t_k != tombstone;
+  }
+  inline bool is_tombstone(size_t i) const {
+    return get<0>(table[i]) == tombstone;
+  }
+  // Number of slots that `find` probes to reach the live entry in slot `i`.
+  inline size_t probe_length(size_t i) const {
+    return toRange(i - firstIndex(get<0>(table[i]))) + 1;
+  }
+
   inline maybe<V> find(K k) const {
     size_t h = firstIndex(k);
     while(1) {
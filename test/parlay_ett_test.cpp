@@ -1,4 +1,15 @@
 #include <gtest/gtest.h>
+#include <algorithm>
+#include <atomic>
+#include <functional>
+#include <future>
+#include <limits>
+#include <random>
+#include <set>
+#include <thread>
+#include <type_traits>
+#include <vector>
+#include "dynamic_trees/parallel_euler_tour_tree/include/concurrent_front_end.hpp"
 #include "dynamic_trees/parallel_euler_tour_tree/include/euler_tour_tree.hpp"
 #include "dynamic_trees/parallel_euler_tour_tree/include/unaugmented_euler_tour_tree.hpp"
 
@@ -44,3 +55,1557 @@ TEST(ParlaySuite, mini_aggregate_test) {
         ASSERT_EQ(tree.vertices_[0].GetSum(), 1) << "INCORRECT AGGREGATE AFTER BATCH CUT." << std::endl;
     }
 }
+
+TEST(ParlaySuite, element_reuse_test) {
+    int n = 1000;
+    int k = n-1;
+    int num_rounds = 20;
+
+    using EulerTourTree = parallel_euler_tour_tree::EulerTourTree<int>;
+    parallel_skip_list::AugmentedElement<int>::default_value = 1;
+    parallel_skip_list::AugmentedElement<int>::aggregate_function = [] (int x, int y) { return x+y; };
+
+    // Every round uses all 2n-2 pooled edge elements, so elements are recycled
+    // both through the batch and the sequential link/cut paths.
+    EulerTourTree tree(n);
+    parlay::sequence<std::pair<int,int>> path(k);
+    parlay::sequence<std::pair<int,int>> star(k);
+    for (int i = 0; i < k; i++) {
+        path[i] = {i,i+1};
+        star[i] = {0,i+1};
+    }
+    for (int round = 0; round < num_rounds; round++) {
+        auto& links = round % 2 == 0 ? path : star;
+        tree.BatchLink(links);
+        ASSERT_EQ(tree.vertices_[n-1].GetSum(), n + 2*k);
+        ASSERT_TRUE(tree.IsConnected(0, n-1));
+        tree.BatchCut(links);
+        ASSERT_EQ(tree.vertices_[n-1].GetSum(), 1);
+        ASSERT_FALSE(tree.IsConnected(0, n-1));
+        for (int i = 0; i < 10; i++)
+            tree.Link(links[i].first, links[i].second);
+        ASSERT_EQ(tree.vertices_[0].GetSum(), 11 + 2*10);
+        for (int i = 0; i < 10; i++)
+            tree.Cut(links[i].first, links[i].second);
+        ASSERT_EQ(tree.vertices_[0].GetSum(), 1);
+    }
+}
+
+TEST(ParlaySuite, independent_augmentation_test) {
+    int n = 1000;
+    int k = n-1;
+
+    using EulerTourTree = parallel_euler_tour_tree::EulerTourTree<int>;
+    parallel_skip_list::Augmentation<int> count{[] (int x, int y) { return x+y; }, 1};
+    parallel_skip_list::Augmentation<int> max{[] (int x, int y) { return std::max(x,y); }, 0};
+
+    parlay::sequence<std::pair<int,int>> links(k);
+    for (int i = 0; i < k; i++)
+        links[i] = {i,i+1};
+    // Trees with different augmentations of the same type must not share state,
+    // including when one is destroyed while the other is still in use.
+    EulerTourTree count_tree(n, 1, count);
+    {
+        EulerTourTree max_tree(n, 2, max);
+        count_tree.BatchLink(links);
+        max_tree.BatchLink(links);
+        max_tree.Update(n/2, 7);
+        ASSERT_EQ(count_tree.vertices_[0].GetSum(), n + 2*k);
+        ASSERT_EQ(max_tree.vertices_[0].GetSum(), 7);
+        max_tree.BatchCut(links);
+        ASSERT_EQ(max_tree.vertices_[0].GetSum(), 0);
+    }
+    ASSERT_EQ(count_tree.vertices_[n-1].GetSum(), n + 2*k);
+    count_tree.BatchCut(links);
+    ASSERT_EQ(count_tree.vertices_[n-1].GetSum(), 1);
+}
+
+TEST(ParlaySuite, static_aggregate_test) {
+    int n = 1000;
+    int k = n-1;
+
+    using MinTree = parallel_euler_tour_tree::EulerTourTree<int, parallel_skip_list::MinAggregate<int>>;
+    using OrTree = parallel_euler_tour_tree::EulerTourTree<unsigned, parallel_skip_list::OrAggregate<unsigned>>;
+    static_assert(parallel_skip_list::MinAggregate<int>{}(3, 5) == 3);
+    static_assert(parallel_skip_list::MaxAggregate<int>{}.Identity() == std::numeric_limits<int>::lowest());
+
+    parlay::sequence<std::pair<int,int>> links(k);
+    for (int i = 0; i < k; i++)
+        links[i] = {i,i+1};
+    MinTree min_tree(n);
+    OrTree or_tree(n);
+    for (int i = 0; i < n; i++) {
+        min_tree.Update(i, n - i);
+        or_tree.Update(i, 1u << (i % 32));
+    }
+    min_tree.BatchLink(links);
+    or_tree.BatchLink(links);
+    ASSERT_EQ(min_tree.vertices_[0].GetSum(), 1);
+    ASSERT_EQ(or_tree.vertices_[0].GetSum(), ~0u);
+    min_tree.BatchCut(links);
+    or_tree.BatchCut(links);
+    ASSERT_EQ(min_tree.vertices_[0].GetSum(), n);
+    ASSERT_EQ(min_tree.vertices_[n-1].GetSum(), 1);
+    ASSERT_EQ(or_tree.vertices_[33].GetSum(), 2u);
+}
+
+TEST(ParlaySuite, compact_links_test) {
+    int n = 3000;
+    int num_rounds = 10;
+    std::mt19937 generator(0);
+
+    using parallel_skip_list::CompactLinks;
+    using parallel_skip_list::SumAggregate;
+    using CompactTree = parallel_euler_tour_tree::EulerTourTree<int, SumAggregate<int>, CompactLinks>;
+    using PointerTree = parallel_euler_tour_tree::EulerTourTree<int, SumAggregate<int>>;
+
+    // The compact trees must behave exactly like the pointer-based tree.
+    CompactTree compact_tree(n);
+    PointerTree pointer_tree(n);
+    parallel_euler_tour_tree::CompactUnaugmentedEulerTourTree unaugmented_tree(n);
+    for (int i = 0; i < n; i++) {
+        compact_tree.Update(i, i);
+        pointer_tree.Update(i, i);
+    }
+    for (int round = 0; round < num_rounds; round++) {
+        parlay::sequence<std::pair<int,int>> links;
+        for (int i = 1; i < n; i++)
+            if (generator() % 3 != 0)
+                links.push_back({static_cast<int>(generator() % i), i});
+        compact_tree.BatchLink(links);
+        pointer_tree.BatchLink(links);
+        unaugmented_tree.BatchLink(links);
+        for (int q = 0; q < 1000; q++) {
+            int u = generator() % n;
+            int v = generator() % n;
+            ASSERT_EQ(compact_tree.IsConnected(u, v), pointer_tree.IsConnected(u, v));
+            ASSERT_EQ(unaugmented_tree.IsConnected(u, v), pointer_tree.IsConnected(u, v));
+            ASSERT_EQ(compact_tree.vertices_[u].GetSum(), pointer_tree.vertices_[u].GetSum());
+        }
+        compact_tree.BatchCut(links);
+        pointer_tree.BatchCut(links);
+        unaugmented_tree.BatchCut(links);
+        for (int i = 0; i < n; i++) {
+            ASSERT_EQ(compact_tree.vertices_[i].GetSum(), i);
+            ASSERT_EQ(unaugmented_tree.IsConnected(0, i), i == 0);
+        }
+    }
+}
+
+TEST(ParlaySuite, batch_connectivity_test) {
+    int n = 3000;
+    int num_rounds = 10;
+    int num_queries = 5000;
+    std::mt19937 generator(0);
+
+    using parallel_skip_list::CompactLinks;
+    using CompactTree = parallel_euler_tour_tree::EulerTourTree<int, parallel_skip_list::Augmentation<int>, CompactLinks>;
+
+    parallel_euler_tour_tree::EulerTourTree<int> tree(n);
+    CompactTree compact_tree(n);
+    parallel_euler_tour_tree::UnaugmentedEulerTourTree unaugmented_tree(n);
+    for (int round = 0; round < num_rounds; round++) {
+        parlay::sequence<std::pair<int,int>> links;
+        for (int i = 1; i < n; i++)
+            if (generator() % 4 != 0)
+                links.push_back({static_cast<int>(generator() % i), i});
+        tree.BatchLink(links);
+        compact_tree.BatchLink(links);
+        unaugmented_tree.BatchLink(links);
+
+        // Queries repeat vertices so that the batch has duplicates to share.
+        parlay::sequence<std::pair<int,int>> queries(num_queries);
+        for (int q = 0; q < num_queries; q++)
+            queries[q] = {static_cast<int>(generator() % (n / 10)), static_cast<int>(generator() % n)};
+        parlay::sequence<bool> connected = tree.BatchIsConnected(queries);
+        parlay::sequence<bool> compact_connected = compact_tree.BatchIsConnected(queries);
+        parlay::sequence<bool> unaugmented_connected = unaugmented_tree.BatchIsConnected(queries);
+        ASSERT_EQ(connected.size(), num_queries);
+        for (int q = 0; q < num_queries; q++) {
+            bool expected = tree.IsConnected(queries[q].first, queries[q].second);
+            ASSERT_EQ(connected[q], expected);
+            ASSERT_EQ(compact_connected[q], expected);
+            ASSERT_EQ(unaugmented_connected[q], expected);
+        }
+
+        parlay::sequence<int> vertices(n);
+        for (int i = 0; i < n; i++) vertices[i] = i;
+        parlay::sequence<size_t> representatives = unaugmented_tree.BatchFindRepresentative(vertices);
+        for (int i = 0; i < n; i++)
+            ASSERT_EQ(representatives[i] == representatives[0], unaugmented_tree.IsConnected(0, i));
+
+        tree.BatchCut(links);
+        compact_tree.BatchCut(links);
+        unaugmented_tree.BatchCut(links);
+    }
+    ASSERT_TRUE(tree.BatchIsConnected(parlay::sequence<std::pair<int,int>>()).empty());
+}
+
+TEST(ParlaySuite, component_id_cache_test) {
+    int n = 2000;
+    int num_rounds = 20;
+    std::mt19937 generator(0);
+
+    // The cached tree must answer every query like the uncached one, whether
+    // or not its cache has been refreshed since the last update.
+    parallel_euler_tour_tree::EulerTourTree<int> tree(n);
+    parallel_euler_tour_tree::EulerTourTree<int> cached_tree(n);
+    parallel_euler_tour_tree::UnaugmentedEulerTourTree cached_unaugmented_tree(n);
+    cached_tree.CacheComponentIds();
+    cached_unaugmented_tree.CacheComponentIds();
+    std::vector<std::pair<int,int>> forest_edges;
+    for (int round = 0; round < num_rounds; round++) {
+        // Alternate between small updates, which go through `Link`/`Cut`, and
+        // large ones, which go through the parallel batch algorithms.
+        size_t batch_size = round % 2 == 0 ? 10 : 500;
+        parlay::sequence<std::pair<int,int>> cuts;
+        std::shuffle(forest_edges.begin(), forest_edges.end(), generator);
+        while (!forest_edges.empty() && cuts.size() < batch_size) {
+            cuts.push_back(forest_edges.back());
+            forest_edges.pop_back();
+        }
+        tree.BatchCut(cuts);
+        cached_tree.BatchCut(cuts);
+        cached_unaugmented_tree.BatchCut(cuts);
+
+        parlay::sequence<std::pair<int,int>> links;
+        for (size_t i = 0; i < 2 * batch_size; i++) {
+            int u = generator() % n;
+            int v = generator() % n;
+            // Link one at a time on the reference tree to keep the batch
+            // acyclic.
+            if (tree.IsConnected(u, v)) continue;
+            tree.Link(u, v);
+            links.push_back({u, v});
+            forest_edges.push_back({u, v});
+        }
+        cached_tree.BatchLink(links);
+        cached_unaugmented_tree.BatchLink(links);
+
+        if (round % 3 != 2) {
+            cached_tree.CacheComponentIds();
+            cached_unaugmented_tree.CacheComponentIds();
+        }
+        parlay::sequence<std::pair<int,int>> queries(2000);
+        for (auto& query : queries)
+            query = {static_cast<int>(generator() % n), static_cast<int>(generator() % n)};
+        parlay::sequence<bool> batch_connected = cached_tree.BatchIsConnected(queries);
+        for (size_t q = 0; q < queries.size(); q++) {
+            bool expected = tree.IsConnected(queries[q].first, queries[q].second);
+            ASSERT_EQ(cached_tree.IsConnected(queries[q].first, queries[q].second), expected);
+            ASSERT_EQ(cached_unaugmented_tree.IsConnected(queries[q].first, queries[q].second), expected);
+            ASSERT_EQ(batch_connected[q], expected);
+        }
+    }
+}
+
+TEST(ParlaySuite, build_from_forest_test) {
+    int n = 5000;
+    std::mt19937 generator(0);
+
+    using parallel_skip_list::SumAggregate;
+    using Tree = parallel_euler_tour_tree::EulerTourTree<int, SumAggregate<int>>;
+    using CompactTree = parallel_euler_tour_tree::EulerTourTree<int, SumAggregate<int>, parallel_skip_list::CompactLinks>;
+
+    parlay::sequence<std::pair<int,int>> edges;
+    for (int i = 1; i < n; i++)
+        if (generator() % 10 != 0)
+            edges.push_back({i, static_cast<int>(generator() % i)});
+    std::shuffle(edges.begin(), edges.end(), generator);
+
+    Tree linked_tree(n);
+    Tree built_tree(n);
+    CompactTree compact_tree(n);
+    parallel_euler_tour_tree::UnaugmentedEulerTourTree unaugmented_tree(n);
+    for (int i = 0; i < n; i++) {
+        linked_tree.Update(i, i);
+        built_tree.Update(i, i);
+        compact_tree.Update(i, i);
+    }
+    linked_tree.BatchLink(edges);
+    built_tree.BuildFromForest(edges);
+    compact_tree.BuildFromForest(edges);
+    unaugmented_tree.BuildFromForest(edges);
+
+    auto check = [&] () {
+        for (int q = 0; q < 5000; q++) {
+            int u = generator() % n;
+            int v = generator() % n;
+            bool expected = linked_tree.IsConnected(u, v);
+            ASSERT_EQ(built_tree.IsConnected(u, v), expected);
+            ASSERT_EQ(compact_tree.IsConnected(u, v), expected);
+            ASSERT_EQ(unaugmented_tree.IsConnected(u, v), expected);
+            ASSERT_EQ(built_tree.vertices_[u].GetSum(), linked_tree.vertices_[u].GetSum());
+            ASSERT_EQ(compact_tree.vertices_[u].GetSum(), linked_tree.vertices_[u].GetSum());
+        }
+    };
+    check();
+
+    // The built tours must support further updates.
+    parlay::sequence<std::pair<int,int>> cuts(edges.begin(), edges.begin() + edges.size() / 2);
+    linked_tree.BatchCut(cuts);
+    built_tree.BatchCut(cuts);
+    compact_tree.BatchCut(cuts);
+    unaugmented_tree.BatchCut(cuts);
+    check();
+    for (int i = 0; i < 10; i++) {
+        linked_tree.Cut(edges.back().first, edges.back().second);
+        built_tree.Cut(edges.back().first, edges.back().second);
+        unaugmented_tree.Cut(edges.back().first, edges.back().second);
+        compact_tree.Cut(edges.back().first, edges.back().second);
+        edges.pop_back();
+    }
+    linked_tree.BatchLink(cuts);
+    built_tree.BatchLink(cuts);
+    compact_tree.BatchLink(cuts);
+    unaugmented_tree.BatchLink(cuts);
+    check();
+
+    parlay::sequence<std::pair<int,int>> remaining(edges.begin(), edges.end());
+    built_tree.BatchCut(remaining);
+    for (int i = 0; i < n; i++)
+        ASSERT_EQ(built_tree.vertices_[i].GetSum(), i);
+}
+
+TEST(ParlaySuite, edge_map_churn_test) {
+    int n = 2000;
+    int num_rounds = 300;
+    std::mt19937 generator(0);
+
+    // Repeatedly cut and link edges of a spanning tree. Each round leaves
+    // tombstones behind, which the edge map must clean up to stay short.
+    parallel_euler_tour_tree::EulerTourTree<int> tree(n);
+    parallel_euler_tour_tree::UnaugmentedEulerTourTree unaugmented_tree(n);
+    std::vector<int> parent(n);
+    parlay::sequence<std::pair<int,int>> edges;
+    for (int i = 1; i < n; i++) {
+        parent[i] = generator() % i;
+        edges.push_back({i, parent[i]});
+    }
+    tree.BatchLink(edges);
+    unaugmented_tree.BatchLink(edges);
+    for (int round = 0; round < num_rounds; round++) {
+        // Rewire some vertices to a new parent with a smaller index, using both
+        // the batch and the single-edge paths.
+        size_t batch_size = round % 2 == 0 ? 20 : 300;
+        parlay::sequence<std::pair<int,int>> cuts, links;
+        std::vector<bool> chosen(n, false);
+        while (cuts.size() < batch_size) {
+            int v = 1 + generator() % (n - 1);
+            if (chosen[v]) continue;
+            chosen[v] = true;
+            cuts.push_back({v, parent[v]});
+            parent[v] = generator() % v;
+            links.push_back({parent[v], v});
+        }
+        tree.BatchCut(cuts);
+        tree.BatchLink(links);
+        unaugmented_tree.BatchCut(cuts);
+        unaugmented_tree.BatchLink(links);
+
+        for (auto stats : {tree.GetEdgeMapStats(), unaugmented_tree.GetEdgeMapStats()}) {
+            ASSERT_EQ(stats.num_edges, n - 1);
+            ASSERT_LE(stats.num_edges + stats.num_tombstones, 0.75 * stats.capacity);
+            ASSERT_LE(stats.capacity, 8 * n);
+            ASSERT_LT(stats.mean_probe_length, 4.0);
+        }
+    }
+    for (int q = 0; q < 1000; q++)
+        ASSERT_TRUE(tree.IsConnected(0, generator() % n));
+    for (int v = 1; v < n; v++)
+        tree.Cut(v, parent[v]);
+    parallel_euler_tour_tree::EdgeMapStats stats = tree.GetEdgeMapStats();
+    ASSERT_EQ(stats.num_edges, 0);
+    ASSERT_LE(stats.num_tombstones, 0.75 * stats.capacity);
+}
+
+TEST(ParlaySuite, adjacency_edges_test) {
+    int n = 2000;
+    int num_rounds = 100;
+    std::mt19937 generator(0);
+
+    // Half of the vertices hang off vertex 0, so its edge list is long and
+    // lookups between it and other busy vertices scan far.
+    using parallel_euler_tour_tree::AdjacencyEdges;
+    parallel_euler_tour_tree::EulerTourTree<int> hash_tree(n);
+    parallel_euler_tour_tree::EulerTourTree<int,
+        parallel_skip_list::Augmentation<int>, parallel_skip_list::PointerLinks,
+        AdjacencyEdges> tree(n);
+    parallel_euler_tour_tree::BasicUnaugmentedEulerTourTree<
+        parallel_skip_list::PointerLinks, AdjacencyEdges> unaugmented_tree(n);
+    auto pick_parent = [&] (int v) {
+        return generator() % 2 == 0 ? 0 : static_cast<int>(generator() % v);
+    };
+    std::vector<int> parent(n, -1);
+    parlay::sequence<std::pair<int,int>> edges;
+    for (int i = 1; i < n; i++) {
+        if (generator() % 10 == 0) continue;
+        parent[i] = pick_parent(i);
+        edges.push_back({i, parent[i]});
+    }
+    hash_tree.BatchLink(edges);
+    tree.BuildFromForest(edges);
+    unaugmented_tree.BatchLink(edges);
+    for (int round = 0; round < num_rounds; round++) {
+        size_t batch_size = round % 2 == 0 ? 10 : 400;
+        parlay::sequence<std::pair<int,int>> cuts, links;
+        std::vector<bool> chosen(n, false);
+        while (cuts.size() < batch_size) {
+            int v = 1 + generator() % (n - 1);
+            if (chosen[v] || parent[v] == -1) continue;
+            chosen[v] = true;
+            cuts.push_back({parent[v], v});
+            parent[v] = pick_parent(v);
+            links.push_back({v, parent[v]});
+        }
+        if (round % 10 == 0) {
+            for (auto [u, v] : cuts) {
+                tree.Cut(u, v);
+                unaugmented_tree.Cut(v, u);
+            }
+            for (auto [u, v] : links) {
+                tree.Link(u, v);
+                unaugmented_tree.Link(v, u);
+            }
+        } else {
+            tree.BatchCut(cuts);
+            tree.BatchLink(links);
+            unaugmented_tree.BatchCut(cuts);
+            unaugmented_tree.BatchLink(links);
+        }
+        hash_tree.BatchCut(cuts);
+        hash_tree.BatchLink(links);
+
+        for (auto stats : {tree.GetEdgeMapStats(), unaugmented_tree.GetEdgeMapStats()}) {
+            ASSERT_EQ(stats.num_edges, edges.size());
+            ASSERT_EQ(stats.num_tombstones, 0);
+            ASSERT_GE(stats.mean_probe_length, 1.0);
+        }
+        parlay::sequence<std::pair<int,int>> queries;
+        for (int q = 0; q < 200; q++)
+            queries.push_back({static_cast<int>(generator() % n), static_cast<int>(generator() % n)});
+        ASSERT_EQ(tree.BatchIsConnected(queries), hash_tree.BatchIsConnected(queries));
+        ASSERT_EQ(unaugmented_tree.BatchIsConnected(queries), hash_tree.BatchIsConnected(queries));
+    }
+    for (int v = 1; v < n; v++) {
+        if (parent[v] == -1) continue;
+        tree.Cut(v, parent[v]);
+        unaugmented_tree.Cut(parent[v], v);
+    }
+    ASSERT_EQ(tree.GetEdgeMapStats().num_edges, 0);
+    ASSERT_EQ(unaugmented_tree.GetEdgeMapStats().num_edges, 0);
+    for (int q = 0; q < 100; q++) {
+        int u = 1 + generator() % (n - 1);
+        ASSERT_FALSE(tree.IsConnected(0, u));
+        ASSERT_FALSE(unaugmented_tree.IsConnected(0, u));
+    }
+}
+
+TEST(ParlaySuite, component_aggregate_test) {
+    int n = 3000;
+    std::mt19937 generator(0);
+
+    // A random forest whose vertex values are their weights. Track each
+    // vertex's tree through a parent array to compute the expected sums.
+    parallel_euler_tour_tree::EulerTourTree<int, parallel_skip_list::SumAggregate<int>> tree(n);
+    std::vector<int> parent(n, -1), weight(n);
+    parlay::sequence<std::pair<int,int>> edges;
+    for (int i = 0; i < n; i++) {
+        weight[i] = generator() % 100;
+        tree.Update(i, weight[i]);
+        if (i > 0 && generator() % 20 != 0) {
+            parent[i] = generator() % i;
+            edges.push_back({i, parent[i]});
+        }
+    }
+    tree.BatchLink(edges);
+    auto root = [&] (int v) {
+        while (parent[v] != -1) v = parent[v];
+        return v;
+    };
+    std::vector<int> expected(n, 0);
+    for (int v = 0; v < n; v++)
+        expected[root(v)] += weight[v];
+
+    parlay::sequence<int> queries;
+    for (int q = 0; q < 5000; q++)
+        queries.push_back(generator() % n);
+    for (int pass = 0; pass < 2; pass++) {
+        parlay::sequence<int> sums = tree.BatchComponentAggregate(queries);
+        ASSERT_EQ(sums.size(), queries.size());
+        for (size_t q = 0; q < queries.size(); q++) {
+            ASSERT_EQ(sums[q], expected[root(queries[q])]);
+            ASSERT_EQ(tree.ComponentAggregate(queries[q]), sums[q]);
+        }
+        tree.CacheComponentIds();
+    }
+    ASSERT_TRUE(tree.BatchComponentAggregate(parlay::sequence<int>()).empty());
+}
+
+TEST(ParlaySuite, subtree_aggregate_test) {
+    int n = 2000;
+    std::mt19937 generator(0);
+
+    // A random tree rooted at 0 with vertex weights. Subtree sums relative to
+    // the root are computed bottom-up since parents have smaller indices.
+    parallel_euler_tour_tree::EulerTourTree<int, parallel_skip_list::SumAggregate<int>> tree(n);
+    std::vector<int> parent(n, -1), weight(n), subtree(n);
+    parlay::sequence<std::pair<int,int>> edges;
+    int total = 0;
+    for (int i = 0; i < n; i++) {
+        weight[i] = generator() % 100;
+        total += weight[i];
+        tree.Update(i, weight[i]);
+        if (i > 0) {
+            parent[i] = generator() % i;
+            edges.push_back({parent[i], i});
+        }
+    }
+    tree.BatchLink(edges);
+    for (int i = n - 1; i >= 0; i--) {
+        subtree[i] += weight[i];
+        if (i > 0) subtree[parent[i]] += subtree[i];
+    }
+
+    // Querying across an edge in the other direction gives the rest of the
+    // tree, as if it were rooted inside v's subtree instead.
+    parlay::sequence<std::pair<int,int>> queries;
+    std::vector<int> expected;
+    for (int q = 0; q < 3000; q++) {
+        int v = 1 + generator() % (n - 1);
+        if (q % 2 == 0) {
+            queries.push_back({v, parent[v]});
+            expected.push_back(subtree[v]);
+        } else {
+            queries.push_back({parent[v], v});
+            expected.push_back(total - subtree[v]);
+        }
+    }
+    parlay::sequence<int> sums = tree.BatchSubtreeAggregate(queries);
+    for (size_t q = 0; q < queries.size(); q++) {
+        ASSERT_EQ(sums[q], expected[q]);
+        ASSERT_EQ(tree.SubtreeAggregate(queries[q].first, queries[q].second), expected[q]);
+    }
+    ASSERT_EQ(tree.SubtreeAggregate(1, parent[1]) +
+              tree.SubtreeAggregate(parent[1], 1), total);
+}
+
+TEST(ParlaySuite, rank_select_test) {
+    int n = 2000;
+    std::mt19937 generator(0);
+
+    // Every vertex has value 1 and edges have 0, so tour positions count
+    // vertices.
+    parallel_euler_tour_tree::EulerTourTree<int, parallel_skip_list::SumAggregate<int>> tree(n);
+    std::vector<int> parent(n, -1);
+    parlay::sequence<std::pair<int,int>> edges;
+    for (int i = 0; i < n; i++) {
+        tree.Update(i, 1);
+        if (i > 0 && generator() % 50 != 0) {
+            parent[i] = generator() % i;
+            edges.push_back({i, parent[i]});
+        }
+    }
+    tree.BatchLink(edges);
+    auto root = [&] (int v) {
+        while (parent[v] != -1) v = parent[v];
+        return v;
+    };
+    std::vector<int> size(n, 0);
+    for (int v = 0; v < n; v++)
+        size[root(v)]++;
+
+    // Walking each tour by position visits every vertex of its tree once, in
+    // rank order.
+    std::vector<bool> seen(n, false);
+    parlay::sequence<std::pair<int, size_t>> queries;
+    for (int r = 0; r < n; r++) {
+        if (parent[r] != -1) continue;
+        ASSERT_EQ(tree.KthVertexInTour(r, size[r]), -1);
+        for (int k = 0; k < size[r]; k++)
+            queries.push_back({r, k});
+    }
+    parlay::sequence<int> kth = tree.BatchKthVertexInTour(queries);
+    for (size_t q = 0; q < queries.size(); q++) {
+        int v = kth[q];
+        ASSERT_EQ(root(v), queries[q].first);
+        ASSERT_FALSE(seen[v]);
+        seen[v] = true;
+        ASSERT_EQ(tree.RankInTour(v), queries[q].second);
+        ASSERT_EQ(tree.KthVertexInTour(v, queries[q].second), v);
+    }
+
+    // Consecutive random integers sample every vertex of a tree once.
+    int r = root(n - 1);
+    std::vector<int> hits(n, 0);
+    for (int i = 0; i < size[r]; i++)
+        hits[tree.SampleVertexInComponent(n - 1, i)]++;
+    for (int v = 0; v < n; v++)
+        ASSERT_EQ(hits[v], root(v) == r ? 1 : 0);
+
+    tree.BatchCut(edges);
+    for (int v = 0; v < n; v++) {
+        ASSERT_EQ(tree.RankInTour(v), 0);
+        ASSERT_EQ(tree.SampleVertexInComponent(v, generator()), v);
+    }
+}
+
+TEST(ParlaySuite, find_flagged_vertices_test) {
+    int n = 3000;
+    std::mt19937 generator(0);
+
+    // Flag a few vertices of a random forest and find them by descending
+    // through the OR aggregate.
+    parallel_euler_tour_tree::EulerTourTree<int, parallel_skip_list::OrAggregate<int>> tree(n);
+    std::vector<int> parent(n, -1);
+    std::vector<bool> flagged(n, false);
+    parlay::sequence<std::pair<int,int>> edges;
+    for (int i = 0; i < n; i++) {
+        if (generator() % 100 == 0) {
+            flagged[i] = true;
+            tree.Update(i, 1);
+        }
+        if (i > 0 && generator() % 30 != 0) {
+            parent[i] = generator() % i;
+            edges.push_back({i, parent[i]});
+        }
+    }
+    tree.BatchLink(edges);
+    auto root = [&] (int v) {
+        while (parent[v] != -1) v = parent[v];
+        return v;
+    };
+    auto is_flagged = [] (int x) { return x != 0; };
+
+    parlay::sequence<int> roots;
+    for (int v = 0; v < n; v++)
+        if (parent[v] == -1) roots.push_back(v);
+    parlay::sequence<int> firsts = tree.BatchFindFirstVertex(roots, is_flagged);
+    for (size_t i = 0; i < roots.size(); i++) {
+        int r = roots[i];
+        std::vector<int> expected;
+        for (int v = 0; v < n; v++)
+            if (flagged[v] && root(v) == r) expected.push_back(v);
+        parlay::sequence<int> found = tree.FindAllVertices(r, is_flagged);
+        std::vector<int> sorted_found(found.begin(), found.end());
+        std::sort(sorted_found.begin(), sorted_found.end());
+        ASSERT_EQ(sorted_found, expected);
+        if (expected.empty()) {
+            ASSERT_EQ(firsts[i], -1);
+        } else {
+            // Matches come in tour order.
+            ASSERT_EQ(firsts[i], found[0]);
+            ASSERT_EQ(tree.FindFirstVertex(expected.back(), is_flagged), found[0]);
+        }
+    }
+}
+
+TEST(ParlaySuite, lazy_add_test) {
+    int n = 1500;
+    std::mt19937 generator(0);
+
+    // Deltas added to whole trees and subtrees are checked against a plain
+    // array of weights while the forest is linked and cut around them.
+    using Value = parallel_skip_list::CountedSum<long long>;
+    parallel_euler_tour_tree::EulerTourTree<Value, parallel_skip_list::AddSumAggregate<long long>> tree(n);
+    std::vector<long long> weight(n);
+    std::vector<std::vector<int>> adjacent(n);
+    for (int i = 0; i < n; i++) {
+        weight[i] = generator() % 3;
+        tree.Update(i, {weight[i], 1});
+    }
+    // Vertices reachable from `v` without crossing edge {v, parent}.
+    auto reachable = [&] (int v, int parent) {
+        std::vector<int> found{v};
+        std::vector<int> from{parent};
+        for (size_t i = 0; i < found.size(); i++)
+            for (int w : adjacent[found[i]])
+                if (w != from[i]) {
+                    found.push_back(w);
+                    from.push_back(found[i]);
+                }
+        return found;
+    };
+    auto link = [&] (const parlay::sequence<std::pair<int,int>>& edges) {
+        tree.BatchLink(edges);
+        for (auto [u, v] : edges) {
+            adjacent[u].push_back(v);
+            adjacent[v].push_back(u);
+        }
+    };
+    auto cut = [&] (const parlay::sequence<std::pair<int,int>>& edges) {
+        tree.BatchCut(edges);
+        for (auto [u, v] : edges) {
+            adjacent[u].erase(std::find(adjacent[u].begin(), adjacent[u].end(), v));
+            adjacent[v].erase(std::find(adjacent[v].begin(), adjacent[v].end(), u));
+        }
+    };
+    auto check = [&] () {
+        parlay::sequence<std::pair<int,int>> subtrees;
+        std::vector<long long> subtree_sums;
+        for (int v = 0; v < n; v++) {
+            long long sum = 0;
+            std::vector<int> component = reachable(v, -1);
+            for (int w : component) sum += weight[w];
+            Value aggregate = tree.ComponentAggregate(v);
+            ASSERT_EQ(aggregate.sum, sum);
+            ASSERT_EQ(aggregate.count, component.size());
+            if (!adjacent[v].empty()) {
+                int parent = adjacent[v][generator() % adjacent[v].size()];
+                sum = 0;
+                for (int w : reachable(v, parent)) sum += weight[w];
+                ASSERT_EQ(tree.SubtreeAggregate(v, parent).sum, sum);
+                subtrees.push_back({v, parent});
+                subtree_sums.push_back(sum);
+            }
+        }
+        // Batched subtree walks apply the deltas pending above them.
+        parlay::sequence<Value> batch_sums = tree.BatchSubtreeAggregate(subtrees);
+        for (size_t i = 0; i < subtrees.size(); i++) {
+            ASSERT_EQ(batch_sums[i].sum, subtree_sums[i]);
+        }
+        // Searches descend past pending deltas.
+        auto size = [] (const Value& x) { return x.count; };
+        auto positive = [] (const Value& x) { return x.sum > 0; };
+        for (int v = 0; v < n; v += 7) {
+            ASSERT_EQ(tree.KthVertexInTour(v, tree.RankInTour(v, size), size), v);
+            std::vector<int> expected;
+            for (int w : reachable(v, -1))
+                if (weight[w] > 0) expected.push_back(w);
+            std::sort(expected.begin(), expected.end());
+            parlay::sequence<int> found = tree.FindAllVertices(v, positive);
+            std::vector<int> sorted_found(found.begin(), found.end());
+            std::sort(sorted_found.begin(), sorted_found.end());
+            ASSERT_EQ(sorted_found, expected);
+        }
+    };
+
+    parlay::sequence<std::pair<int,int>> edges;
+    for (int i = 1; i < n; i++)
+        if (generator() % 20 != 0) edges.push_back({i, static_cast<int>(generator() % i)});
+    link(edges);
+    for (int round = 0; round < 4; round++) {
+        int v = generator() % n;
+        long long delta = generator() % 5;
+        tree.AddToComponent(v, delta);
+        for (int w : reachable(v, -1)) weight[w] += delta;
+        if (!adjacent[v].empty()) {
+            int parent = adjacent[v][0];
+            tree.AddToSubtree(v, parent, delta + 1);
+            for (int w : reachable(v, parent)) weight[w] += delta + 1;
+        }
+
+        parlay::sequence<int> vertices;
+        parlay::sequence<long long> deltas;
+        parlay::sequence<std::pair<int,int>> subtrees;
+        parlay::sequence<long long> subtree_deltas;
+        for (int i = 0; i < 300; i++) {
+            int u = generator() % n;
+            vertices.push_back(u);
+            deltas.push_back(generator() % 4);
+            for (int w : reachable(u, -1)) weight[w] += deltas.back();
+            if (!adjacent[u].empty()) {
+                int parent = adjacent[u][generator() % adjacent[u].size()];
+                subtrees.push_back({u, parent});
+                subtree_deltas.push_back(generator() % 4);
+                for (int w : reachable(u, parent)) weight[w] += subtree_deltas.back();
+            }
+        }
+        tree.BatchAddToComponent(vertices, deltas);
+        tree.BatchAddToSubtree(subtrees, subtree_deltas);
+        for (int i = 0; i < 20; i++) {
+            int u = generator() % n;
+            weight[u] = generator() % 3;
+            tree.Update(u, {weight[u], 1});
+        }
+        check();
+
+        // Cut and relink many edges, and a few one at a time, so that the
+        // deltas pending over them must be pushed out of the way.
+        std::shuffle(edges.begin(), edges.end(), generator);
+        parlay::sequence<std::pair<int,int>> batch(edges.begin(), edges.begin() + 400);
+        cut(batch);
+        check();
+        link(batch);
+        for (int i = 0; i < 5; i++) {
+            parlay::sequence<std::pair<int,int>> one{edges[400 + i]};
+            cut(one);
+            tree.AddToComponent(one[0].first, 1);
+            for (int w : reachable(one[0].first, -1)) weight[w] += 1;
+            link(one);
+        }
+    }
+    check();
+}
+
+TEST(ParlaySuite, tuple_aggregate_test) {
+    int n = 2000;
+    std::mt19937 generator(0);
+
+    // One tree keeps vertex counts, weights that take deltas, and flags.
+    using parallel_skip_list::CountedSum;
+    using Aggregate = parallel_skip_list::TupleAggregate<
+        parallel_skip_list::SumAggregate<int>,
+        parallel_skip_list::AddSumAggregate<long long>,
+        parallel_skip_list::OrAggregate<int>>;
+    using Value = Aggregate::Value;
+    static_assert(!parallel_skip_list::AugmentedElement<std::tuple<int, int>,
+        parallel_skip_list::TupleAggregate<parallel_skip_list::SumAggregate<int>,
+            parallel_skip_list::OrAggregate<int>>>::kIsLazy);
+    parallel_euler_tour_tree::EulerTourTree<Value, Aggregate> tree(n);
+    std::vector<int> parent(n, -1), flag(n);
+    std::vector<long long> weight(n);
+    parlay::sequence<std::pair<int,int>> edges;
+    for (int i = 0; i < n; i++) {
+        weight[i] = generator() % 100;
+        flag[i] = generator() % 50 == 0;
+        tree.Update(i, Value{1, CountedSum<long long>{weight[i], 1}, flag[i]});
+        if (i > 0 && generator() % 40 != 0) {
+            parent[i] = generator() % i;
+            edges.push_back({i, parent[i]});
+        }
+    }
+    tree.BatchLink(edges);
+    auto root = [&] (int v) {
+        while (parent[v] != -1) v = parent[v];
+        return v;
+    };
+
+    parlay::sequence<int> vertices;
+    parlay::sequence<Aggregate::Tag> deltas;
+    for (int i = 0; i < 100; i++) {
+        vertices.push_back(generator() % n);
+        deltas.push_back({parallel_skip_list::EmptyTag{},
+                          static_cast<long long>(generator() % 10),
+                          parallel_skip_list::EmptyTag{}});
+        for (int v = 0; v < n; v++)
+            if (root(v) == root(vertices.back())) weight[v] += std::get<1>(deltas.back());
+    }
+    tree.BatchAddToComponent(vertices, deltas);
+
+    std::vector<int> size(n, 0), flags(n, 0);
+    std::vector<long long> total(n, 0);
+    for (int v = 0; v < n; v++) {
+        size[root(v)]++;
+        total[root(v)] += weight[v];
+        flags[root(v)] |= flag[v];
+    }
+    for (int v = 0; v < n; v++) {
+        Value aggregate = tree.ComponentAggregate(v);
+        ASSERT_EQ(std::get<0>(aggregate), size[root(v)]);
+        ASSERT_EQ(std::get<1>(aggregate).sum, total[root(v)]);
+        ASSERT_EQ(std::get<2>(aggregate), flags[root(v)]);
+        // Order statistics and searches read one component.
+        parallel_skip_list::ComponentSize<0> count;
+        ASSERT_EQ(tree.KthVertexInTour(v, tree.RankInTour(v, count), count), v);
+        int first = tree.FindFirstVertex(v, [] (const Value& x) { return std::get<2>(x) != 0; });
+        if (flags[root(v)]) {
+            ASSERT_TRUE(flag[first]);
+            ASSERT_EQ(root(first), root(v));
+        } else {
+            ASSERT_EQ(first, -1);
+        }
+    }
+}
+
+TEST(ParlaySuite, edge_values_test) {
+    int n = 2000;
+    std::mt19937 generator(0);
+
+    // Edge weights are summed and maximized; vertices hold the identity.
+    using Aggregate = parallel_skip_list::TupleAggregate<
+        parallel_skip_list::SumAggregate<long long>,
+        parallel_skip_list::MaxAggregate<int>>;
+    using Value = Aggregate::Value;
+    parallel_euler_tour_tree::EulerTourTree<Value, Aggregate> tree(n);
+    std::vector<int> parent(n, -1), weight(n, 0);
+    parlay::sequence<std::pair<int,int>> batch;
+    parlay::sequence<Value> batch_values;
+    for (int i = 1; i < n; i++) {
+        if (generator() % 30 == 0) continue;
+        parent[i] = generator() % i;
+        weight[i] = generator() % 1000;
+        // Edges are given in both directions.
+        std::pair<int,int> edge = i % 2 ? std::make_pair(i, parent[i]) : std::make_pair(parent[i], i);
+        if (i % 10 == 0) {
+            tree.LinkWithValue(edge.first, edge.second, Value{weight[i], weight[i]});
+        } else {
+            batch.push_back(edge);
+            batch_values.push_back(Value{weight[i], weight[i]});
+        }
+    }
+    tree.BatchLink(batch, batch_values);
+    auto root = [&] (int v) {
+        while (parent[v] != -1) v = parent[v];
+        return v;
+    };
+    auto check = [&] () {
+        std::vector<long long> sum(n, 0);
+        std::vector<int> max(n, std::numeric_limits<int>::lowest());
+        for (int v = 0; v < n; v++) {
+            if (parent[v] == -1) continue;
+            sum[root(v)] += weight[v];
+            max[root(v)] = std::max(max[root(v)], weight[v]);
+        }
+        for (int v = 0; v < n; v++) {
+            Value aggregate = tree.ComponentAggregate(v);
+            ASSERT_EQ(std::get<0>(aggregate), sum[root(v)]);
+            ASSERT_EQ(std::get<1>(aggregate), max[root(v)]);
+        }
+        // The subtree below an edge includes the edge itself.
+        for (int v = 1; v < n; v += 13) {
+            if (parent[v] == -1) continue;
+            long long subtree = 0;
+            for (int w = 0; w < n; w++) {
+                int x = w;
+                while (x != v && parent[x] != -1) x = parent[x];
+                if (x == v && parent[w] != -1) subtree += weight[w];
+            }
+            ASSERT_EQ(std::get<0>(tree.SubtreeAggregate(v, parent[v])), subtree);
+        }
+    };
+    check();
+
+    parlay::sequence<std::pair<int,int>> updates;
+    parlay::sequence<Value> update_values;
+    for (int v = 1; v < n; v++) {
+        if (parent[v] == -1 || generator() % 3 != 0) continue;
+        weight[v] = generator() % 1000;
+        if (v % 7 == 0) {
+            tree.UpdateEdge(parent[v], v, Value{weight[v], weight[v]});
+        } else {
+            updates.push_back({v, parent[v]});
+            update_values.push_back(Value{weight[v], weight[v]});
+        }
+    }
+    tree.BatchUpdateEdge(updates, update_values);
+    check();
+
+    // Cut edges take their values with them.
+    parlay::sequence<std::pair<int,int>> cuts;
+    for (int v = 1; v < n; v++) {
+        if (parent[v] != -1 && generator() % 4 == 0) {
+            cuts.push_back({v, parent[v]});
+        }
+    }
+    tree.BatchCut(cuts);
+    for (auto [v, p] : cuts) parent[v] = -1;
+    check();
+}
+
+TEST(ParlaySuite, edge_values_with_lazy_add_test) {
+    int n = 2000;
+    std::mt19937 generator(0);
+
+    // Deltas added to whole trees and subtrees reach vertex weights but leave
+    // the maximum edge weight alone. Plain `AddMaxAggregate` cannot tell the
+    // two apart, so it may not hold edge values.
+    static_assert(!parallel_skip_list::_internal::ValuesCanOptOut<
+        parallel_skip_list::AddMaxAggregate<int>>::value);
+    using Aggregate = parallel_skip_list::SplitAddMaxAggregate<int>;
+    using Value = parallel_skip_list::SplitExtremum<int>;
+    constexpr int kNone = std::numeric_limits<int>::lowest();
+    parallel_euler_tour_tree::EulerTourTree<Value, Aggregate> tree(n);
+    std::vector<int> parent(n, -1), weight(n), edge_weight(n, kNone);
+    for (int i = 0; i < n; i++) {
+        weight[i] = generator() % 1000;
+        tree.Update(i, Value{weight[i], kNone});
+    }
+    parlay::sequence<std::pair<int,int>> batch;
+    parlay::sequence<Value> batch_values;
+    for (int i = 1; i < n; i++) {
+        if (generator() % 30 == 0) continue;
+        parent[i] = generator() % i;
+        edge_weight[i] = generator() % 1000;
+        if (i % 10 == 0) {
+            tree.LinkWithValue(i, parent[i], Value{kNone, edge_weight[i]});
+        } else {
+            batch.push_back({i, parent[i]});
+            batch_values.push_back(Value{kNone, edge_weight[i]});
+        }
+    }
+    tree.BatchLink(batch, batch_values);
+    auto in_subtree = [&] (int w, int v) {
+        while (w != v && parent[w] != -1) w = parent[w];
+        return w == v;
+    };
+    auto root = [&] (int v) {
+        while (parent[v] != -1) v = parent[v];
+        return v;
+    };
+    auto check = [&] () {
+        std::vector<int> max_weight(n, kNone), max_edge(n, kNone);
+        for (int v = 0; v < n; v++) {
+            max_weight[root(v)] = std::max(max_weight[root(v)], weight[v]);
+            max_edge[root(v)] = std::max(max_edge[root(v)], edge_weight[v]);
+        }
+        for (int v = 0; v < n; v++) {
+            Value aggregate = tree.ComponentAggregate(v);
+            ASSERT_EQ(aggregate.tagged, max_weight[root(v)]);
+            ASSERT_EQ(aggregate.untagged, max_edge[root(v)]);
+            ASSERT_EQ(Aggregate{}.Get(aggregate),
+                std::max(max_weight[root(v)], max_edge[root(v)]));
+        }
+    };
+    check();
+
+    for (int round = 0; round < 3; round++) {
+        int v = generator() % n;
+        int delta = generator() % 50;
+        tree.AddToComponent(v, delta);
+        for (int w = 0; w < n; w++)
+            if (root(w) == root(v)) weight[w] += delta;
+        parlay::sequence<int> vertices;
+        parlay::sequence<int> deltas;
+        parlay::sequence<std::pair<int,int>> subtrees;
+        parlay::sequence<int> subtree_deltas;
+        for (int i = 0; i < 50; i++) {
+            int u = generator() % n;
+            vertices.push_back(u);
+            deltas.push_back(generator() % 50);
+            for (int w = 0; w < n; w++)
+                if (root(w) == root(u)) weight[w] += deltas.back();
+            if (parent[u] != -1) {
+                subtrees.push_back({u, parent[u]});
+                subtree_deltas.push_back(generator() % 50);
+                for (int w = 0; w < n; w++)
+                    if (in_subtree(w, u)) weight[w] += subtree_deltas.back();
+            }
+        }
+        tree.BatchAddToComponent(vertices, deltas);
+        tree.BatchAddToSubtree(subtrees, subtree_deltas);
+        check();
+
+        // Updated and cut edges keep their weights out of later deltas.
+        for (int u = 1; u < n; u += 17) {
+            if (parent[u] == -1) continue;
+            edge_weight[u] = generator() % 1000;
+            tree.UpdateEdge(u, parent[u], Value{kNone, edge_weight[u]});
+        }
+        parlay::sequence<std::pair<int,int>> cuts;
+        for (int u = 1; u < n; u++) {
+            if (parent[u] != -1 && generator() % 20 == 0) cuts.push_back({u, parent[u]});
+        }
+        tree.BatchCut(cuts);
+        for (auto [u, p] : cuts) {
+            parent[u] = -1;
+            edge_weight[u] = kNone;
+        }
+        check();
+    }
+}
+
+TEST(ParlaySuite, batch_update_test) {
+    int n = 3000;
+    std::mt19937 generator(0);
+
+    parallel_euler_tour_tree::EulerTourTree<int, parallel_skip_list::SumAggregate<int>> tree(n);
+    std::vector<int> parent(n, -1), value(n, 0);
+    parlay::sequence<std::pair<int,int>> edges;
+    for (int i = 1; i < n; i++) {
+        if (generator() % 20 == 0) continue;
+        parent[i] = generator() % i;
+        edges.push_back({i, parent[i]});
+    }
+    tree.BatchLink(edges);
+    auto root = [&] (int v) {
+        while (parent[v] != -1) v = parent[v];
+        return v;
+    };
+
+    for (int round = 0; round < 5; round++) {
+        // Batches repeat vertices; the last value given for a vertex wins.
+        int k = round == 0 ? 2 * n : 1 + generator() % 500;
+        parlay::sequence<int> vertices(k), values(k);
+        for (int i = 0; i < k; i++) {
+            vertices[i] = generator() % (round == 4 ? 10 : n);
+            values[i] = generator() % 100;
+            value[vertices[i]] = values[i];
+        }
+        tree.BatchUpdate(vertices, values);
+
+        std::vector<int> sum(n, 0);
+        for (int v = 0; v < n; v++) sum[root(v)] += value[v];
+        for (int v = 0; v < n; v++) {
+            ASSERT_EQ(tree.ComponentAggregate(v), sum[root(v)]);
+        }
+    }
+}
+
+TEST(ParlaySuite, deferred_aggregates_test) {
+    int n = 800;
+    std::mt19937 generator(0);
+
+    // Many links and cuts run between queries with aggregates deferred, mixed
+    // with updates and pending deltas that do not wait for the flush.
+    using Value = parallel_skip_list::CountedSum<long long>;
+    parallel_euler_tour_tree::EulerTourTree<Value, parallel_skip_list::AddSumAggregate<long long>> tree(n);
+    std::vector<long long> weight(n);
+    for (int i = 0; i < n; i++) {
+        weight[i] = generator() % 5;
+        tree.Update(i, {weight[i], 1});
+    }
+    tree.DeferAggregates();
+    std::vector<std::set<int>> adjacent(n);
+    auto component = [&] (int v) {
+        std::vector<int> found{v};
+        std::set<int> seen{v};
+        for (size_t i = 0; i < found.size(); i++)
+            for (int w : adjacent[found[i]])
+                if (seen.insert(w).second) found.push_back(w);
+        return found;
+    };
+    auto check = [&] () {
+        parlay::sequence<int> vertices = parlay::tabulate(n, [] (size_t i) { return static_cast<int>(i); });
+        parlay::sequence<Value> aggregates = tree.BatchComponentAggregate(vertices);
+        for (int v = 0; v < n; v++) {
+            long long sum = 0;
+            std::vector<int> found = component(v);
+            for (int w : found) sum += weight[w];
+            ASSERT_EQ(aggregates[v].sum, sum);
+            ASSERT_EQ(aggregates[v].count, found.size());
+            ASSERT_EQ(tree.ComponentAggregate(v).sum, sum);
+        }
+    };
+
+    parlay::sequence<std::pair<int,int>> edges;
+    for (int i = 1; i < n; i++)
+        if (generator() % 10 != 0) edges.push_back({i, static_cast<int>(generator() % i)});
+    for (int round = 0; round < 6; round++) {
+        std::shuffle(edges.begin(), edges.end(), generator);
+        // Batches above and below the size at which they run one at a time.
+        int k = round % 2 == 0 ? edges.size() : 50;
+        parlay::sequence<std::pair<int,int>> batch(edges.begin(), edges.begin() + k);
+        tree.BatchLink(batch);
+        for (auto [u, v] : batch) {
+            adjacent[u].insert(v);
+            adjacent[v].insert(u);
+        }
+        int v = generator() % n;
+        tree.AddToComponent(v, 2);
+        for (int w : component(v)) weight[w] += 2;
+        v = generator() % n;
+        weight[v] = generator() % 5;
+        tree.Update(v, {weight[v], 1});
+        if (round % 3 == 2) {
+            tree.Flush();
+            check();
+        }
+        // Enough single cuts and links to overflow the record of stale
+        // elements.
+        for (int i = 0; i < 400 && i < k; i++) {
+            auto [x, y] = batch[i];
+            tree.Cut(x, y);
+            tree.Link(x, y);
+        }
+        tree.BatchCut(batch);
+        for (auto [x, y] : batch) {
+            adjacent[x].erase(y);
+            adjacent[y].erase(x);
+        }
+        tree.BatchLink(parlay::sequence<std::pair<int,int>>(batch.begin(), batch.begin() + k / 2));
+        for (int i = 0; i < k / 2; i++) {
+            adjacent[batch[i].first].insert(batch[i].second);
+            adjacent[batch[i].second].insert(batch[i].first);
+        }
+        tree.Flush();
+        check();
+        tree.BatchCut(parlay::sequence<std::pair<int,int>>(batch.begin(), batch.begin() + k / 2));
+        for (int i = 0; i < k / 2; i++) {
+            adjacent[batch[i].first].erase(batch[i].second);
+            adjacent[batch[i].second].erase(batch[i].first);
+        }
+    }
+    tree.DeferAggregates(false);
+    tree.BatchLink(edges);
+    for (auto [u, v] : edges) {
+        adjacent[u].insert(v);
+        adjacent[v].insert(u);
+    }
+    check();
+}
+
+// Polynomial hash of a sequence of vertices, which depends on their order.
+struct TourHash {
+    unsigned long long hash;
+    unsigned long long power;
+    bool operator==(const TourHash& other) const {
+        return hash == other.hash && power == other.power;
+    }
+};
+
+struct TourHashAggregate {
+    TourHash operator()(const TourHash& x, const TourHash& y) const {
+        return {x.hash * y.power + y.hash, x.power * y.power};
+    }
+    TourHash Identity() const { return {0, 1}; }
+};
+
+TEST(ParlaySuite, ordered_tour_aggregate_test) {
+    int n = 1000;
+    std::mt19937 generator(0);
+
+    using Tree = parallel_euler_tour_tree::EulerTourTree<TourHash, TourHashAggregate>;
+    using Element = std::remove_pointer_t<decltype(Tree::vertices_)>;
+    Tree tree(n);
+    TourHashAggregate aggregate;
+    auto vertex_hash = [] (int v) { return TourHash{static_cast<unsigned long long>(v) + 1, 31}; };
+    for (int v = 0; v < n; v++) tree.Update(v, vertex_hash(v));
+    parlay::sequence<std::pair<int,int>> edges;
+    for (int i = 1; i < n; i++)
+        if (generator() % 10 != 0) edges.push_back({i, static_cast<int>(generator() % i)});
+    tree.BatchLink(edges);
+
+    // Hashes the tour from `from` up to and including `to` one element at a
+    // time.
+    auto scan = [&] (const Element* from, const Element* to) {
+        TourHash sum = aggregate.Identity();
+        const Element* curr = from;
+        while (true) {
+            int vertex = static_cast<int>(curr - tree.vertices_);
+            if (0 <= vertex && vertex < n) sum = aggregate(sum, vertex_hash(vertex));
+            if (curr == to) return sum;
+            curr = static_cast<const Element*>(curr->GetNextElement());
+        }
+    };
+    for (int round = 0; round < 2; round++) {
+        parlay::sequence<int> vertices = parlay::tabulate(n, [] (size_t i) { return static_cast<int>(i); });
+        parlay::sequence<TourHash> sums = tree.BatchTourAggregateFrom(vertices);
+        for (int v = 0; v < n; v++) {
+            const Element* start = &tree.vertices_[v];
+            TourHash expected = scan(start, static_cast<const Element*>(start->GetPreviousElement()));
+            ASSERT_EQ(tree.TourAggregateFrom(v), expected);
+            ASSERT_EQ(sums[v], expected);
+        }
+        // Batched subtrees are aggregated in tour order too, including ones
+        // that wrap around the start of the tour.
+        parlay::sequence<std::pair<int,int>> subtrees;
+        for (auto [u, v] : edges) {
+            subtrees.push_back({u, v});
+            subtrees.push_back({v, u});
+        }
+        parlay::sequence<TourHash> subtree_sums = tree.BatchSubtreeAggregate(subtrees);
+        for (size_t i = 0; i < subtrees.size(); i++) {
+            auto [u, v] = subtrees[i];
+            const Element* down = tree.edges_.Find(v, u);
+            ASSERT_EQ(tree.SubtreeAggregate(u, v), scan(down, down->GetTwin()));
+            ASSERT_EQ(subtree_sums[i], scan(down, down->GetTwin()));
+        }
+        std::shuffle(edges.begin(), edges.end(), generator);
+        parlay::sequence<std::pair<int,int>> batch(edges.begin(), edges.begin() + 300);
+        tree.BatchCut(batch);
+        tree.BatchLink(batch);
+    }
+}
+
+TEST(ParlaySuite, apply_batch_test) {
+    int n = 400;
+    std::mt19937 generator(0);
+
+    parallel_euler_tour_tree::EulerTourTree<int> tree(n);
+    std::set<std::pair<int,int>> present;
+    auto key = [] (int u, int v) { return std::make_pair(std::min(u, v), std::max(u, v)); };
+    auto connected = [&] (int u, int v) {
+        std::vector<int> found{u};
+        std::set<int> seen{u};
+        for (size_t i = 0; i < found.size(); i++)
+            for (auto [x, y] : present) {
+                int w = x == found[i] ? y : y == found[i] ? x : -1;
+                if (w != -1 && seen.insert(w).second) found.push_back(w);
+            }
+        return seen.count(v) > 0;
+    };
+
+    for (int round = 0; round < 6; round++) {
+        // A log that is valid in order, with repeated and cancelling updates.
+        std::set<std::pair<int,int>> before = present;
+        parlay::sequence<parallel_euler_tour_tree::EdgeUpdate> log;
+        for (int i = 0; i < 300; i++) {
+            int u = generator() % n, v = generator() % n;
+            int kind = generator() % 4;
+            if (kind == 0 && !present.empty()) {
+                // Cut an edge and maybe link it right back.
+                auto it = present.begin();
+                std::advance(it, generator() % present.size());
+                auto [x, y] = *it;
+                present.erase(it);
+                log.push_back({y, x, false});
+                if (generator() % 2) {
+                    present.insert({x, y});
+                    log.push_back({x, y, true});
+                }
+            } else if (kind == 1) {
+                // Redundant updates.
+                log.push_back({u, v, present.count(key(u, v)) > 0});
+            } else if (u != v && !connected(u, v)) {
+                present.insert(key(u, v));
+                log.push_back({u, v, true});
+            }
+        }
+        parallel_euler_tour_tree::AppliedUpdates applied = tree.ApplyBatch(log);
+
+        std::set<std::pair<int,int>> cut, linked;
+        for (auto [u, v] : applied.cuts) ASSERT_TRUE(cut.insert(key(u, v)).second);
+        for (auto [u, v] : applied.links) ASSERT_TRUE(linked.insert(key(u, v)).second);
+        for (auto& e : before) ASSERT_EQ(cut.count(e) > 0, present.count(e) == 0);
+        for (auto& e : present) ASSERT_EQ(linked.count(e) > 0, before.count(e) == 0);
+        ASSERT_EQ(cut.size() + present.size(), before.size() + linked.size());
+        for (int i = 0; i < 200; i++) {
+            int u = generator() % n, v = generator() % n;
+            ASSERT_EQ(tree.IsConnected(u, v), connected(u, v));
+        }
+    }
+}
+
+TEST(ParlaySuite, batch_link_if_acyclic_test) {
+    int n = 2000;
+    std::mt19937 generator(0);
+
+    parallel_euler_tour_tree::EulerTourTree<int> tree(n);
+    // Union-find over all edges offered so far.
+    std::vector<int> parent(n);
+    for (int i = 0; i < n; i++) parent[i] = i;
+    std::function<int(int)> find = [&] (int v) { return parent[v] == v ? v : parent[v] = find(parent[v]); };
+    int num_trees = n;
+    size_t num_links = 0;
+    for (int round = 0; round < 5; round++) {
+        // Random edges, with repeats, self-loops, and edges within trees.
+        int k = round == 0 ? 50 : 1000;
+        parlay::sequence<std::pair<int,int>> edges;
+        for (int i = 0; i < k; i++)
+            edges.push_back({static_cast<int>(generator() % n), static_cast<int>(generator() % n)});
+        edges.push_back(edges[0]);
+        edges.push_back({edges[1].second, edges[1].first});
+        parlay::sequence<bool> accepted = tree.BatchLinkIfAcyclic(edges);
+        ASSERT_EQ(accepted.size(), edges.size());
+        for (size_t i = 0; i < edges.size(); i++) {
+            int u = find(edges[i].first), v = find(edges[i].second);
+            if (u != v) {
+                parent[u] = v;
+                num_trees--;
+            }
+            if (accepted[i]) num_links++;
+        }
+        // A forest with `num_links` edges has n - num_links trees.
+        ASSERT_EQ(num_links, static_cast<size_t>(n - num_trees));
+        for (int i = 0; i < 500; i++) {
+            int u = generator() % n, v = generator() % n;
+            ASSERT_EQ(tree.IsConnected(u, v), find(u) == find(v));
+        }
+    }
+}
+
+TEST(ParlaySuite, batch_cut_if_present_test) {
+    int n = 1000;
+    std::mt19937 generator(0);
+
+    parallel_euler_tour_tree::EulerTourTree<int, parallel_skip_list::SumAggregate<int>> tree(n);
+    std::vector<std::pair<int,int>> edges;
+    for (int i = 1; i < n; i++) edges.push_back({static_cast<int>(generator() % i), i});
+    tree.BatchLink(edges.data(), edges.size());
+    for (int i = 0; i < n; i++) tree.Update(i, 1);
+    std::set<std::pair<int,int>> present(edges.begin(), edges.end());
+
+    for (int round = 0; round < 4; round++) {
+        // Present edges in either orientation, repeated, mixed with absent ones.
+        int k = round == 0 ? 40 : 300;
+        parlay::sequence<std::pair<int,int>> cuts;
+        for (int i = 0; i < k; i++) {
+            if (generator() % 3 == 0) {
+                cuts.push_back({static_cast<int>(generator() % n), static_cast<int>(generator() % n)});
+            } else {
+                auto [u, v] = edges[generator() % edges.size()];
+                if (generator() % 2) std::swap(u, v);
+                cuts.push_back({u, v});
+            }
+        }
+        cuts.push_back(cuts[0]);
+        cuts.push_back({cuts[1].second, cuts[1].first});
+        std::set<std::pair<int,int>> before = present;
+        parlay::sequence<bool> performed = tree.BatchCutIfPresent(cuts);
+        ASSERT_EQ(performed.size(), cuts.size());
+        std::set<std::pair<int,int>> requested, cut;
+        for (size_t i = 0; i < cuts.size(); i++) {
+            auto e = std::make_pair(std::min(cuts[i].first, cuts[i].second),
+                                    std::max(cuts[i].first, cuts[i].second));
+            requested.insert(e);
+            if (performed[i]) {
+                ASSERT_TRUE(before.count(e) > 0);
+                ASSERT_TRUE(cut.insert(e).second);
+            }
+        }
+        // Every requested present edge is cut.
+        for (auto& e : requested) {
+            if (before.count(e) > 0) {
+                ASSERT_EQ(cut.count(e), 1u);
+            }
+        }
+        for (auto& e : cut) present.erase(e);
+
+        // Component sizes of the remaining forest.
+        std::vector<int> parent(n);
+        for (int i = 0; i < n; i++) parent[i] = i;
+        std::function<int(int)> find = [&] (int v) { return parent[v] == v ? v : parent[v] = find(parent[v]); };
+        for (auto [u, v] : present) parent[find(u)] = find(v);
+        std::vector<int> size(n);
+        for (int i = 0; i < n; i++) size[find(i)]++;
+        for (int i = 0; i < n; i++) {
+            ASSERT_EQ(tree.ComponentAggregate(i), size[find(i)]);
+            int u = generator() % n;
+            ASSERT_EQ(tree.IsConnected(i, u), find(i) == find(u));
+        }
+    }
+}
+
+TEST(ParlaySuite, concurrent_front_end_test) {
+    int num_threads = 4, block = 100;
+    // Two spare vertices at the end for the last check.
+    int n = num_threads * block + 2;
+    parallel_euler_tour_tree::EulerTourTree<int> tree(n);
+    {
+        parallel_euler_tour_tree::ConcurrentFrontEnd<parallel_euler_tour_tree::EulerTourTree<int>>
+            front_end(&tree, std::chrono::microseconds(100));
+        // Each thread works on its own block of vertices, so its results must
+        // match applying its calls in order.
+        std::vector<std::thread> threads;
+        std::vector<int> mismatches(num_threads);
+        for (int t = 0; t < num_threads; t++) {
+            threads.emplace_back([&, t] {
+                std::mt19937 generator(t);
+                std::set<std::pair<int,int>> present;
+                auto connected = [&] (int u, int v) {
+                    std::vector<int> found{u};
+                    std::set<int> seen{u};
+                    for (size_t i = 0; i < found.size(); i++)
+                        for (auto [x, y] : present) {
+                            int w = x == found[i] ? y : y == found[i] ? x : -1;
+                            if (w != -1 && seen.insert(w).second) found.push_back(w);
+                        }
+                    return seen.count(v) > 0;
+                };
+                for (int round = 0; round < 40; round++) {
+                    // Several calls in flight at once.
+                    std::vector<std::future<bool>> results;
+                    std::vector<bool> expected;
+                    for (int i = 0; i < 10; i++) {
+                        int u = t * block + generator() % block, v = t * block + generator() % block;
+                        auto e = std::make_pair(std::min(u, v), std::max(u, v));
+                        int kind = generator() % 3;
+                        if (kind == 0) {
+                            expected.push_back(!connected(u, v));
+                            if (expected.back()) present.insert(e);
+                            results.push_back(front_end.Link(u, v));
+                        } else if (kind == 1 && !present.empty() && generator() % 2) {
+                            auto it = present.begin();
+                            std::advance(it, generator() % present.size());
+                            expected.push_back(true);
+                            results.push_back(generator() % 2 ? front_end.Cut(it->first, it->second)
+                                                              : front_end.Cut(it->second, it->first));
+                            present.erase(it);
+                        } else if (kind == 1) {
+                            expected.push_back(present.erase(e) > 0);
+                            results.push_back(front_end.Cut(u, v));
+                        } else {
+                            expected.push_back(connected(u, v));
+                            results.push_back(front_end.IsConnected(u, v));
+                        }
+                    }
+                    for (size_t i = 0; i < results.size(); i++)
+                        if (results[i].get() != expected[i]) mismatches[t]++;
+                }
+            });
+        }
+        for (auto& thread : threads) thread.join();
+        for (int t = 0; t < num_threads; t++) ASSERT_EQ(mismatches[t], 0);
+        ASSERT_GT(front_end.NumBatches(), 0u);
+    }
+    // One thread's calls in the same batch take effect in order, and calls not
+    // waited on still complete before the front end is destroyed.
+    std::vector<std::future<bool>> results;
+    {
+        parallel_euler_tour_tree::ConcurrentFrontEnd<parallel_euler_tour_tree::EulerTourTree<int>>
+            front_end(&tree, std::chrono::microseconds(10000));
+        results.push_back(front_end.Link(n - 2, n - 1));
+        results.push_back(front_end.Link(n - 1, n - 2));
+        results.push_back(front_end.Cut(n - 1, n - 2));
+        results.push_back(front_end.Cut(n - 2, n - 1));
+        results.push_back(front_end.IsConnected(n - 2, n - 1));
+        results.push_back(front_end.Link(n - 2, n - 1));
+    }
+    std::vector<bool> expected{true, false, true, false, false, true};
+    for (size_t i = 0; i < results.size(); i++) ASSERT_EQ(results[i].get(), expected[i]);
+    ASSERT_TRUE(tree.IsConnected(n - 2, n - 1));
+}
+
+TEST(ParlaySuite, snapshot_test) {
+    int n = 2000;
+    parallel_euler_tour_tree::EulerTourTree<int> tree(n);
+    ASSERT_EQ(tree.GetSnapshot(), nullptr);
+    std::vector<std::pair<int,int>> path, gaps;
+    for (int i = 0; i + 1 < n; i++) path.push_back({i, i + 1});
+    for (int i = 9; i + 1 < n; i += 10) gaps.push_back({i, i + 1});
+    tree.BatchLink(path.data(), path.size());
+    tree.PublishSnapshot();
+    auto first = tree.GetSnapshot();
+    tree.BatchCut(gaps.data(), gaps.size());
+    ASSERT_TRUE(first->IsConnected(0, n - 1));
+    ASSERT_EQ(first->Version(), 1u);
+
+    // Odd versions have the whole path and even versions have blocks of 10.
+    int num_rounds = 40;
+    std::atomic<bool> done{false};
+    int mismatches = 0;
+    uint64_t versions_seen = 0;
+    std::thread reader([&] {
+        std::mt19937 generator(0);
+        uint64_t last_version = 0;
+        while (!done.load()) {
+            auto snapshot = tree.GetSnapshot();
+            if (snapshot->Version() < last_version) mismatches++;
+            if (snapshot->Version() != last_version) versions_seen++;
+            last_version = snapshot->Version();
+            for (int i = 0; i < 100; i++) {
+                int u = generator() % n, v = generator() % n;
+                bool expected = last_version % 2 == 1 || u / 10 == v / 10;
+                if (snapshot->IsConnected(u, v) != expected) mismatches++;
+            }
+        }
+    });
+    for (int round = 0; round < num_rounds; round++) {
+        tree.PublishSnapshot();
+        if (round % 2 == 0) {
+            tree.BatchLink(gaps.data(), gaps.size());
+        } else {
+            tree.BatchCut(gaps.data(), gaps.size());
+        }
+    }
+    tree.PublishSnapshot();
+    done = true;
+    reader.join();
+    ASSERT_EQ(mismatches, 0);
+    ASSERT_GT(versions_seen, 0u);
+    ASSERT_EQ(tree.GetSnapshot()->Version(), static_cast<uint64_t>(num_rounds + 2));
+    ASSERT_TRUE(first->IsConnected(0, n - 1));
+
+    // Snapshots after random batches agree with the forest.
+    std::mt19937 generator(1);
+    parallel_euler_tour_tree::EulerTourTree<int> random_tree(n);
+    std::vector<std::pair<int,int>> edges;
+    for (int i = 1; i < n; i++) edges.push_back({static_cast<int>(generator() % i), i});
+    std::shuffle(edges.begin(), edges.end(), generator);
+    random_tree.BatchLink(edges.data(), n / 2);
+    random_tree.PublishSnapshot();
+    for (int round = 0; round < 10; round++) {
+        int k = round == 0 ? 700 : 50;
+        std::rotate(edges.begin(), edges.begin() + generator() % (n / 2), edges.begin() + n / 2);
+        random_tree.BatchCut(edges.data() + n / 2 - k, k);
+        random_tree.BatchLink(edges.data() + n / 2, k);
+        std::rotate(edges.begin() + n / 2 - k, edges.begin() + n / 2, edges.begin() + n / 2 + k);
+        random_tree.PublishSnapshot();
+        auto snapshot = random_tree.GetSnapshot();
+        for (int i = 0; i < 500; i++) {
+            int u = generator() % n, v = generator() % n;
+            ASSERT_EQ(snapshot->IsConnected(u, v), random_tree.IsConnected(u, v));
+        }
+    }
+}